@@ -0,0 +1,683 @@
+//
+//      font.h --- the stroke font Text is drawn with
+//
+//      GLUT's Mono Roman stroke font (GLUT_STROKE_MONO_ROMAN), copied from
+//      freeglut's table (X11 license) so every renderer draws the same strokes
+//      with any GLUT, or none.  Glyph c is Font_glyph[c].n line strips from
+//      Font_strip[Font_glyph[c].first], each the first vertex in Font_v and
+//      its count, in units where the font is FONT_HEIGHT high.  Every glyph
+//      advances FONT_ADVANCE (it's monospaced), characters without one don't.
+//
+
+#ifndef FONT_H
+#define FONT_H
+
+#define	FONT_HEIGHT	152.381f
+#define	FONT_ADVANCE	104.762f
+
+struct font_glyph
+{
+	float right;		// advance
+	short first, n;		// its strips
+};
+
+static const struct font_glyph Font_glyph[128] = {
+	[32] = {FONT_ADVANCE, 0, 0},	// space
+	[33] = {FONT_ADVANCE, 0, 2},	// !
+	[34] = {FONT_ADVANCE, 2, 2},	// "
+	[35] = {FONT_ADVANCE, 4, 4},	// #
+	[36] = {FONT_ADVANCE, 8, 3},	// $
+	[37] = {FONT_ADVANCE, 11, 3},	// %
+	[38] = {FONT_ADVANCE, 14, 1},	// &
+	[39] = {FONT_ADVANCE, 15, 1},	// '
+	[40] = {FONT_ADVANCE, 16, 1},	// (
+	[41] = {FONT_ADVANCE, 17, 1},	// )
+	[42] = {FONT_ADVANCE, 18, 3},	// *
+	[43] = {FONT_ADVANCE, 21, 2},	// +
+	[44] = {FONT_ADVANCE, 23, 1},	// ,
+	[45] = {FONT_ADVANCE, 24, 1},	// -
+	[46] = {FONT_ADVANCE, 25, 1},	// .
+	[47] = {FONT_ADVANCE, 26, 1},	// /
+	[48] = {FONT_ADVANCE, 27, 1},	// 0
+	[49] = {FONT_ADVANCE, 28, 1},	// 1
+	[50] = {FONT_ADVANCE, 29, 1},	// 2
+	[51] = {FONT_ADVANCE, 30, 1},	// 3
+	[52] = {FONT_ADVANCE, 31, 2},	// 4
+	[53] = {FONT_ADVANCE, 33, 1},	// 5
+	[54] = {FONT_ADVANCE, 34, 1},	// 6
+	[55] = {FONT_ADVANCE, 35, 2},	// 7
+	[56] = {FONT_ADVANCE, 37, 1},	// 8
+	[57] = {FONT_ADVANCE, 38, 1},	// 9
+	[58] = {FONT_ADVANCE, 39, 2},	// :
+	[59] = {FONT_ADVANCE, 41, 2},	// ;
+	[60] = {FONT_ADVANCE, 43, 1},	// <
+	[61] = {FONT_ADVANCE, 44, 2},	// =
+	[62] = {FONT_ADVANCE, 46, 1},	// >
+	[63] = {FONT_ADVANCE, 47, 2},	// ?
+	[64] = {FONT_ADVANCE, 49, 2},	// @
+	[65] = {FONT_ADVANCE, 51, 3},	// A
+	[66] = {FONT_ADVANCE, 54, 3},	// B
+	[67] = {FONT_ADVANCE, 57, 1},	// C
+	[68] = {FONT_ADVANCE, 58, 2},	// D
+	[69] = {FONT_ADVANCE, 60, 4},	// E
+	[70] = {FONT_ADVANCE, 64, 3},	// F
+	[71] = {FONT_ADVANCE, 67, 2},	// G
+	[72] = {FONT_ADVANCE, 69, 3},	// H
+	[73] = {FONT_ADVANCE, 72, 1},	// I
+	[74] = {FONT_ADVANCE, 73, 1},	// J
+	[75] = {FONT_ADVANCE, 74, 3},	// K
+	[76] = {FONT_ADVANCE, 77, 2},	// L
+	[77] = {FONT_ADVANCE, 79, 4},	// M
+	[78] = {FONT_ADVANCE, 83, 3},	// N
+	[79] = {FONT_ADVANCE, 86, 1},	// O
+	[80] = {FONT_ADVANCE, 87, 2},	// P
+	[81] = {FONT_ADVANCE, 89, 2},	// Q
+	[82] = {FONT_ADVANCE, 91, 3},	// R
+	[83] = {FONT_ADVANCE, 94, 1},	// S
+	[84] = {FONT_ADVANCE, 95, 2},	// T
+	[85] = {FONT_ADVANCE, 97, 1},	// U
+	[86] = {FONT_ADVANCE, 98, 2},	// V
+	[87] = {FONT_ADVANCE, 100, 4},	// W
+	[88] = {FONT_ADVANCE, 104, 2},	// X
+	[89] = {FONT_ADVANCE, 106, 2},	// Y
+	[90] = {FONT_ADVANCE, 108, 3},	// Z
+	[91] = {FONT_ADVANCE, 111, 4},	// [
+	[92] = {FONT_ADVANCE, 115, 1},	// backslash
+	[93] = {FONT_ADVANCE, 116, 4},	// ]
+	[94] = {FONT_ADVANCE, 120, 2},	// ^
+	[95] = {FONT_ADVANCE, 122, 1},	// _
+	[96] = {FONT_ADVANCE, 123, 2},	// `
+	[97] = {FONT_ADVANCE, 125, 2},	// a
+	[98] = {FONT_ADVANCE, 127, 2},	// b
+	[99] = {FONT_ADVANCE, 129, 1},	// c
+	[100] = {FONT_ADVANCE, 130, 2},	// d
+	[101] = {FONT_ADVANCE, 132, 1},	// e
+	[102] = {FONT_ADVANCE, 133, 2},	// f
+	[103] = {FONT_ADVANCE, 135, 2},	// g
+	[104] = {FONT_ADVANCE, 137, 2},	// h
+	[105] = {FONT_ADVANCE, 139, 2},	// i
+	[106] = {FONT_ADVANCE, 141, 2},	// j
+	[107] = {FONT_ADVANCE, 143, 3},	// k
+	[108] = {FONT_ADVANCE, 146, 1},	// l
+	[109] = {FONT_ADVANCE, 147, 3},	// m
+	[110] = {FONT_ADVANCE, 150, 2},	// n
+	[111] = {FONT_ADVANCE, 152, 1},	// o
+	[112] = {FONT_ADVANCE, 153, 2},	// p
+	[113] = {FONT_ADVANCE, 155, 2},	// q
+	[114] = {FONT_ADVANCE, 157, 2},	// r
+	[115] = {FONT_ADVANCE, 159, 1},	// s
+	[116] = {FONT_ADVANCE, 160, 2},	// t
+	[117] = {FONT_ADVANCE, 162, 2},	// u
+	[118] = {FONT_ADVANCE, 164, 2},	// v
+	[119] = {FONT_ADVANCE, 166, 4},	// w
+	[120] = {FONT_ADVANCE, 170, 2},	// x
+	[121] = {FONT_ADVANCE, 172, 2},	// y
+	[122] = {FONT_ADVANCE, 174, 3},	// z
+	[123] = {FONT_ADVANCE, 177, 3},	// {
+	[124] = {FONT_ADVANCE, 180, 1},	// |
+	[125] = {FONT_ADVANCE, 181, 3},	// }
+	[126] = {FONT_ADVANCE, 184, 2},	// ~
+	[127] = {FONT_ADVANCE, 186, 2},	// del
+};
+
+static const short Font_strip[188][2] = {
+	{0, 2}, {2, 5},	// !
+	{7, 2}, {9, 2},	// "
+	{11, 2}, {13, 2}, {15, 2}, {17, 2},	// #
+	{19, 2}, {21, 2}, {23, 20},	// $
+	{43, 2}, {45, 16}, {61, 11},	// %
+	{72, 34},	// &
+	{106, 2},	// '
+	{108, 10},	// (
+	{118, 10},	// )
+	{128, 2}, {130, 2}, {132, 2},	// *
+	{134, 2}, {136, 2},	// +
+	{138, 8},	// ,
+	{146, 2},	// -
+	{148, 5},	// .
+	{153, 2},	// /
+	{155, 17},	// 0
+	{172, 4},	// 1
+	{176, 14},	// 2
+	{190, 15},	// 3
+	{205, 3}, {208, 2},	// 4
+	{210, 17},	// 5
+	{227, 23},	// 6
+	{250, 2}, {252, 2},	// 7
+	{254, 29},	// 8
+	{283, 23},	// 9
+	{306, 5}, {311, 5},	// :
+	{316, 5}, {321, 8},	// ;
+	{329, 3},	// <
+	{332, 2}, {334, 2},	// =
+	{336, 3},	// >
+	{339, 14}, {353, 5},	// ?
+	{358, 8}, {366, 19},	// @
+	{385, 2}, {387, 2}, {389, 2},	// A
+	{391, 2}, {393, 9}, {402, 10},	// B
+	{412, 18},	// C
+	{430, 2}, {432, 12},	// D
+	{444, 2}, {446, 2}, {448, 2}, {450, 2},	// E
+	{452, 2}, {454, 2}, {456, 2},	// F
+	{458, 19}, {477, 2},	// G
+	{479, 2}, {481, 2}, {483, 2},	// H
+	{485, 2},	// I
+	{487, 10},	// J
+	{497, 2}, {499, 2}, {501, 2},	// K
+	{503, 2}, {505, 2},	// L
+	{507, 2}, {509, 2}, {511, 2}, {513, 2},	// M
+	{515, 2}, {517, 2}, {519, 2},	// N
+	{521, 21},	// O
+	{542, 2}, {544, 10},	// P
+	{554, 21}, {575, 2},	// Q
+	{577, 2}, {579, 10}, {589, 2},	// R
+	{591, 20},	// S
+	{611, 2}, {613, 2},	// T
+	{615, 10},	// U
+	{625, 2}, {627, 2},	// V
+	{629, 2}, {631, 2}, {633, 2}, {635, 2},	// W
+	{637, 2}, {639, 2},	// X
+	{641, 3}, {644, 2},	// Y
+	{646, 2}, {648, 2}, {650, 2},	// Z
+	{652, 2}, {654, 2}, {656, 2}, {658, 2},	// [
+	{660, 2},	// backslash
+	{662, 2}, {664, 2}, {666, 2}, {668, 2},	// ]
+	{670, 2}, {672, 2},	// ^
+	{674, 5},	// _
+	{679, 2}, {681, 3},	// `
+	{684, 2}, {686, 14},	// a
+	{700, 2}, {702, 14},	// b
+	{716, 14},	// c
+	{730, 2}, {732, 14},	// d
+	{746, 17},	// e
+	{763, 5}, {768, 2},	// f
+	{770, 7}, {777, 14},	// g
+	{791, 2}, {793, 7},	// h
+	{800, 5}, {805, 2},	// i
+	{807, 5}, {812, 5},	// j
+	{817, 2}, {819, 2}, {821, 2},	// k
+	{823, 2},	// l
+	{825, 2}, {827, 7}, {834, 7},	// m
+	{841, 2}, {843, 7},	// n
+	{850, 17},	// o
+	{867, 2}, {869, 14},	// p
+	{883, 2}, {885, 14},	// q
+	{899, 2}, {901, 5},	// r
+	{906, 17},	// s
+	{923, 5}, {928, 2},	// t
+	{930, 7}, {937, 2},	// u
+	{939, 2}, {941, 2},	// v
+	{943, 2}, {945, 2}, {947, 2}, {949, 2},	// w
+	{951, 2}, {953, 2},	// x
+	{955, 2}, {957, 6},	// y
+	{963, 2}, {965, 2}, {967, 2},	// z
+	{969, 10}, {979, 17}, {996, 10},	// {
+	{1006, 2},	// |
+	{1008, 10}, {1018, 17}, {1035, 10},	// }
+	{1045, 11}, {1056, 11},	// ~
+	{1067, 2}, {1069, 17},	// del
+};
+
+static const float Font_v[1086][2] = {
+	// !
+	{52.381, 100}, {52.381, 33.3333},
+	{52.381, 9.5238}, {47.6191, 4.7619}, {52.381, 0}, {57.1429, 4.7619},
+	{52.381, 9.5238},
+	// "
+	{33.3334, 100}, {33.3334, 66.6667},
+	{71.4286, 100}, {71.4286, 66.6667},
+	// #
+	{54.7619, 119.048}, {21.4286, -33.3333},
+	{83.3334, 119.048}, {50, -33.3333},
+	{21.4286, 57.1429}, {88.0952, 57.1429},
+	{16.6667, 28.5714}, {83.3334, 28.5714},
+	// $
+	{42.8571, 119.048}, {42.8571, -19.0476},
+	{61.9047, 119.048}, {61.9047, -19.0476},
+	{85.7143, 85.7143}, {76.1905, 95.2381}, {61.9047, 100}, {42.8571, 100},
+	{28.5714, 95.2381}, {19.0476, 85.7143}, {19.0476, 76.1905}, {23.8095, 66.6667},
+	{28.5714, 61.9048}, {38.0952, 57.1429}, {66.6666, 47.619}, {76.1905, 42.8571},
+	{80.9524, 38.0952}, {85.7143, 28.5714}, {85.7143, 14.2857}, {76.1905, 4.7619},
+	{61.9047, 0}, {42.8571, 0}, {28.5714, 4.7619}, {19.0476, 14.2857},
+	// %
+	{95.2381, 100}, {9.5238, 0},
+	{33.3333, 100}, {42.8571, 90.4762}, {42.8571, 80.9524}, {38.0952, 71.4286},
+	{28.5714, 66.6667}, {19.0476, 66.6667}, {9.5238, 76.1905}, {9.5238, 85.7143},
+	{14.2857, 95.2381}, {23.8095, 100}, {33.3333, 100}, {42.8571, 95.2381},
+	{57.1428, 90.4762}, {71.4286, 90.4762}, {85.7143, 95.2381}, {95.2381, 100},
+	{76.1905, 33.3333}, {66.6667, 28.5714}, {61.9048, 19.0476}, {61.9048, 9.5238},
+	{71.4286, 0}, {80.9524, 0}, {90.4762, 4.7619}, {95.2381, 14.2857},
+	{95.2381, 23.8095}, {85.7143, 33.3333}, {76.1905, 33.3333},
+	// &
+	{100, 57.1429}, {100, 61.9048}, {95.2381, 66.6667}, {90.4762, 66.6667},
+	{85.7143, 61.9048}, {80.9524, 52.381}, {71.4286, 28.5714}, {61.9048, 14.2857},
+	{52.3809, 4.7619}, {42.8571, 0}, {23.8095, 0}, {14.2857, 4.7619},
+	{9.5238, 9.5238}, {4.7619, 19.0476}, {4.7619, 28.5714}, {9.5238, 38.0952},
+	{14.2857, 42.8571}, {47.619, 61.9048}, {52.3809, 66.6667}, {57.1429, 76.1905},
+	{57.1429, 85.7143}, {52.3809, 95.2381}, {42.8571, 100}, {33.3333, 95.2381},
+	{28.5714, 85.7143}, {28.5714, 76.1905}, {33.3333, 61.9048}, {42.8571, 47.619},
+	{66.6667, 14.2857}, {76.1905, 4.7619}, {85.7143, 0}, {95.2381, 0},
+	{100, 4.7619}, {100, 9.5238},
+	// '
+	{52.381, 100}, {52.381, 66.6667},
+	// (
+	{69.0476, 119.048}, {59.5238, 109.524}, {50, 95.2381}, {40.4762, 76.1905},
+	{35.7143, 52.381}, {35.7143, 33.3333}, {40.4762, 9.5238}, {50, -9.5238},
+	{59.5238, -23.8095}, {69.0476, -33.3333},
+	// )
+	{35.7143, 119.048}, {45.2381, 109.524}, {54.7619, 95.2381}, {64.2857, 76.1905},
+	{69.0476, 52.381}, {69.0476, 33.3333}, {64.2857, 9.5238}, {54.7619, -9.5238},
+	{45.2381, -23.8095}, {35.7143, -33.3333},
+	// *
+	{52.381, 71.4286}, {52.381, 14.2857},
+	{28.5715, 57.1429}, {76.1905, 28.5714},
+	{76.1905, 57.1429}, {28.5715, 28.5714},
+	// +
+	{52.3809, 85.7143}, {52.3809, 0},
+	{9.5238, 42.8571}, {95.2381, 42.8571},
+	// ,
+	{57.1429, 4.7619}, {52.381, 0}, {47.6191, 4.7619}, {52.381, 9.5238},
+	{57.1429, 4.7619}, {57.1429, -4.7619}, {52.381, -14.2857}, {47.6191, -19.0476},
+	// -
+	{9.5238, 42.8571}, {95.2381, 42.8571},
+	// .
+	{52.381, 9.5238}, {47.6191, 4.7619}, {52.381, 0}, {57.1429, 4.7619},
+	{52.381, 9.5238},
+	// /
+	{19.0476, -14.2857}, {85.7143, 100},
+	// 0
+	{47.619, 100}, {33.3333, 95.2381}, {23.8095, 80.9524}, {19.0476, 57.1429},
+	{19.0476, 42.8571}, {23.8095, 19.0476}, {33.3333, 4.7619}, {47.619, 0},
+	{57.1428, 0}, {71.4286, 4.7619}, {80.9524, 19.0476}, {85.7143, 42.8571},
+	{85.7143, 57.1429}, {80.9524, 80.9524}, {71.4286, 95.2381}, {57.1428, 100},
+	{47.619, 100},
+	// 1
+	{40.4762, 80.9524}, {50, 85.7143}, {64.2857, 100}, {64.2857, 0},
+	// 2
+	{23.8095, 76.1905}, {23.8095, 80.9524}, {28.5714, 90.4762}, {33.3333, 95.2381},
+	{42.8571, 100}, {61.9047, 100}, {71.4286, 95.2381}, {76.1905, 90.4762},
+	{80.9524, 80.9524}, {80.9524, 71.4286}, {76.1905, 61.9048}, {66.6666, 47.619},
+	{19.0476, 0}, {85.7143, 0},
+	// 3
+	{28.5714, 100}, {80.9524, 100}, {52.3809, 61.9048}, {66.6666, 61.9048},
+	{76.1905, 57.1429}, {80.9524, 52.381}, {85.7143, 38.0952}, {85.7143, 28.5714},
+	{80.9524, 14.2857}, {71.4286, 4.7619}, {57.1428, 0}, {42.8571, 0},
+	{28.5714, 4.7619}, {23.8095, 9.5238}, {19.0476, 19.0476},
+	// 4
+	{64.2857, 100}, {16.6667, 33.3333}, {88.0952, 33.3333},
+	{64.2857, 100}, {64.2857, 0},
+	// 5
+	{76.1905, 100}, {28.5714, 100}, {23.8095, 57.1429}, {28.5714, 61.9048},
+	{42.8571, 66.6667}, {57.1428, 66.6667}, {71.4286, 61.9048}, {80.9524, 52.381},
+	{85.7143, 38.0952}, {85.7143, 28.5714}, {80.9524, 14.2857}, {71.4286, 4.7619},
+	{57.1428, 0}, {42.8571, 0}, {28.5714, 4.7619}, {23.8095, 9.5238},
+	{19.0476, 19.0476},
+	// 6
+	{78.5714, 85.7143}, {73.8096, 95.2381}, {59.5238, 100}, {50, 100},
+	{35.7143, 95.2381}, {26.1905, 80.9524}, {21.4286, 57.1429}, {21.4286, 33.3333},
+	{26.1905, 14.2857}, {35.7143, 4.7619}, {50, 0}, {54.7619, 0},
+	{69.0476, 4.7619}, {78.5714, 14.2857}, {83.3334, 28.5714}, {83.3334, 33.3333},
+	{78.5714, 47.619}, {69.0476, 57.1429}, {54.7619, 61.9048}, {50, 61.9048},
+	{35.7143, 57.1429}, {26.1905, 47.619}, {21.4286, 33.3333},
+	// 7
+	{85.7143, 100}, {38.0952, 0},
+	{19.0476, 100}, {85.7143, 100},
+	// 8
+	{42.8571, 100}, {28.5714, 95.2381}, {23.8095, 85.7143}, {23.8095, 76.1905},
+	{28.5714, 66.6667}, {38.0952, 61.9048}, {57.1428, 57.1429}, {71.4286, 52.381},
+	{80.9524, 42.8571}, {85.7143, 33.3333}, {85.7143, 19.0476}, {80.9524, 9.5238},
+	{76.1905, 4.7619}, {61.9047, 0}, {42.8571, 0}, {28.5714, 4.7619},
+	{23.8095, 9.5238}, {19.0476, 19.0476}, {19.0476, 33.3333}, {23.8095, 42.8571},
+	{33.3333, 52.381}, {47.619, 57.1429}, {66.6666, 61.9048}, {76.1905, 66.6667},
+	{80.9524, 76.1905}, {80.9524, 85.7143}, {76.1905, 95.2381}, {61.9047, 100},
+	{42.8571, 100},
+	// 9
+	{83.3334, 66.6667}, {78.5714, 52.381}, {69.0476, 42.8571}, {54.7619, 38.0952},
+	{50, 38.0952}, {35.7143, 42.8571}, {26.1905, 52.381}, {21.4286, 66.6667},
+	{21.4286, 71.4286}, {26.1905, 85.7143}, {35.7143, 95.2381}, {50, 100},
+	{54.7619, 100}, {69.0476, 95.2381}, {78.5714, 85.7143}, {83.3334, 66.6667},
+	{83.3334, 42.8571}, {78.5714, 19.0476}, {69.0476, 4.7619}, {54.7619, 0},
+	{45.2381, 0}, {30.9524, 4.7619}, {26.1905, 14.2857},
+	// :
+	{52.381, 66.6667}, {47.6191, 61.9048}, {52.381, 57.1429}, {57.1429, 61.9048},
+	{52.381, 66.6667},
+	{52.381, 9.5238}, {47.6191, 4.7619}, {52.381, 0}, {57.1429, 4.7619},
+	{52.381, 9.5238},
+	// ;
+	{52.381, 66.6667}, {47.6191, 61.9048}, {52.381, 57.1429}, {57.1429, 61.9048},
+	{52.381, 66.6667},
+	{57.1429, 4.7619}, {52.381, 0}, {47.6191, 4.7619}, {52.381, 9.5238},
+	{57.1429, 4.7619}, {57.1429, -4.7619}, {52.381, -14.2857}, {47.6191, -19.0476},
+	// <
+	{90.4762, 85.7143}, {14.2857, 42.8571}, {90.4762, 0},
+	// =
+	{9.5238, 57.1429}, {95.2381, 57.1429},
+	{9.5238, 28.5714}, {95.2381, 28.5714},
+	// >
+	{14.2857, 85.7143}, {90.4762, 42.8571}, {14.2857, 0},
+	// ?
+	{23.8095, 76.1905}, {23.8095, 80.9524}, {28.5714, 90.4762}, {33.3333, 95.2381},
+	{42.8571, 100}, {61.9047, 100}, {71.4285, 95.2381}, {76.1905, 90.4762},
+	{80.9524, 80.9524}, {80.9524, 71.4286}, {76.1905, 61.9048}, {71.4285, 57.1429},
+	{52.3809, 47.619}, {52.3809, 33.3333},
+	{52.3809, 9.5238}, {47.619, 4.7619}, {52.3809, 0}, {57.1428, 4.7619},
+	{52.3809, 9.5238},
+	// @
+	{64.2857, 52.381}, {54.7619, 57.1429}, {45.2381, 57.1429}, {40.4762, 47.619},
+	{40.4762, 42.8571}, {45.2381, 33.3333}, {54.7619, 33.3333}, {64.2857, 38.0952},
+	{64.2857, 57.1429}, {64.2857, 38.0952}, {69.0476, 33.3333}, {78.5714, 33.3333},
+	{83.3334, 42.8571}, {83.3334, 47.619}, {78.5714, 61.9048}, {69.0476, 71.4286},
+	{54.7619, 76.1905}, {50, 76.1905}, {35.7143, 71.4286}, {26.1905, 61.9048},
+	{21.4286, 47.619}, {21.4286, 42.8571}, {26.1905, 28.5714}, {35.7143, 19.0476},
+	{50, 14.2857}, {54.7619, 14.2857}, {69.0476, 19.0476},
+	// A
+	{52.3809, 100}, {14.2857, 0},
+	{52.3809, 100}, {90.4762, 0},
+	{28.5714, 33.3333}, {76.1905, 33.3333},
+	// B
+	{19.0476, 100}, {19.0476, 0},
+	{19.0476, 100}, {61.9047, 100}, {76.1905, 95.2381}, {80.9524, 90.4762},
+	{85.7143, 80.9524}, {85.7143, 71.4286}, {80.9524, 61.9048}, {76.1905, 57.1429},
+	{61.9047, 52.381},
+	{19.0476, 52.381}, {61.9047, 52.381}, {76.1905, 47.619}, {80.9524, 42.8571},
+	{85.7143, 33.3333}, {85.7143, 19.0476}, {80.9524, 9.5238}, {76.1905, 4.7619},
+	{61.9047, 0}, {19.0476, 0},
+	// C
+	{88.0952, 76.1905}, {83.3334, 85.7143}, {73.8096, 95.2381}, {64.2857, 100},
+	{45.2381, 100}, {35.7143, 95.2381}, {26.1905, 85.7143}, {21.4286, 76.1905},
+	{16.6667, 61.9048}, {16.6667, 38.0952}, {21.4286, 23.8095}, {26.1905, 14.2857},
+	{35.7143, 4.7619}, {45.2381, 0}, {64.2857, 0}, {73.8096, 4.7619},
+	{83.3334, 14.2857}, {88.0952, 23.8095},
+	// D
+	{19.0476, 100}, {19.0476, 0},
+	{19.0476, 100}, {52.3809, 100}, {66.6666, 95.2381}, {76.1905, 85.7143},
+	{80.9524, 76.1905}, {85.7143, 61.9048}, {85.7143, 38.0952}, {80.9524, 23.8095},
+	{76.1905, 14.2857}, {66.6666, 4.7619}, {52.3809, 0}, {19.0476, 0},
+	// E
+	{21.4286, 100}, {21.4286, 0},
+	{21.4286, 100}, {83.3334, 100},
+	{21.4286, 52.381}, {59.5238, 52.381},
+	{21.4286, 0}, {83.3334, 0},
+	// F
+	{21.4286, 100}, {21.4286, 0},
+	{21.4286, 100}, {83.3334, 100},
+	{21.4286, 52.381}, {59.5238, 52.381},
+	// G
+	{88.0952, 76.1905}, {83.3334, 85.7143}, {73.8096, 95.2381}, {64.2857, 100},
+	{45.2381, 100}, {35.7143, 95.2381}, {26.1905, 85.7143}, {21.4286, 76.1905},
+	{16.6667, 61.9048}, {16.6667, 38.0952}, {21.4286, 23.8095}, {26.1905, 14.2857},
+	{35.7143, 4.7619}, {45.2381, 0}, {64.2857, 0}, {73.8096, 4.7619},
+	{83.3334, 14.2857}, {88.0952, 23.8095}, {88.0952, 38.0952},
+	{64.2857, 38.0952}, {88.0952, 38.0952},
+	// H
+	{19.0476, 100}, {19.0476, 0},
+	{85.7143, 100}, {85.7143, 0},
+	{19.0476, 52.381}, {85.7143, 52.381},
+	// I
+	{52.381, 100}, {52.381, 0},
+	// J
+	{76.1905, 100}, {76.1905, 23.8095}, {71.4286, 9.5238}, {66.6667, 4.7619},
+	{57.1429, 0}, {47.6191, 0}, {38.0953, 4.7619}, {33.3334, 9.5238},
+	{28.5715, 23.8095}, {28.5715, 33.3333},
+	// K
+	{19.0476, 100}, {19.0476, 0},
+	{85.7143, 100}, {19.0476, 33.3333},
+	{42.8571, 57.1429}, {85.7143, 0},
+	// L
+	{23.8095, 100}, {23.8095, 0},
+	{23.8095, 0}, {80.9524, 0},
+	// M
+	{14.2857, 100}, {14.2857, 0},
+	{14.2857, 100}, {52.3809, 0},
+	{90.4762, 100}, {52.3809, 0},
+	{90.4762, 100}, {90.4762, 0},
+	// N
+	{19.0476, 100}, {19.0476, 0},
+	{19.0476, 100}, {85.7143, 0},
+	{85.7143, 100}, {85.7143, 0},
+	// O
+	{42.8571, 100}, {33.3333, 95.2381}, {23.8095, 85.7143}, {19.0476, 76.1905},
+	{14.2857, 61.9048}, {14.2857, 38.0952}, {19.0476, 23.8095}, {23.8095, 14.2857},
+	{33.3333, 4.7619}, {42.8571, 0}, {61.9047, 0}, {71.4286, 4.7619},
+	{80.9524, 14.2857}, {85.7143, 23.8095}, {90.4762, 38.0952}, {90.4762, 61.9048},
+	{85.7143, 76.1905}, {80.9524, 85.7143}, {71.4286, 95.2381}, {61.9047, 100},
+	{42.8571, 100},
+	// P
+	{19.0476, 100}, {19.0476, 0},
+	{19.0476, 100}, {61.9047, 100}, {76.1905, 95.2381}, {80.9524, 90.4762},
+	{85.7143, 80.9524}, {85.7143, 66.6667}, {80.9524, 57.1429}, {76.1905, 52.381},
+	{61.9047, 47.619}, {19.0476, 47.619},
+	// Q
+	{42.8571, 100}, {33.3333, 95.2381}, {23.8095, 85.7143}, {19.0476, 76.1905},
+	{14.2857, 61.9048}, {14.2857, 38.0952}, {19.0476, 23.8095}, {23.8095, 14.2857},
+	{33.3333, 4.7619}, {42.8571, 0}, {61.9047, 0}, {71.4286, 4.7619},
+	{80.9524, 14.2857}, {85.7143, 23.8095}, {90.4762, 38.0952}, {90.4762, 61.9048},
+	{85.7143, 76.1905}, {80.9524, 85.7143}, {71.4286, 95.2381}, {61.9047, 100},
+	{42.8571, 100},
+	{57.1428, 19.0476}, {85.7143, -9.5238},
+	// R
+	{19.0476, 100}, {19.0476, 0},
+	{19.0476, 100}, {61.9047, 100}, {76.1905, 95.2381}, {80.9524, 90.4762},
+	{85.7143, 80.9524}, {85.7143, 71.4286}, {80.9524, 61.9048}, {76.1905, 57.1429},
+	{61.9047, 52.381}, {19.0476, 52.381},
+	{52.3809, 52.381}, {85.7143, 0},
+	// S
+	{85.7143, 85.7143}, {76.1905, 95.2381}, {61.9047, 100}, {42.8571, 100},
+	{28.5714, 95.2381}, {19.0476, 85.7143}, {19.0476, 76.1905}, {23.8095, 66.6667},
+	{28.5714, 61.9048}, {38.0952, 57.1429}, {66.6666, 47.619}, {76.1905, 42.8571},
+	{80.9524, 38.0952}, {85.7143, 28.5714}, {85.7143, 14.2857}, {76.1905, 4.7619},
+	{61.9047, 0}, {42.8571, 0}, {28.5714, 4.7619}, {19.0476, 14.2857},
+	// T
+	{52.3809, 100}, {52.3809, 0},
+	{19.0476, 100}, {85.7143, 100},
+	// U
+	{19.0476, 100}, {19.0476, 28.5714}, {23.8095, 14.2857}, {33.3333, 4.7619},
+	{47.619, 0}, {57.1428, 0}, {71.4286, 4.7619}, {80.9524, 14.2857},
+	{85.7143, 28.5714}, {85.7143, 100},
+	// V
+	{14.2857, 100}, {52.3809, 0},
+	{90.4762, 100}, {52.3809, 0},
+	// W
+	{4.7619, 100}, {28.5714, 0},
+	{52.3809, 100}, {28.5714, 0},
+	{52.3809, 100}, {76.1905, 0},
+	{100, 100}, {76.1905, 0},
+	// X
+	{19.0476, 100}, {85.7143, 0},
+	{85.7143, 100}, {19.0476, 0},
+	// Y
+	{14.2857, 100}, {52.3809, 52.381}, {52.3809, 0},
+	{90.4762, 100}, {52.3809, 52.381},
+	// Z
+	{85.7143, 100}, {19.0476, 0},
+	{19.0476, 100}, {85.7143, 100},
+	{19.0476, 0}, {85.7143, 0},
+	// [
+	{35.7143, 119.048}, {35.7143, -33.3333},
+	{40.4762, 119.048}, {40.4762, -33.3333},
+	{35.7143, 119.048}, {69.0476, 119.048},
+	{35.7143, -33.3333}, {69.0476, -33.3333},
+	// backslash
+	{19.0476, 100}, {85.7143, -14.2857},
+	// ]
+	{64.2857, 119.048}, {64.2857, -33.3333},
+	{69.0476, 119.048}, {69.0476, -33.3333},
+	{35.7143, 119.048}, {69.0476, 119.048},
+	{35.7143, -33.3333}, {69.0476, -33.3333},
+	// ^
+	{52.3809, 109.524}, {14.2857, 42.8571},
+	{52.3809, 109.524}, {90.4762, 42.8571},
+	// _
+	{0, -33.3333}, {104.762, -33.3333}, {104.762, -28.5714}, {0, -28.5714},
+	{0, -33.3333},
+	// `
+	{42.8572, 100}, {66.6667, 71.4286},
+	{42.8572, 100}, {38.0953, 95.2381}, {66.6667, 71.4286},
+	// a
+	{80.9524, 66.6667}, {80.9524, 0},
+	{80.9524, 52.381}, {71.4285, 61.9048}, {61.9047, 66.6667}, {47.619, 66.6667},
+	{38.0952, 61.9048}, {28.5714, 52.381}, {23.8095, 38.0952}, {23.8095, 28.5714},
+	{28.5714, 14.2857}, {38.0952, 4.7619}, {47.619, 0}, {61.9047, 0},
+	{71.4285, 4.7619}, {80.9524, 14.2857},
+	// b
+	{23.8095, 100}, {23.8095, 0},
+	{23.8095, 52.381}, {33.3333, 61.9048}, {42.8571, 66.6667}, {57.1428, 66.6667},
+	{66.6666, 61.9048}, {76.1905, 52.381}, {80.9524, 38.0952}, {80.9524, 28.5714},
+	{76.1905, 14.2857}, {66.6666, 4.7619}, {57.1428, 0}, {42.8571, 0},
+	{33.3333, 4.7619}, {23.8095, 14.2857},
+	// c
+	{80.9524, 52.381}, {71.4285, 61.9048}, {61.9047, 66.6667}, {47.619, 66.6667},
+	{38.0952, 61.9048}, {28.5714, 52.381}, {23.8095, 38.0952}, {23.8095, 28.5714},
+	{28.5714, 14.2857}, {38.0952, 4.7619}, {47.619, 0}, {61.9047, 0},
+	{71.4285, 4.7619}, {80.9524, 14.2857},
+	// d
+	{80.9524, 100}, {80.9524, 0},
+	{80.9524, 52.381}, {71.4285, 61.9048}, {61.9047, 66.6667}, {47.619, 66.6667},
+	{38.0952, 61.9048}, {28.5714, 52.381}, {23.8095, 38.0952}, {23.8095, 28.5714},
+	{28.5714, 14.2857}, {38.0952, 4.7619}, {47.619, 0}, {61.9047, 0},
+	{71.4285, 4.7619}, {80.9524, 14.2857},
+	// e
+	{23.8095, 38.0952}, {80.9524, 38.0952}, {80.9524, 47.619}, {76.1905, 57.1429},
+	{71.4285, 61.9048}, {61.9047, 66.6667}, {47.619, 66.6667}, {38.0952, 61.9048},
+	{28.5714, 52.381}, {23.8095, 38.0952}, {23.8095, 28.5714}, {28.5714, 14.2857},
+	{38.0952, 4.7619}, {47.619, 0}, {61.9047, 0}, {71.4285, 4.7619},
+	{80.9524, 14.2857},
+	// f
+	{71.4286, 100}, {61.9048, 100}, {52.381, 95.2381}, {47.6191, 80.9524},
+	{47.6191, 0},
+	{33.3334, 66.6667}, {66.6667, 66.6667},
+	// g
+	{80.9524, 66.6667}, {80.9524, -9.5238}, {76.1905, -23.8095},
+	{71.4285, -28.5714}, {61.9047, -33.3333}, {47.619, -33.3333},
+	{38.0952, -28.5714},
+	{80.9524, 52.381}, {71.4285, 61.9048}, {61.9047, 66.6667}, {47.619, 66.6667},
+	{38.0952, 61.9048}, {28.5714, 52.381}, {23.8095, 38.0952}, {23.8095, 28.5714},
+	{28.5714, 14.2857}, {38.0952, 4.7619}, {47.619, 0}, {61.9047, 0},
+	{71.4285, 4.7619}, {80.9524, 14.2857},
+	// h
+	{26.1905, 100}, {26.1905, 0},
+	{26.1905, 47.619}, {40.4762, 61.9048}, {50, 66.6667}, {64.2857, 66.6667},
+	{73.8095, 61.9048}, {78.5715, 47.619}, {78.5715, 0},
+	// i
+	{47.6191, 100}, {52.381, 95.2381}, {57.1429, 100}, {52.381, 104.762},
+	{47.6191, 100},
+	{52.381, 66.6667}, {52.381, 0},
+	// j
+	{57.1429, 100}, {61.9048, 95.2381}, {66.6667, 100}, {61.9048, 104.762},
+	{57.1429, 100},
+	{61.9048, 66.6667}, {61.9048, -14.2857}, {57.1429, -28.5714},
+	{47.6191, -33.3333}, {38.0953, -33.3333},
+	// k
+	{26.1905, 100}, {26.1905, 0},
+	{73.8095, 66.6667}, {26.1905, 19.0476},
+	{45.2381, 38.0952}, {78.5715, 0},
+	// l
+	{52.381, 100}, {52.381, 0},
+	// m
+	{0, 66.6667}, {0, 0},
+	{0, 47.619}, {14.2857, 61.9048}, {23.8095, 66.6667}, {38.0952, 66.6667},
+	{47.619, 61.9048}, {52.381, 47.619}, {52.381, 0},
+	{52.381, 47.619}, {66.6667, 61.9048}, {76.1905, 66.6667}, {90.4762, 66.6667},
+	{100, 61.9048}, {104.762, 47.619}, {104.762, 0},
+	// n
+	{26.1905, 66.6667}, {26.1905, 0},
+	{26.1905, 47.619}, {40.4762, 61.9048}, {50, 66.6667}, {64.2857, 66.6667},
+	{73.8095, 61.9048}, {78.5715, 47.619}, {78.5715, 0},
+	// o
+	{45.2381, 66.6667}, {35.7143, 61.9048}, {26.1905, 52.381}, {21.4286, 38.0952},
+	{21.4286, 28.5714}, {26.1905, 14.2857}, {35.7143, 4.7619}, {45.2381, 0},
+	{59.5238, 0}, {69.0476, 4.7619}, {78.5714, 14.2857}, {83.3334, 28.5714},
+	{83.3334, 38.0952}, {78.5714, 52.381}, {69.0476, 61.9048}, {59.5238, 66.6667},
+	{45.2381, 66.6667},
+	// p
+	{23.8095, 66.6667}, {23.8095, -33.3333},
+	{23.8095, 52.381}, {33.3333, 61.9048}, {42.8571, 66.6667}, {57.1428, 66.6667},
+	{66.6666, 61.9048}, {76.1905, 52.381}, {80.9524, 38.0952}, {80.9524, 28.5714},
+	{76.1905, 14.2857}, {66.6666, 4.7619}, {57.1428, 0}, {42.8571, 0},
+	{33.3333, 4.7619}, {23.8095, 14.2857},
+	// q
+	{80.9524, 66.6667}, {80.9524, -33.3333},
+	{80.9524, 52.381}, {71.4285, 61.9048}, {61.9047, 66.6667}, {47.619, 66.6667},
+	{38.0952, 61.9048}, {28.5714, 52.381}, {23.8095, 38.0952}, {23.8095, 28.5714},
+	{28.5714, 14.2857}, {38.0952, 4.7619}, {47.619, 0}, {61.9047, 0},
+	{71.4285, 4.7619}, {80.9524, 14.2857},
+	// r
+	{33.3334, 66.6667}, {33.3334, 0},
+	{33.3334, 38.0952}, {38.0953, 52.381}, {47.6191, 61.9048}, {57.1429, 66.6667},
+	{71.4286, 66.6667},
+	// s
+	{78.5715, 52.381}, {73.8095, 61.9048}, {59.5238, 66.6667}, {45.2381, 66.6667},
+	{30.9524, 61.9048}, {26.1905, 52.381}, {30.9524, 42.8571}, {40.4762, 38.0952},
+	{64.2857, 33.3333}, {73.8095, 28.5714}, {78.5715, 19.0476}, {78.5715, 14.2857},
+	{73.8095, 4.7619}, {59.5238, 0}, {45.2381, 0}, {30.9524, 4.7619},
+	{26.1905, 14.2857},
+	// t
+	{47.6191, 100}, {47.6191, 19.0476}, {52.381, 4.7619}, {61.9048, 0},
+	{71.4286, 0},
+	{33.3334, 66.6667}, {66.6667, 66.6667},
+	// u
+	{26.1905, 66.6667}, {26.1905, 19.0476}, {30.9524, 4.7619}, {40.4762, 0},
+	{54.7619, 0}, {64.2857, 4.7619}, {78.5715, 19.0476},
+	{78.5715, 66.6667}, {78.5715, 0},
+	// v
+	{23.8095, 66.6667}, {52.3809, 0},
+	{80.9524, 66.6667}, {52.3809, 0},
+	// w
+	{14.2857, 66.6667}, {33.3333, 0},
+	{52.3809, 66.6667}, {33.3333, 0},
+	{52.3809, 66.6667}, {71.4286, 0},
+	{90.4762, 66.6667}, {71.4286, 0},
+	// x
+	{26.1905, 66.6667}, {78.5715, 0},
+	{78.5715, 66.6667}, {26.1905, 0},
+	// y
+	{26.1905, 66.6667}, {54.7619, 0},
+	{83.3334, 66.6667}, {54.7619, 0}, {45.2381, -19.0476}, {35.7143, -28.5714},
+	{26.1905, -33.3333}, {21.4286, -33.3333},
+	// z
+	{78.5715, 66.6667}, {26.1905, 0},
+	{26.1905, 66.6667}, {78.5715, 66.6667},
+	{26.1905, 0}, {78.5715, 0},
+	// {
+	{64.2857, 119.048}, {54.7619, 114.286}, {50, 109.524}, {45.2381, 100},
+	{45.2381, 90.4762}, {50, 80.9524}, {54.7619, 76.1905}, {59.5238, 66.6667},
+	{59.5238, 57.1429}, {50, 47.619},
+	{54.7619, 114.286}, {50, 104.762}, {50, 95.2381}, {54.7619, 85.7143},
+	{59.5238, 80.9524}, {64.2857, 71.4286}, {64.2857, 61.9048}, {59.5238, 52.381},
+	{40.4762, 42.8571}, {59.5238, 33.3333}, {64.2857, 23.8095}, {64.2857, 14.2857},
+	{59.5238, 4.7619}, {54.7619, 0}, {50, -9.5238}, {50, -19.0476},
+	{54.7619, -28.5714},
+	{50, 38.0952}, {59.5238, 28.5714}, {59.5238, 19.0476}, {54.7619, 9.5238},
+	{50, 4.7619}, {45.2381, -4.7619}, {45.2381, -14.2857}, {50, -23.8095},
+	{54.7619, -28.5714}, {64.2857, -33.3333},
+	// |
+	{52.381, 119.048}, {52.381, -33.3333},
+	// }
+	{40.4762, 119.048}, {50, 114.286}, {54.7619, 109.524}, {59.5238, 100},
+	{59.5238, 90.4762}, {54.7619, 80.9524}, {50, 76.1905}, {45.2381, 66.6667},
+	{45.2381, 57.1429}, {54.7619, 47.619},
+	{50, 114.286}, {54.7619, 104.762}, {54.7619, 95.2381}, {50, 85.7143},
+	{45.2381, 80.9524}, {40.4762, 71.4286}, {40.4762, 61.9048}, {45.2381, 52.381},
+	{64.2857, 42.8571}, {45.2381, 33.3333}, {40.4762, 23.8095}, {40.4762, 14.2857},
+	{45.2381, 4.7619}, {50, 0}, {54.7619, -9.5238}, {54.7619, -19.0476},
+	{50, -28.5714},
+	{54.7619, 38.0952}, {45.2381, 28.5714}, {45.2381, 19.0476}, {50, 9.5238},
+	{54.7619, 4.7619}, {59.5238, -4.7619}, {59.5238, -14.2857},
+	{54.7619, -23.8095}, {50, -28.5714}, {40.4762, -33.3333},
+	// ~
+	{9.5238, 28.5714}, {9.5238, 38.0952}, {14.2857, 52.381}, {23.8095, 57.1429},
+	{33.3333, 57.1429}, {42.8571, 52.381}, {61.9048, 38.0952}, {71.4286, 33.3333},
+	{80.9524, 33.3333}, {90.4762, 38.0952}, {95.2381, 47.619},
+	{9.5238, 38.0952}, {14.2857, 47.619}, {23.8095, 52.381}, {33.3333, 52.381},
+	{42.8571, 47.619}, {61.9048, 33.3333}, {71.4286, 28.5714}, {80.9524, 28.5714},
+	{90.4762, 33.3333}, {95.2381, 47.619}, {95.2381, 57.1429},
+	// del
+	{71.4286, 100}, {33.3333, -33.3333},
+	{47.619, 66.6667}, {33.3333, 61.9048}, {23.8095, 52.381}, {19.0476, 38.0952},
+	{19.0476, 23.8095}, {23.8095, 14.2857}, {33.3333, 4.7619}, {47.619, 0},
+	{57.1428, 0}, {71.4286, 4.7619}, {80.9524, 14.2857}, {85.7143, 28.5714},
+	{85.7143, 42.8571}, {80.9524, 52.381}, {71.4286, 61.9048}, {57.1428, 66.6667},
+	{47.619, 66.6667},
+};
+
+#endif
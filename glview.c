@@ -1,16 +1,30 @@
+#define _GNU_SOURCE		// for FNM_LEADING_DIR
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <errno.h>
 #include <time.h>
 #include <values.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <stddef.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/fcntl.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>		// the culling kernels, see cull_span()
+#endif
+#define	GL_GLEXT_PROTOTYPES	// shader and instancing entry points (checked at run time)
 #include <GL/glut.h>		// if missing: apt-get install freeglut3-dev
+#include "glview.h"
+#include "font.h"		// the stroke font
 // Missing GL defines?
 #define	GLUT_WHEEL_UP_BUTTON	3
 #define	GLUT_WHEEL_DOWN_BUTTON	4
@@ -27,12 +41,19 @@
 //              Arc x1 y1 radius start_angle delta_angle
 //              Triangle x1 y1 x2 y2 x3 y3
 //              Text x1 y1 angle scale "string"
+//              Polygon x1 y1 x2 y2 ...         # any shape, more x y pairs can follow on the next lines
+//              Hole x1 y1 x2 y2 ...            # ... a hole in it (any number, after the outline)
+//              End                             # ... end of the polygon (optional)
 //
 //              Color cr cg cb          # 0-255 for each color
-//              Fill                    # Rectangle, Circle, Triangle are filled
-//              Wire                    # Rectangle, Circle, Triangle are wire-frame
+//              Fill                    # Rectangle, Circle, Triangle, Polygon are filled
+//              Wire                    # Rectangle, Circle, Triangle, Polygon are wire-frame
 //              Width w                 # Line, Point, Arc, Text width is 'w' (min arc width is always 2)
-//              Layer n                 # Draw on layer n (n=1-12)
+//              Layer n                 # Draw on layer n (n=1-65536)
+//              Layer n name            # ... and name it, '/' in names groups layers (eg. top/copper)
+//              Layer name              # Draw on the named layer (a new name gets the next unused number)
+//              Frame n                 # What follows is added in animation frame n (n increasing)
+//              Remove object           # Remove object (eg. Remove Line 1 2 3 4) added in an earlier frame
 //
 //      coordinates (x1,y1) (x2,y2) (x3,y3) in signed int range (+/-2000000000)
 //      angle   degrees, for Text:
@@ -43,6 +64,10 @@
 //      scale           text scale factor (when scale=N each letter fills an NxN unit square) max=1000000
 //      start_angle     degree to start drawing arc
 //      delta_angle     number of degrees to draw (+ccw, -cw)
+//      Polygon lines hold at most 49 x y pairs, a line of just pairs continues the
+//      current outline or hole.  Polygons may be concave and self-intersecting.
+//
+//      Layers are drawn in increasing order, objects on a layer in input order.
 //
 //      Starting defaults:
 //              Color 255 255 255
@@ -56,11 +81,67 @@
 //              'q'/ESC         quit
 //              'a'             all layers on
 //              F1-F12          toggle layer 1-12 (alternative: 1-9,0 for layers 1-10)
+//              ',' '.'         previous/next frame, 'p' play/pause the frames
+//              'd'             toggle heatmaps for --density layers
+//              't'             toggle --declutter
+//              'm'             toggle the minimap, click in it to move the view there
+//              'v' 'V'         split the window, adding a view next to the one under the mouse,
+//                              or close that view; each view has its own position and layers
+//              's'             toggle analytic (shader) drawing of circles, arcs and wide lines
+//              'l'             layer prompt (in the title bar), Enter applies it:
+//                                pattern       toggle matching layers
+//                                +pattern      show matching layers
+//                                -pattern      hide matching layers
+//                                =pattern      show only matching layers
+//                              patterns are shell wildcards on layer names or numbers,
+//                              comma separated, and a group name matches all its layers
+//              '/'             search prompt: show Text containing the text (any case),
+//                              ^text for Text starting with it
+//              'n' 'N'         next/previous search match
 //              Home            return to original view
 //              Left/Right      Rotate X (+Ctrl for finer change)
 //              Up/Down         Rotate Y (+Ctrl for finer change)
 //              PgUp/PgDn       Rotate Z (+Ctrl for finer change)
 //
+//      Options:
+//              --export file.ppm       render the whole drawing to a PPM image instead of a window
+//              --size WxH              export image size in pixels (default 8192x8192)
+//              --tile n                export tile size in pixels (default 512)
+//              --threads n             worker threads (default: one per cpu)
+//              --dedup                 remove duplicate objects (same layer, geometry and state) at load
+//              --dedup-loose           ... also counting reversed Lines, Rectangle corners and Triangle
+//                                      vertices in another order as duplicates
+//              --merge                 merge abutting collinear Lines with the same state at load
+//              --simplify tol          ... and simplify chains of Lines, moving them at most tol units
+//              --record file           log input events and the view to a session file
+//              --replay file           replay a session, then print frame render times and exit
+//              --headless              ... without a window, using the software renderer
+//                                      (the view's rotation is ignored)
+//              --density spec          draw matching layers as heatmaps when they're crowded
+//              --frame n               start at (or export) frame n
+//              --fps n                 frame playback rate (default 30)
+//              --compact               keep objects packed (16 bit tile offsets, palette colors)
+//              --declutter             draw only the Text that's big enough to read and doesn't overlap
+//                                      bigger Text, placed again whenever the view changes
+//              --minimap               show an overview of the whole drawing
+//              --build-store dir       bin the input file into a tiled on-disk store in dir, then exit
+//              --store-grid n          ... with n x n tiles (default 128)
+//              --store dir             view a store, loading the tiles around the view
+//              --cache MB              ... keeping at most this much loaded (default 1024); without
+//                                      --store, the most the layer images may take
+//              --no-sidecar            don't read or write file.glvc, the cache of what's loaded from file
+//              --diff old new          show what changed from old to new: layer groups unchanged/ (gray),
+//                                      removed/ (red) and added/ (green)
+//              --shaders               draw circles, arcs and wide lines with shaders (needs OpenGL 3.3)
+//              --layers spec           initial layer selection, as at the 'l' prompt (default =spec)
+//              --budget ms             frame time budget while moving the view, and for each pass of
+//                                      a full quality frame, 0 to always draw full quality in one
+//                                      go (default 16)
+//
+//      Built with -DGLVIEW_LIB (make libglview.a) this is a library instead:
+//      a program hands the objects over with the calls in glview.h and runs
+//      the viewer in-process, see hilbert --view and tgen --view.
+//
 
 #define	MAXBUF		10240	// max input line length
 #define	MAXTOKENS	100	// max tokens on any line
@@ -69,7 +150,6 @@
 
 #define	LARGE		2000000000	// largest allowed coordinate value
 #define	MIN_TEXT_SCALE	0.00954	// scale that makes text fill a 1x1 unit (1/104.76)
-#define	STROKE_FONT	GLUT_STROKE_MONO_ROMAN	// or GLUT_STROKE_ROMAN
 #define	BITMAP_FONT	GLUT_BITMAP_9_BY_15	// or TIMES_ROMAN_24, HELVETICA_18
 #define	ZOOM_MIN	0.0001
 #define	ZOOM_MAX	100.0
@@ -80,9 +160,38 @@
 #define	ROT_STEP	(360.0/(double)64)	// image rotation increment
 #define	ROT_STEP_FINE	(ROT_STEP/4)	// image rotation increment fine
 #define	CIRCLE_STEPS	128	// how many lines to draw a circle?
+#define	COARSE_STEPS	16	// ... while the view is moving
+#define	REFRESH_HZ	60	// display refresh rate to pace redraws to
+#define	IDLE_REFINE_MS	200	// full quality redraw after this much input idle time
+#define	DENSE_LAYER	10000	// layers with more objects are decimated while moving
+#define	MAX_DECIMATE	64	// draw at least every Nth object of a dense layer
+#define	GREEK_PIXELS	4	// text smaller than this is drawn as a bar
+#define	ATLAS_PIXELS	24	// and smaller than this with the glyph atlas
+#define	ATLAS_COLS	16	// glyph atlas: 128 characters as 16x8 cells
+#define	ATLAS_ROWS	8
+#define	ATLAS_CELL	32	// pixels per character width, cells are twice as tall
+#define	DEF_FPS		30	// frame playback rate
+#define	DENSITY_CELL	2	// heatmap cell size, pixels
+#define	DENSITY_MIN	0.25	// objects per pixel above which a layer is a heatmap
+#define	LAYER_CHUNK	65536	// objects binned by one thread at a time, or drawn in one piece
+#define	STORE_GRID	128	// default --store-grid, tiles along each side
+#define	STORE_SUMMARY	8	// summary cells along each side of a tile
+#define	STORE_SUMMARY_PIXELS	128	// tiles smaller than this on screen are drawn from their summary
+#define	STORE_FLUSH	(256<<20)	// bytes of records buffered while building a store
+#define	STORE_POLL_MS	50	// while tiles are being loaded
+#define	DEF_CACHE_MB	1024	// default --cache
+#define	MINIMAP_SIZE	256	// longest side of the minimap, pixels
+#define	MINIMAP_MARGIN	8	// from the window's top right corner
+#define	MINIMAP_POLL_MS	100	// while the overview is being rendered
+#define	MAX_VIEWS	4	// side by side views in the window
 #define	TWO_PI		(M_PI*2)
-#define	MAX_LAYERS	12
+#define	MAX_LAYERS	65536
 #define	LAYER_SEP	100
+#define	MAX_THREADS	256
+
+#define	DEF_EXPORT_SIZE	8192	// default --size
+#define	DEF_EXPORT_TILE	512	// default --tile
+#define	MAX_EXPORT_SIZE	(1<<20)	// largest exported image dimension
 
 #define	DEF_LINE_WIDTH	1	// default line (and point) width
 #define	DEF_RED		255
@@ -102,7 +211,101 @@ double PanX = 0.0;
 double PanY = 0.0;
 
 double Zoom_min = ZOOM_MIN;
-int Layer[MAX_LAYERS + 1] = { 0 };
+
+// a layer's full quality batch, see render_begin()
+struct batch
+{
+	GLuint list;		// a display list per chunk from here, 0 when not built
+	unsigned char *built;	// which chunks' lists are built
+	int nbuilt;		// and how many
+	int texts;		// Text objects in the lists
+	int text_zoom;		// text_zoom() they were built at
+	unsigned int drawn;	// Views_drawn when it was last picked
+};
+
+// layers
+struct layer
+{
+	int number;
+	char *name;		// NULL if unnamed
+	struct object *obj;	// objects on this layer, in input order, NULL when packed
+	int n;			// number of objects
+	int max;		// allocated size of obj[]
+	unsigned char *packed;	// --compact: the objects packed, see compact()
+	size_t size;		// bytes in packed[]
+	int (*tiles)[2];	// tile of each packed tile index
+	int ntiles;
+	struct batch batch[MAX_VIEWS];	// full quality batches, more than one when views draw its Text at different zooms
+	struct batch *full;	// the one being drawn
+	GLuint coarse;		// render batch while interacting
+	int coarse_decimate;	// Decimate the coarse batch was built with
+	struct run *runs;	// shader render batch, NULL when not built
+	int nruns;
+	GLuint vbo;		// instances for the shader runs
+	int texts;		// Text objects in the shader batch
+	int text_zoom;		// text_zoom() the shader batch was built at
+	int *born;		// Frame: frame each object appears in, NULL without frames
+	int *died;		// and the one it's removed in (INT_MAX if never)
+	struct segment *seg;	// objects born in the same frame, with their batch
+	int nseg;
+	int density;		// --density: drawn as a heatmap when crowded
+	double ext[4];		// bounds of the objects, see layer_chunks()
+	size_t *chunk;		// where every LAYER_CHUNK'th object starts
+	int nchunk;
+	GLuint heat[MAX_VIEWS];	// heatmap texture of each view
+	double heat_view[MAX_VIEWS][5];	// Zoom, PanX, PanY, width, height it was made for
+	int heat_frame[MAX_VIEWS];	// and Frame_now
+	struct cull *cull;	// software renderer's bounds, see cull_boxes()
+	double (*chunk_box)[4];	// bounds of each chunk, see layer_chunks()
+	int *chunk_width;	// and its widest line
+	struct occluder *occ;	// big filled shapes, see occ_init()
+	int nocc;
+	struct record_job *record;	// a recording job per chunk, see record_begin()
+	unsigned int record_gen;	// changed when the batch is thrown away
+	GLuint cache_tex, cache_fbo;	// image of the layer in the cached view, see cache_begin()
+	int cached;		// it's up to date: CACHE_DRAWN, or CACHE_HIDDEN while cache_after is
+	unsigned int cache_after;	// the layers after it that were shown, when some of it was hidden
+	int label_first[MAX_VIEWS], nlabels[MAX_VIEWS];	// its Text kept by labels_place() in each view
+};
+struct layer *Layers[MAX_LAYERS + 1];	// by layer number, NULL when unused
+int Layer_order[MAX_LAYERS];	// used layer numbers in drawing order
+int Nlayers = 0;		// number of used layers
+unsigned int Layer_vis[(MAX_LAYERS + 32) / 32];	// visibility, one bit per layer number
+unsigned int Layer_vis_gen = 0;	// changed with Layer_vis
+int Layer_hash[MAX_LAYERS * 2];	// layer number by name hash, 0 when empty
+char *Layers_spec = NULL;	// --layers
+int Shaders = 0;		// --shaders: draw with the analytic shaders
+GLuint Shader_program = 0;	// 0 when shaders are not available
+GLint Shader_pixel;		// uniform: model units per pixel
+GLuint Corner_vbo;		// the unit quad every instance is drawn with
+int Dedup = 0;			// --dedup (1) or --dedup-loose (2)
+int Merge = 0;			// --merge
+double Simplify = 0;		// --simplify tolerance
+int Compact = 0;		// --compact
+int Declutter = 0;		// --declutter: draw only the Text that doesn't overlap
+unsigned char Palette[256][3];	// colors of packed objects
+int Npalette = 0;
+
+// session recording and replay
+char *Record_file = NULL;	// --record
+char *Replay_file = NULL;	// --replay
+int Headless = 0;		// --headless
+FILE *Record_fp = NULL;
+double Session_start;		// time the recording or replay started
+int Mods = 0;			// modifier keys of the current input event
+int Redisplay = 0;		// headless: a redraw was requested
+int Win_w, Win_h;		// window size (Win_w: of the current view, see view_layout())
+int Nviews = 1;			// views the window is split into
+int View_at = 0;		// the current view, in the globals (see View[])
+unsigned int Views_drawn = 0;	// views drawn so far, see batch_pick()
+double *Frame_times = NULL;	// replay: render time of every frame
+int Nframes = 0;
+int Max_frames = 0;
+
+// prompt in the title bar
+char Prompt[MAXSTRING];		// text typed so far
+char *Prompt_label;
+void (*Prompt_done) (char *text) = NULL;	// called on Enter, NULL when not prompting
 
 char *Title = "Viewer";
 
@@ -114,14 +317,35 @@ double PanY_home;		// original PanY
 int Moveactive = 0;
 int Movex, Movey;
 
+// adaptive quality while the view is moving
+int Budget_ms = 1000 / REFRESH_HZ;	// --budget, frame time budget while moving or refining (0: always full quality)
+int Interacting = 0;		// draw a degraded view
+int Decimate = 1;		// while interacting, draw every Nth object of dense layers
+GLuint Atlas = 0;		// glyph atlas texture
+__thread int Text_count;	// Text objects drawn since it was last cleared
+int Minimap = 0;		// --minimap: show the overview inset
+__thread int Circle_steps = CIRCLE_STEPS;	// circle and arc tessellation
+double Last_input;		// time of the last view change
+double Last_frame;		// time the last frame was started
+double Frame_time;		// seconds taken to draw the last frame
+int Redraw_pending = 0;		// a paced redraw timer is armed
+int Refine_pending = 0;		// the full quality redraw timer is armed
+
 // bounding rectangle
 int Maxx = -(LARGE - 1);
 int Maxy = -(LARGE - 1);
 int Minx = LARGE + 1;
 int Miny = LARGE + 1;
 
-int Width = DEF_LINE_WIDTH;	// current line width
-int Fill = GL_FILL;		// current fill mode
+__thread int Width = DEF_LINE_WIDTH;	// current line width (per thread, see record_run())
+__thread int Fill = DEF_POLY;	// current fill mode
+
+// command line options
+char *Export_file = NULL;	// --export
+int Export_width = DEF_EXPORT_SIZE;	// --size
+int Export_height = DEF_EXPORT_SIZE;
+int Export_tile = DEF_EXPORT_TILE;	// --tile
+int Threads = 0;		// --threads (0 means one per cpu)
 
 // Display object types
 #define	TYPE_NONE	0
@@ -132,18 +356,23 @@ int Fill = GL_FILL;		// current fill mode
 #define	TYPE_ARC	5
 #define	TYPE_TRIANGLE	6
 #define	TYPE_TEXT	7
-#define	TYPE_COLOR	8
-#define	TYPE_FILL	9
-#define	TYPE_WIDTH	10
+#define	TYPE_POLYGON	8
 
+// A drawing primitive, with the drawing state (Color, Width, Fill/Wire) in
+// effect when it was read.
 struct object
 {
-	struct object *next;
-	struct object *prev;
 	int type;
 	int layer;
 	int arg[6];		// maximum # of integer arguments
-	char *text;		// at most, a single text argument
+	union
+	{
+		char *text;	// at most, a single text argument
+		struct polygon *poly;	// Polygon outline, holes and triangles
+	};
+	int width;		// Width
+	unsigned char rgb[3];	// Color
+	unsigned char filled;	// Fill (1) or Wire (0)
 };
 #define	X1	o->arg[0]
 #define	Y1	o->arg[1]
@@ -151,25 +380,55 @@ struct object
 #define	Y2	o->arg[3]
 #define	X3	o->arg[4]
 #define	Y3	o->arg[5]
-#define	CR	o->arg[0]
-#define	CG	o->arg[1]
-#define	CB	o->arg[2]
-#define	WIDTH	o->arg[0]
 #define	ROTATE	o->arg[2]
 #define	RADIUS	o->arg[2]
 #define	DSTART	o->arg[3]
 #define	DDELTA	o->arg[4]
 #define	SCALE	o->arg[3]
-#define	FILL	o->arg[0]
 #define	TEXT	o->text
+#define	POLY	o->poly		// arg[0..3] are its bounds
 #define	LAYER	o->layer
+#define	WIDTH	o->width
+#define	FILLED	o->filled
+#define	POLYMODE	(o->filled ? GL_FILL : GL_LINE)
 
-struct object Objects = {
-	.next = &Objects,
-	.prev = &Objects,
-	.type = TYPE_NONE,
+// a Polygon's contours, and the triangles that fill it
+struct polygon
+{
+	int n;			// vertices
+	int *xy;		// x,y pairs, contour by contour
+	int ncontours;
+	int *contour;		// vertices in each contour, the outline first then holes
+	int ntri;		// triangles
+	int *tri;		// x1,y1,x2,y2,x3,y3 for each triangle
 };
 
+struct polygon **Polygons;	// every Polygon read, to be tessellated
+int Npolygons = 0;
+
+// frames
+int *Frames;			// the frame numbers used, in order
+int Frame_count = 0;		// 0 when there's no Frame in the input
+int Frame_read = 0;		// frame being read
+int Frame_at = 0;		// Frames[] index shown
+int Frame_now = 0;		// and its frame number
+int Removing = 0;		// reading a Remove, object_add() saves it in Removals
+struct removal *Removals;
+int Nremovals = 0;
+int Fps = DEF_FPS;		// --fps
+int Start_frame = 0;		// --frame
+int Playing = 0;		// frames are being played
+char *Density_spec = NULL;	// --density
+int Density = 0;		// draw crowded --density layers as heatmaps
+struct object *(*Object_sink) (struct object *o) = NULL;	// when set, object_add() hands objects to it
+int Sink_polygons = 0;		// Polygons dropped while it was set
+char *Store_dir = NULL;		// --store
+char *Build_dir = NULL;		// --build-store
+int Store_grid = STORE_GRID;	// --store-grid
+int Cache_mb = DEF_CACHE_MB;	// --cache
+int Sidecar_on = 1;		// --no-sidecar clears it
+int Diff_on = 0;		// --diff
+
 // Utilities --------------------------------------------------------------------
 
 //      fatal --- print error message and exit
@@ -220,6 +479,16 @@ must_zalloc (int size)
 	return vp;
 }
 
+// seconds since an arbitrary starting point
+static inline double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 //
 //      strsave --- save a string somewhere safe
 //
@@ -294,54 +563,222 @@ tokenize (char *s, char **tokens, int ntokens)
 	return tokens - itokens;
 }
 
-// Doubly linked lists --------------------------------------------------------------------
+// Worker threads --------------------------------------------------------------------
 
-// Walk every element in a list from the head, using o as the list item
-#define	OBJECT_WALK(head,o)	for((o)=(head)->next; (o) != (head); (o)=(o)->next)
+struct parallel
+{
+	void (*fn) (void *arg, int index, int thread);
+	void *arg;
+	int n;
+	int next;		// next index to hand out
+};
 
-static inline struct object *
-object_alloc (void)
+struct parallel_thread
 {
-	struct object *o = must_zalloc (sizeof (*o));
+	struct parallel *p;
+	int thread;
+};
 
-	o->next = o->prev = o;
-	o->type = TYPE_NONE;
-	o->text = NULL;
-	return o;
+static inline int
+nthreads (void)
+{
+	long n = Threads;
+
+	if (n <= 0)
+		n = sysconf (_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		n = 1;
+	if (n > MAX_THREADS)
+		n = MAX_THREADS;
+	return n;
 }
 
-static inline struct object *
-object_new (int type, int arg1, int arg2, int arg3, int arg4, int arg5, int arg6, char *text, int layer)
-{
-	struct object *o = object_alloc ();
-
-	o->type = type;
-	o->arg[0] = arg1;
-	o->arg[1] = arg2;
-	o->arg[2] = arg3;
-	o->arg[3] = arg4;
-	o->arg[4] = arg5;
-	o->arg[5] = arg6;
-	o->text = text;
-	o->layer = layer;
-	return o;
+static void *
+parallel_worker (void *arg)
+{
+	struct parallel_thread *t = arg;
+	struct parallel *p = t->p;
+	int i;
+
+	while ((i = __sync_fetch_and_add (&p->next, 1)) < p->n)
+		p->fn (p->arg, i, t->thread);
+	return NULL;
 }
 
-static inline void
-object_add (struct object *a, struct object *b)
+//
+//      parallel_for --- call fn(arg,i,thread) for every i in 0..n-1
+//
+//      Indices are handed out one at a time to nthreads() workers, so
+//      fn must be safe to run concurrently for different indices.  The
+//      thread argument (0..nthreads()-1) identifies the calling worker
+//      and can be used to pick per-thread scratch space.
+//
+void
+parallel_for (int n, void (*fn) (void *arg, int index, int thread), void *arg)
 {
-	struct object *an = a->next;
+	struct parallel p = {.fn = fn,.arg = arg,.n = n,.next = 0 };
+	struct parallel_thread t[MAX_THREADS];
+	pthread_t tid[MAX_THREADS];
+	int i, nt = nthreads ();
 
-	b->next = an;
-	b->prev = a;
-	a->next = an->prev = b;
+	if (nt > n)
+		nt = n;
+	for (i = 0; i < nt; i++) {
+		t[i].p = &p;
+		t[i].thread = i;
+		if (i > 0 && pthread_create (&tid[i], NULL, parallel_worker, &t[i]) != 0)
+			fatal ("Can't create thread");
+	}
+	if (nt > 0)
+		parallel_worker (&t[0]);	// the caller is worker 0
+	for (i = 1; i < nt; i++)
+		pthread_join (tid[i], NULL);
 }
 
-static inline void
-object_remove (struct object *o)
+// Layers and the object store --------------------------------------------------------
+
+// Walk every object on a layer, using o as the object
+#define	OBJECT_WALK(L,o)	for((o)=(L)->obj; (o) < (L)->obj + (L)->n; (o)++)
+
+// Walk every used layer in drawing order
+#define	LAYER_WALK(i,L)		for((i)=0; (i) < Nlayers && ((L)=Layers[Layer_order[i]]) != NULL; (i)++)
+
+#define	layer_visible(l)	((Layer_vis[(l) >> 5] >> ((l) & 31)) & 1)
+#define	layer_show(l,on)	(Layer_vis_gen++, Layer_vis[(l) >> 5] = (on) ? (Layer_vis[(l) >> 5] | (1u << ((l) & 31))) : (Layer_vis[(l) >> 5] & ~(1u << ((l) & 31))))
+#define	layer_toggle(l)		(Layer_vis_gen++, Layer_vis[(l) >> 5] ^= (1u << ((l) & 31)))
+
+// a Remove, matched with the object it removes by frames_resolve()
+struct removal
+{
+	struct object o;
+	int frame;
+	int seq;		// input order
+};
+
+static struct object *
+removal_add (struct object *o)
+{
+	if ((Nremovals & 1023) == 0 && (Removals = realloc (Removals, (Nremovals + 1024) * sizeof (*Removals))) == NULL)
+		fatal ("Can't grow removals");
+	Removals[Nremovals].o = *o;
+	Removals[Nremovals].frame = Frame_read;
+	Removals[Nremovals].seq = Nremovals;
+	return &Removals[Nremovals++].o;
+}
+
+// layer n, created if needed
+static struct layer *
+layer_get (int n)
+{
+	struct layer *L = Layers[n];
+	int i;
+
+	if (L != NULL)
+		return L;
+	L = Layers[n] = must_zalloc (sizeof (*L));
+	L->number = n;
+	for (i = Nlayers++; i > 0 && Layer_order[i - 1] > n; i--)	// keep the drawing order sorted
+		Layer_order[i] = Layer_order[i - 1];
+	Layer_order[i] = n;
+	return L;
+}
+
+static inline unsigned int
+name_hash (char *s)
+{
+	unsigned int h = 5381;
+
+	while (*s)
+		h = h * 33 + (unsigned char) *s++;
+	return h;
+}
+
+// slot in Layer_hash[] for a name: either the layer with that name, or an empty slot
+static int *
+layer_slot (char *name)
+{
+	unsigned int h = name_hash (name) % (MAX_LAYERS * 2);
+
+	while (Layer_hash[h] != 0 && strcmp (Layers[Layer_hash[h]]->name, name) != 0)
+		h = (h + 1) % (MAX_LAYERS * 2);
+	return &Layer_hash[h];
+}
+
+// number of the layer called 'name', a new unused one if there isn't one yet
+static int
+layer_named (char *name)
+{
+	int *slot = layer_slot (name);
+	int n;
+
+	if (*slot != 0)
+		return *slot;
+	n = (Nlayers > 0) ? Layer_order[Nlayers - 1] + 1 : 1;	// after the highest used layer ...
+	if (n > MAX_LAYERS)
+		for (n = 1; n <= MAX_LAYERS && Layers[n] != NULL; n++);	// ... or the first free one
+	if (n > MAX_LAYERS)
+		fatal ("Too many layers for %s", name);
+	layer_get (n)->name = strsave (name);
+	return *slot = n;
+}
+
+// name layer n (if it isn't already)
+static void
+layer_name (int n, char *name)
+{
+	struct layer *L = layer_get (n);
+	int *slot;
+
+	if (L->name != NULL)
+		return;
+	if (*(slot = layer_slot (name)) != 0)
+		return;		// name already used by another layer
+	L->name = strsave (name);
+	*slot = n;
+}
+
+// append an object to its layer, returns where it was stored
+static struct object *
+object_add (struct object *o)
+{
+	struct layer *L;
+
+	if (Object_sink != NULL)	// not kept, Removes are ignored
+		return Removing ? o : Object_sink (o);
+	if (Removing)
+		return removal_add (o);
+	L = layer_get (o->layer);
+	if (L->n == L->max) {
+		L->max = L->max ? L->max * 2 : 64;
+		if ((L->obj = realloc (L->obj, L->max * sizeof (*L->obj))) == NULL)
+			fatal ("Can't grow layer %d to %d objects", L->number, L->max);
+		if (L->born != NULL && (L->born = realloc (L->born, L->max * sizeof (*L->born))) == NULL)
+			fatal ("Can't grow layer %d frames", L->number);
+	}
+	if (Frame_count > 0) {
+		if (L->born == NULL)	// objects before the first Frame are in all of them
+			L->born = must_zalloc (L->max * sizeof (*L->born));
+		L->born[L->n] = Frame_read;
+	}
+	L->obj[L->n] = *o;
+	return &L->obj[L->n++];
+}
+
+// object of the given type with the drawing state in 'state'
+static inline struct object *
+object_new (struct object *state, int type, int arg1, int arg2, int arg3, int arg4, int arg5, int arg6, char *text)
 {
-	o->next->prev = o->prev;
-	o->prev->next = o->next;
+	struct object o = *state;
+
+	o.type = type;
+	o.arg[0] = arg1;
+	o.arg[1] = arg2;
+	o.arg[2] = arg3;
+	o.arg[3] = arg4;
+	o.arg[4] = arg5;
+	o.arg[5] = arg6;
+	o.text = text;
+	return object_add (&o);
 }
 
 // --------------------------------------------------------------------
@@ -479,403 +916,7190 @@ min_max_point (int x, int y)
 		Maxy = y;
 }
 
+// arcs of width <2 would be invisible
+static inline int
+arc_width (int width)
+{
+	return (width >= 2) ? width : 2;
+}
+
+//
+//      object_extent --- conservative model space bounds of a drawable object
+//
+//      Includes the wide line/arc/point width of the object.  Text is
+//      bounded by a square around its origin that covers any rotation.
+//      Returns 0 for objects that draw nothing.
+//
+static int
+object_extent (struct object *o, double b[4])
+{
+	double r;
+	int width = WIDTH;
+
+	switch (o->type) {
+	case TYPE_LINE:
+	case TYPE_RECT:
+		r = (o->type == TYPE_LINE) ? width / 2 : 0;
+		b[0] = (X1 < X2 ? X1 : X2) - r;
+		b[1] = (Y1 < Y2 ? Y1 : Y2) - r;
+		b[2] = (X1 > X2 ? X1 : X2) + r;
+		b[3] = (Y1 > Y2 ? Y1 : Y2) + r;
+		return 1;
+	case TYPE_POLYGON:
+		r = o->filled ? 0 : width / 2;
+		b[0] = X1 - r;
+		b[1] = Y1 - r;
+		b[2] = X2 + r;
+		b[3] = Y2 + r;
+		return 1;
+	case TYPE_TRIANGLE:
+		b[0] = fmin (X1, fmin (X2, X3));
+		b[1] = fmin (Y1, fmin (Y2, Y3));
+		b[2] = fmax (X1, fmax (X2, X3));
+		b[3] = fmax (Y1, fmax (Y2, Y3));
+		return 1;
+	case TYPE_POINT:
+		r = width / 2;
+		break;
+	case TYPE_CIRCLE:
+		r = RADIUS;
+		break;
+	case TYPE_ARC:
+		r = (double) RADIUS + arc_width (width) / 2;
+		break;
+	case TYPE_TEXT:
+		r = (strlen (TEXT) + 2.0) * SCALE;
+		break;
+	default:
+		return 0;
+	}
+	b[0] = X1 - r;
+	b[1] = Y1 - r;
+	b[2] = X1 + r;
+	b[3] = Y1 + r;
+	return 1;
+}
+
 void
 all_layers_on (void)
 {
-	int i;
+	memset (Layer_vis, 0xff, sizeof (Layer_vis));
+	Layer_vis_gen++;
+}
+
+// does layer L match a wildcard pattern on its number or name (or group)?
+static int
+layer_match (struct layer *L, char *pattern)
+{
+	char num[16];
 
-	for (i = 1; i <= MAX_LAYERS; i++)
-		Layer[i] = 1;
+	sprintf (num, "%d", L->number);
+	if (fnmatch (pattern, num, 0) == 0)
+		return 1;
+	return L->name != NULL && fnmatch (pattern, L->name, FNM_LEADING_DIR) == 0;
 }
 
-// read input file, build display object list
-static void
-Init (FILE * fp)
+//
+//      layer_select --- change layer visibility by pattern
+//
+//      spec is an optional operation ('+' show, '-' hide, '=' show only,
+//      otherwise 'op') followed by comma separated patterns.  Returns the
+//      number of layers that matched.
+//
+static int
+layer_select (char *spec, int op)
 {
-	char buf[MAXBUF];
-	char *tokens[MAXTOKENS];
-	struct object *o;
-	int w, h;
-	int cur_layer = 1;
+	char buf[MAXSTRING];
+	char *pattern, *save;
+	struct layer *L;
+	int i, n = 0;
 
-	while (fgets (buf, sizeof (buf), fp) != NULL) {
-		o = NULL;
-		switch (tokenize (buf, tokens, MAXTOKENS)) {
-		case 1:
-			if (strcasecmp (tokens[0], "fill") == 0)
-				o = object_new (TYPE_FILL, GL_FILL, 0, 0, 0, 0, 0, NULL, cur_layer);
-			else if (strcasecmp (tokens[0], "wire") == 0)
-				o = object_new (TYPE_FILL, GL_LINE, 0, 0, 0, 0, 0, NULL, cur_layer);
-			break;
-		case 2:
-			if (strcasecmp (tokens[0], "width") == 0) {
-				o = object_new (TYPE_WIDTH, scale (tokens[1]), 0, 0, 0, 0, 0, NULL, cur_layer);
-			}
-			if (strcasecmp (tokens[0], "layer") == 0) {
-				cur_layer = layer (tokens[1]);
-			}
-			break;
-		case 3:
-			if (strcasecmp (tokens[0], "point") == 0)
-				o = object_new (TYPE_POINT, xcoord (tokens[1]), ycoord (tokens[2]), 0, 0, 0, 0, NULL, cur_layer);
-			break;
-		case 4:
-			if (strcasecmp (tokens[0], "circle") == 0)
-				o = object_new (TYPE_CIRCLE, xcoord (tokens[1]), ycoord (tokens[2]), radius (tokens[3]), 0, 0, 0, NULL, cur_layer);
-			else if (strcasecmp (tokens[0], "color") == 0) {
-				o = object_new (TYPE_COLOR, color (tokens[1]), color (tokens[2]), color (tokens[3]), 0, 0, 0, NULL, cur_layer);
-			}
-			break;
-		case 5:
-			if (strcasecmp (tokens[0], "rectangle") == 0)
-				o = object_new (TYPE_RECT, xcoord (tokens[1]), ycoord (tokens[2]), xcoord (tokens[3]), ycoord (tokens[4]), 0, 0, NULL, cur_layer);
-			else if (strcasecmp (tokens[0], "line") == 0)
-				o = object_new (TYPE_LINE, xcoord (tokens[1]), ycoord (tokens[2]), xcoord (tokens[3]), ycoord (tokens[4]), 0, 0, NULL, cur_layer);
-			break;
-		case 6:
-			if (strcasecmp (tokens[0], "text") == 0)
-				o = object_new (TYPE_TEXT, xcoord (tokens[1]), ycoord (tokens[2]), angle (tokens[3]), scale (tokens[4]), 0, 0, strsave (tokens[5]), cur_layer);
-			else if (strcasecmp (tokens[0], "arc") == 0)
-				o = object_new (TYPE_ARC, xcoord (tokens[1]), ycoord (tokens[2]), radius (tokens[3]), angle (tokens[4]), dangle (tokens[5]), 0, NULL, cur_layer);
-			break;
-		case 7:
-			if (strcasecmp (tokens[0], "triangle") == 0)
-				o = object_new (TYPE_TRIANGLE, xcoord (tokens[1]), ycoord (tokens[2]), xcoord (tokens[3]), ycoord (tokens[4]), xcoord (tokens[5]), ycoord (tokens[6]), NULL, cur_layer);
-			break;
-		default:
-			break;
+	if (*spec == '+' || *spec == '-' || *spec == '=')
+		op = *spec++;
+	if (op == '=')
+		memset (Layer_vis, 0, sizeof (Layer_vis));
+	snprintf (buf, sizeof (buf), "%s", spec);
+	for (pattern = strtok_r (buf, ",", &save); pattern != NULL; pattern = strtok_r (NULL, ",", &save)) {
+		LAYER_WALK (i, L) {
+			if (!layer_match (L, pattern))
+				continue;
+			n++;
+			if (op == '-')
+				layer_show (L->number, 0);
+			else if (op == '+' || op == '=')
+				layer_show (L->number, 1);
+			else
+				layer_toggle (L->number);
 		}
-		if (o != NULL)
-			object_add (Objects.prev, o);
 	}
+	return n;
+}
 
-	// find bounding rectangle for all primitives
-	OBJECT_WALK (&Objects, o) {
-		switch (o->type) {
-		case TYPE_LINE:
-		case TYPE_RECT:
-			min_max_point (X1, Y1);
-			min_max_point (X2, Y2);
-			break;
-		case TYPE_CIRCLE:
-		case TYPE_ARC:
-			min_max_point (X1 - RADIUS, Y1 - RADIUS);
-			min_max_point (X1 + RADIUS, Y1 + RADIUS);
-			break;
-		case TYPE_TRIANGLE:
-			min_max_point (X1, Y1);
-			min_max_point (X2, Y2);
-			min_max_point (X3, Y3);
-			break;
-		case TYPE_POINT:
-			min_max_point (X1, Y1);
-			break;
-		case TYPE_TEXT:
-			min_max_point (X1, Y1);
-			w = strlen (TEXT) * SCALE;
-			h = SCALE;
-			switch (ROTATE) {
-			case 0:
-				min_max_point (X1 + w, Y1 + h);
-				break;
-			case 90:
-				min_max_point (X1 - h, Y1 + w);
-				break;
-			case 180:
-				min_max_point (X1 - w, Y1 - h);
-				break;
-			case 270:
-				min_max_point (X1 + h, Y1 - w);
-				break;
+// mark the layers matching a comma separated list of patterns for --density
+static int
+density_select (char *spec)
+{
+	char buf[MAXSTRING];
+	char *pattern, *save;
+	struct layer *L;
+	int i, n = 0;
+
+	snprintf (buf, sizeof (buf), "%s", spec);
+	for (pattern = strtok_r (buf, ",", &save); pattern != NULL; pattern = strtok_r (NULL, ",", &save)) {
+		LAYER_WALK (i, L) {
+			if (layer_match (L, pattern)) {
+				L->density = 1;
+				n++;
 			}
-			break;
 		}
 	}
-	if (Maxx < Minx || Maxy < Miny)
-		exit (0);	// nothing to draw
-
-	// Increase boundary by 10%
-	Minx -= (Maxx - Minx) / 20;
-	Miny -= (Maxy - Miny) / 20;
-	Maxx += (Maxx - Minx) / 20;
-	Maxy += (Maxy - Miny) / 20;
-
-	// Add a gray background rectangle
-	o = object_new (TYPE_RECT, Minx, Miny, Maxx, Maxy, 0, 0, NULL, 1);
-	object_add (&Objects, o);	// insert at front of list so this becomes the background rectangle
-
-	all_layers_on ();
+	return n;
 }
 
-static inline int
-is_shift_pressed (void)
+// the starting layer selection, from --layers and --density
+static void
+layer_setup (void)
 {
-	return glutGetModifiers () & GLUT_ACTIVE_SHIFT;
+	all_layers_on ();
+	if (Layers_spec != NULL && layer_select (Layers_spec, '=') == 0)
+		error ("No layers match %s", Layers_spec);
+	if (Density_spec != NULL && density_select (Density_spec) == 0)
+		error ("No layers match %s", Density_spec);
 }
 
-static inline int
-is_ctrl_pressed (void)
-{
-	return glutGetModifiers () & GLUT_ACTIVE_CTRL;
-}
+// Duplicate removal ---------------------------------------------------------------
+//
+//      Objects are reduced to the parts that affect drawing (canon()) and
+//      hashed per layer.  Scanning each layer backwards, an object whose
+//      key was already seen is drawn over later by an identical one, so it
+//      can go without changing the picture.
 
-static inline int
-is_alt_pressed (void)
+struct dedup
 {
-	return glutGetModifiers () & GLUT_ACTIVE_ALT;
-}
+	int loose;		// ignore endpoint/vertex order
+	int objects;		// objects before
+	int removed;		// objects removed
+};
 
 static inline void
-bitmap_output (char *s)
+swap_points (int *a, int *b)
 {
-	glRasterPos2f (0, 0);
-	while (*s)
-		glutBitmapCharacter (BITMAP_FONT, *s++);
-}
+	int x = a[0], y = a[1];
 
-static inline void
-stroke_output (char *s)
-{
-	while (*s)
-		glutStrokeCharacter (STROKE_FONT, *s++);
+	a[0] = b[0], a[1] = b[1];
+	b[0] = x, b[1] = y;
 }
 
-static void
-glPrintf (int x, int y, int rot, int scale, int z, char *format, ...)
+static inline int
+point_less (const int *a, const int *b)
 {
-	va_list args;
-	static char buffer[20000];
-
-	va_start (args, format);
-	vsprintf (buffer, format, args);
-	va_end (args);
-
-	glPushMatrix ();
-	glTranslatef ((float) x, (float) y, (float) z);
-	glRotatef ((float) rot, 0, 0, 1);
-	glScalef (MIN_TEXT_SCALE * scale, MIN_TEXT_SCALE * scale, MIN_TEXT_SCALE * scale);
-	stroke_output (buffer);
-	glPopMatrix ();
+	return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
 }
 
+// c = o with the state that doesn't affect drawing cleared, and (loose) points in a standard order
 static void
-glLinei (int x1, int y1, int x2, int y2, int width, int z)
+canon (struct object *o, struct object *c, int loose)
 {
-	width /= 2;
-
-	if (width <= 0) {
-		glBegin (GL_LINES);
-		glVertex3i (x1, y1, z);
-		glVertex3i (x2, y2, z);
-		glEnd ();
-		return;
-	}
-	glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);	// Lines are always filled
-	if ((x1 <= x2 && y1 == y2) || (x1 == x2 && y1 < y2)) {
-		glBegin (GL_POLYGON);
-		glVertex3i (x1 - width, y1 - width, z);
-		glVertex3i (x1 - width, y1 + width, z);
-		glVertex3i (x2 + width, y2 + width, z);
-		glVertex3i (x2 + width, y2 - width, z);
-		glEnd ();
-	}
-	else if ((x1 > x2 && y1 == y2) || (x1 == x2 && y1 > y2)) {
-		glBegin (GL_POLYGON);
-		glVertex3i (x2 - width, y2 - width, z);
-		glVertex3i (x2 - width, y2 + width, z);
-		glVertex3i (x1 + width, y1 + width, z);
-		glVertex3i (x1 + width, y1 - width, z);
-		glEnd ();
-	}
-	else {
-		double angle = atan2 ((double) (y2 - y1), (double) (x2 - x1));
-		int t2sina = (int) (width * sin (angle));
-		int t2cosa = (int) (width * cos (angle));
+	*c = *o;
+	switch (o->type) {
+	case TYPE_LINE:
+		c->filled = 0;
+		if (loose && point_less (&c->arg[2], &c->arg[0]))
+			swap_points (&c->arg[0], &c->arg[2]);
+		break;
+	case TYPE_RECT:
+		if (loose) {
+			int x1 = c->arg[0], y1 = c->arg[1];
 
-		glBegin (GL_TRIANGLES);
-		glVertex3i (x1 + t2sina, y1 - t2cosa, z);
-		glVertex3i (x2 + t2sina, y2 - t2cosa, z);
-		glVertex3i (x2 - t2sina, y2 + t2cosa, z);
-		glVertex3i (x2 - t2sina, y2 + t2cosa, z);
-		glVertex3i (x1 - t2sina, y1 + t2cosa, z);
-		glVertex3i (x1 + t2sina, y1 - t2cosa, z);
-		glEnd ();
+			c->arg[0] = x1 < c->arg[2] ? x1 : c->arg[2];
+			c->arg[1] = y1 < c->arg[3] ? y1 : c->arg[3];
+			c->arg[2] = x1 > c->arg[2] ? x1 : c->arg[2];
+			c->arg[3] = y1 > c->arg[3] ? y1 : c->arg[3];
+		}
+		// fall through
+	case TYPE_CIRCLE:
+	case TYPE_TRIANGLE:
+		if (c->filled)
+			c->width = 0;	// the width is only used for outlines
+		if (loose && o->type == TYPE_TRIANGLE) {
+			if (point_less (&c->arg[2], &c->arg[0]))
+				swap_points (&c->arg[0], &c->arg[2]);
+			if (point_less (&c->arg[4], &c->arg[2]))
+				swap_points (&c->arg[2], &c->arg[4]);
+			if (point_less (&c->arg[2], &c->arg[0]))
+				swap_points (&c->arg[0], &c->arg[2]);
+		}
+		break;
+	case TYPE_ARC:
+		c->filled = 0;
+		c->width = arc_width (c->width);
+		break;
+	case TYPE_TEXT:
+		c->filled = 0;
+		break;
 	}
-	glPolygonMode (GL_FRONT_AND_BACK, Fill);
 }
 
-static void
-glArci (int x, int y, int radius, int dstart, int ddelta, int z)
+static inline unsigned int
+canon_hash (struct object *c)
 {
-	double angle_start = dtor ((dstart - 90) % 360);
-	double angle_delta = dtor (ddelta);
-	double angle_end = angle_start;
-	double angle;
-	int arcx_outer[CIRCLE_STEPS + 1];
-	int arcy_outer[CIRCLE_STEPS + 1];
-	int arcx_inner[CIRCLE_STEPS + 1];
-	int arcy_inner[CIRCLE_STEPS + 1];
-	int step = 0;
+	unsigned long long h = c->type * 0x9e3779b97f4a7c15ull;
 	int i;
-	int w = (Width >= 2) ? Width : 2;	// arcs of width <2 would be invisible
 
-	if (angle_delta >= 0)
-		angle_end += angle_delta;
-	else
-		angle_start += angle_delta;
+	for (i = 0; i < 6; i++)
+		h = (h ^ (unsigned int) c->arg[i]) * 0x100000001b3ull;
+	h = (h ^ (unsigned int) c->width) * 0x100000001b3ull;
+	h = (h ^ (c->rgb[0] | c->rgb[1] << 8 | c->rgb[2] << 16 | c->filled << 24)) * 0x100000001b3ull;
+	if (c->type == TYPE_POLYGON)
+		h ^= c->poly->n * 0x9e3779b97f4a7c15ull;	// its bounds are in arg[]
+	else if (c->text != NULL)
+		h ^= name_hash (c->text);
+	return (unsigned int) (h ^ (h >> 32));
+}
 
-	for (angle = angle_start; angle < angle_end; angle += (TWO_PI / CIRCLE_STEPS), step++) {
-		arcx_outer[step] = (int) (sin (angle) * (radius + (w / 2)));
-		arcy_outer[step] = (int) (cos (angle) * (radius + (w / 2)));
-		arcx_inner[step] = (int) (sin (angle) * (radius - (w / 2)));
-		arcy_inner[step] = (int) (cos (angle) * (radius - (w / 2)));
-	}
-	arcx_outer[step] = (int) (sin (angle_end) * (radius + (w / 2)));
-	arcy_outer[step] = (int) (cos (angle_end) * (radius + (w / 2)));
-	arcx_inner[step] = (int) (sin (angle_end) * (radius - (w / 2)));
-	arcy_inner[step] = (int) (cos (angle_end) * (radius - (w / 2)));
+static inline int
+canon_equal (struct object *a, struct object *b)
+{
+	if (a->type != b->type || memcmp (a->arg, b->arg, sizeof (a->arg)) != 0 || a->width != b->width
+	    || memcmp (a->rgb, b->rgb, sizeof (a->rgb)) != 0 || a->filled != b->filled)
+		return 0;
+	if (a->type == TYPE_POLYGON)
+		return a->poly == b->poly || (a->poly->n == b->poly->n && a->poly->ncontours == b->poly->ncontours
+					      && memcmp (a->poly->contour, b->poly->contour, a->poly->ncontours * sizeof (int)) == 0
+					      && memcmp (a->poly->xy, b->poly->xy, a->poly->n * 2 * sizeof (int)) == 0);
+	return a->text == b->text || (a->text != NULL && b->text != NULL && strcmp (a->text, b->text) == 0);
+}
 
-	if (step > 0 && arcx_outer[step] == arcx_outer[step - 1] && arcy_outer[step] == arcy_outer[step - 1])
-		step--;
+// parallel_for() worker, remove the duplicates on one layer in place
+static void
+dedup_layer (void *arg, int index, int thread)
+{
+	struct dedup *d = arg;
+	struct layer *L = Layers[Layer_order[index]];
+	struct object *o = L->obj;
+	struct object c, e;
+	unsigned int size, mask, h;
+	int *table;
+	int i, w;
 
-	glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);	// arcs are always filled
-	for (i = 0; i < step; i++) {
-		glBegin (GL_POLYGON);
-		glVertex3i (x + arcx_outer[i + 0], y + arcy_outer[i + 0], z);
-		glVertex3i (x + arcx_outer[i + 1], y + arcy_outer[i + 1], z);
-		glVertex3i (x + arcx_inner[i + 1], y + arcy_inner[i + 1], z);
-		glVertex3i (x + arcx_inner[i + 0], y + arcy_inner[i + 0], z);
-		glEnd ();
+	(void) thread;
+	for (size = 16; size < (unsigned int) L->n * 2; size *= 2);
+	mask = size - 1;
+	table = must_malloc (size * sizeof (*table));
+	memset (table, 0xff, size * sizeof (*table));	// all -1, empty
+	for (i = L->n - 1; i >= 0; i--) {
+		canon (&o[i], &c, d->loose);
+		for (h = canon_hash (&c) & mask; table[h] >= 0; h = (h + 1) & mask) {
+			canon (&o[table[h]], &e, d->loose);
+			if (canon_equal (&c, &e))
+				break;
+		}
+		if (table[h] >= 0)
+			o[i].type = TYPE_NONE;	// drawn over later by an identical object
+		else
+			table[h] = i;
 	}
-	glPolygonMode (GL_FRONT_AND_BACK, Fill);
+	for (i = w = 0; i < L->n; i++)
+		if (o[i].type != TYPE_NONE)
+			o[w++] = o[i];
+	__sync_fetch_and_add (&d->objects, L->n);
+	__sync_fetch_and_add (&d->removed, L->n - w);
+	L->n = w;
+	free (table);
 }
 
+// remove duplicate objects on all layers in parallel, and report how many went away
 static void
-glCirclei (int x, int y, int radius, int z)
+dedup (int loose)
 {
-	double angle;
+	struct dedup d = {.loose = loose,.objects = 0,.removed = 0 };
+	double t = now ();
 
-	glBegin (GL_POLYGON);
-	for (angle = 0; angle < TWO_PI; angle += (TWO_PI / CIRCLE_STEPS))
-		glVertex3i (x + (int) (sin (angle) * radius), y + (int) (cos (angle) * radius), z);
-	glEnd ();
+	parallel_for (Nlayers, dedup_layer, &d);
+	printf ("Dedup: %d of %d objects removed (%.1f%%), %.2f seconds\n", d.removed, d.objects,
+		d.objects ? 100.0 * d.removed / d.objects : 0.0, now () - t);
 }
 
+// Load-time simplification ---------------------------------------------------------
+//
+//      Runs of consecutive Lines on a layer that have the same state and
+//      where each starts where the previous one ended form a chain.  Inner
+//      chain points that lie exactly on the segment between their neighbours
+//      are dropped, which merges abutting collinear segments without
+//      changing what is drawn.  With a tolerance, chains are simplified
+//      with Douglas-Peucker instead, moving no line more than tol units.
+
+struct simplify
+{
+	double tol;
+	int lines;		// Lines before
+	int removed;		// Lines removed
+};
+
+// can b continue the chain ending with a?
+static inline int
+chains (struct object *a, struct object *b)
+{
+	return a->type == TYPE_LINE && b->type == TYPE_LINE && a->arg[2] == b->arg[0] && a->arg[3] == b->arg[1]
+		&& a->width == b->width && memcmp (a->rgb, b->rgb, sizeof (a->rgb)) == 0;
+}
+
+// is point p exactly on the segment a-b? (a closed chain has a == b, only a itself is on that)
+static inline int
+on_segment (const int *p, const int *a, const int *b)
+{
+	__int128 dx = (long long) b[0] - a[0], dy = (long long) b[1] - a[1];
+	__int128 px = (long long) p[0] - a[0], py = (long long) p[1] - a[1];
+
+	if (dx == 0 && dy == 0)
+		return px == 0 && py == 0;
+	if (dx * py - dy * px != 0)
+		return 0;	// not collinear
+	return px * dx + py * dy >= 0 && px * dx + py * dy <= dx * dx + dy * dy;
+}
+
+// distance from point p to the segment a-b
+static double
+segment_distance (const int *p, const int *a, const int *b)
+{
+	double dx = (double) b[0] - a[0], dy = (double) b[1] - a[1];
+	double px = (double) p[0] - a[0], py = (double) p[1] - a[1];
+	double len2 = dx * dx + dy * dy;
+	double t = (len2 > 0) ? (px * dx + py * dy) / len2 : 0;
+
+	t = fmax (0, fmin (1, t));
+	return hypot (px - t * dx, py - t * dy);
+}
+
+//
+//      simplify_chain --- mark the points of a polyline to keep
+//
+//      pt has n points (x,y pairs).  Douglas-Peucker with an explicit stack,
+//      keep[] is set for the points that survive.  With tol 0 only points
+//      exactly on the segment between the kept neighbours are dropped.
+//
+static void
+simplify_chain (const int *pt, int n, double tol, char *keep, int *stack)
+{
+	int sp = 0;
+	int i, a, b, far;
+	double d, dmax;
+
+	memset (keep, 0, n);
+	keep[0] = keep[n - 1] = 1;
+	stack[sp++] = 0;
+	stack[sp++] = n - 1;
+	while (sp > 0) {
+		b = stack[--sp];
+		a = stack[--sp];
+		far = -1;
+		dmax = 0;
+		for (i = a + 1; i < b; i++) {
+			if (tol == 0 && on_segment (&pt[i * 2], &pt[a * 2], &pt[b * 2]))
+				continue;
+			d = segment_distance (&pt[i * 2], &pt[a * 2], &pt[b * 2]);
+			if (far < 0 || d > dmax) {
+				far = i;
+				dmax = d;
+			}
+		}
+		if (far < 0 || (tol > 0 && dmax <= tol))
+			continue;	// a-b replaces everything in between
+		keep[far] = 1;
+		stack[sp++] = a;
+		stack[sp++] = far;
+		stack[sp++] = far;
+		stack[sp++] = b;
+	}
+}
+
+// parallel_for() worker, simplify the chains of one layer in place
+static void
+simplify_layer (void *arg, int index, int thread)
+{
+	struct simplify *s = arg;
+	struct layer *L = Layers[Layer_order[index]];
+	struct object *o = L->obj;
+	struct object chain;
+	int *pt = must_malloc ((L->n + 1) * 2 * sizeof (*pt));
+	int *stack = must_malloc ((L->n + 1) * 2 * sizeof (*stack));
+	char *keep = must_malloc (L->n + 1);
+	int lines = 0;
+	int i, j, k, n, w = 0;
+
+	(void) thread;
+	for (i = 0; i < L->n; i = j) {
+		for (j = i + 1; j < L->n && chains (&o[j - 1], &o[j]); j++);
+		if (o[i].type != TYPE_LINE || j - i < 2) {
+			lines += (o[i].type == TYPE_LINE);
+			o[w++] = o[i];
+			j = i + 1;
+			continue;
+		}
+		// objects i..j-1 are a chain of lines with j-i+1 points
+		lines += j - i;
+		for (n = 0, k = i; k < j; k++, n++) {
+			pt[n * 2 + 0] = o[k].arg[0];
+			pt[n * 2 + 1] = o[k].arg[1];
+		}
+		pt[n * 2 + 0] = o[j - 1].arg[2];
+		pt[n * 2 + 1] = o[j - 1].arg[3];
+		simplify_chain (pt, ++n, s->tol, keep, stack);
+		chain = o[i];	// o[i] may be overwritten below
+		for (k = 1, n = 0; k <= j - i; k++) {
+			if (!keep[k])
+				continue;
+			o[w] = chain;
+			o[w].arg[0] = pt[n * 2 + 0];
+			o[w].arg[1] = pt[n * 2 + 1];
+			o[w].arg[2] = pt[k * 2 + 0];
+			o[w].arg[3] = pt[k * 2 + 1];
+			w++;
+			n = k;
+		}
+	}
+	__sync_fetch_and_add (&s->lines, lines);
+	__sync_fetch_and_add (&s->removed, L->n - w);
+	L->n = w;
+	free (pt);
+	free (stack);
+	free (keep);
+}
+
+// merge/simplify Lines on all layers in parallel, and report how many went away
+static void
+simplify (double tol)
+{
+	struct simplify s = {.tol = tol,.lines = 0,.removed = 0 };
+	double t = now ();
+
+	parallel_for (Nlayers, simplify_layer, &s);
+	printf ("%s: %d of %d lines removed (%.1f%%), %.2f seconds\n", tol > 0 ? "Simplify" : "Merge",
+		s.removed, s.lines, s.lines ? 100.0 * s.removed / s.lines : 0.0, now () - t);
+}
+
+// Frames ---------------------------------------------------------------------
+//
+//      Frame n starts frame n of an animation: what follows is added in
+//      that frame, and Remove <object> takes out a matching object (same
+//      type, arguments and state) added in an earlier one.  Objects before
+//      the first Frame are in all of them.  Each layer is split into
+//      segments of objects born in the same frame, each with its own
+//      batch, so stepping only rebuilds the segments that lost objects.
+
+struct segment
+{
+	int first;		// object index
+	int born;		// frame
+	GLuint list;		// batch, 0 when not built
+	int lo, hi;		// frames the batch is right for, [lo,hi)
+	int texts;		// as in struct layer
+	int text_zoom;
+};
+
+#define	object_shown(L,i)	((L)->born == NULL || ((L)->born[i] <= Frame_now && (L)->died[i] > Frame_now))
+
+// the Frame directive
+static void
+frame_start (int n)
+{
+	if (n < Frame_read || n < 0) {
+		error ("Frame %d ignored, frames must not go backwards", n);
+		return;
+	}
+	if (Frame_count == 0 || Frames[Frame_count - 1] != n) {
+		if ((Frame_count & 255) == 0 && (Frames = realloc (Frames, (Frame_count + 256) * sizeof (*Frames))) == NULL)
+			fatal ("Can't grow frames");
+		Frames[Frame_count++] = n;
+	}
+	Frame_read = n;
+}
+
+static int
+removal_cmp (const void *a, const void *b)
+{
+	const struct removal *x = a, *y = b;
+
+	if (x->o.layer != y->o.layer)
+		return x->o.layer - y->o.layer;
+	return x->seq - y->seq;
+}
+
+struct frames
+{
+	int *first;		// Removals[] index of each layer's first one
+	int removed;
+	int missing;
+};
+
+// parallel_for() worker: match one layer's removals with its objects,
+// and cut it into segments
+static void
+frames_layer_setup (void *arg, int index, int thread)
+{
+	struct frames *f = arg;
+	struct layer *L = Layers[Layer_order[index]];
+	struct object c, e;
+	unsigned int size, mask, h;
+	int *table;
+	int i, j, k;
+
+	(void) thread;
+	L->died = must_malloc ((L->n + 1) * sizeof (*L->died));
+	L->seg = must_malloc ((L->n + 1) * sizeof (*L->seg));
+	for (i = 0; i < L->n; i++) {
+		L->died[i] = INT_MAX;
+		if (i == 0 || L->born[i] != L->born[i - 1]) {
+			memset (&L->seg[L->nseg], 0, sizeof (*L->seg));
+			L->seg[L->nseg].first = i;
+			L->seg[L->nseg++].born = L->born[i];
+		}
+	}
+	if ((L->seg = realloc (L->seg, (L->nseg + 1) * sizeof (*L->seg))) == NULL)
+		fatal ("Can't realloc layer %d segments", L->number);
+	L->seg[L->nseg].first = L->n;	// end marker
+
+	// objects go in the table once their frame is before the next removal's
+	for (size = 16; size < (unsigned int) L->n * 2; size *= 2);
+	mask = size - 1;
+	table = must_malloc (size * sizeof (*table));
+	memset (table, 0xff, size * sizeof (*table));	// all -1, empty
+	for (i = 0, j = f->first[index]; j < Nremovals && Removals[j].o.layer == L->number; j++) {
+		struct removal *r = &Removals[j];
+
+		for (; i < L->n && L->born[i] < r->frame; i++) {
+			canon (&L->obj[i], &c, 0);
+			for (h = canon_hash (&c) & mask; table[h] >= 0; h = (h + 1) & mask);
+			table[h] = i;
+		}
+		canon (&r->o, &c, 0);
+		for (h = canon_hash (&c) & mask; table[h] != -1; h = (h + 1) & mask) {
+			if ((k = table[h]) < 0)
+				continue;	// removed
+			canon (&L->obj[k], &e, 0);
+			if (canon_equal (&c, &e))
+				break;
+		}
+		if (table[h] == -1) {
+			__sync_fetch_and_add (&f->missing, 1);
+			continue;
+		}
+		L->died[table[h]] = r->frame;
+		table[h] = -2;
+		__sync_fetch_and_add (&f->removed, 1);
+	}
+	free (table);
+}
+
+// find each layer's segments and what each Remove removes
+static void
+frames_setup (void)
+{
+	struct frames f = {.removed = 0,.missing = 0 };
+	struct layer *L;
+	double t = now ();
+	int i, j;
+
+	qsort (Removals, Nremovals, sizeof (*Removals), removal_cmp);
+	f.first = must_malloc ((Nlayers + 1) * sizeof (*f.first));
+	for (i = j = 0; i < Nlayers; i++) {
+		L = Layers[Layer_order[i]];
+		while (j < Nremovals && Removals[j].o.layer < L->number)
+			j++;
+		f.first[i] = j;
+		if (L->born == NULL)	// nothing added since the first Frame
+			L->born = must_zalloc ((L->max + 1) * sizeof (*L->born));
+	}
+	parallel_for (Nlayers, frames_layer_setup, &f);
+	printf ("Frames: %d frames, %d objects removed", Frame_count, f.removed);
+	if (f.missing)
+		printf (", %d removals matched nothing", f.missing);
+	printf (", %.2f seconds\n", now () - t);
+	free (f.first);
+	free (Removals);
+	Removals = NULL;
+	Nremovals = 0;
+	for (Frame_at = 0; Frame_at < Frame_count - 1 && Frames[Frame_at] < Start_frame; Frame_at++);
+	Frame_now = Frames[Frame_at];
+}
+
+// Polygons ---------------------------------------------------------------------
+//
+//      A Polygon is read as an outline and any number of holes, and once
+//      everything is loaded all of them are triangulated in parallel with
+//      the GLU tessellator (odd winding, so holes and self intersections
+//      work).  Filled Polygons draw the triangles, Wire ones the contours.
+
+struct tess
+{
+	struct polygon *p;
+	int max;		// allocated size of p->tri, in triangles
+	int corner;		// of the triangle being emitted
+	GLdouble **extra;	// vertices made by the combine callback
+	int nextra, maxextra;
+	int error;
+};
+
+// start a Polygon, or a hole in the one being read
+static void
+polygon_contour (struct polygon **pp)
+{
+	struct polygon *p = *pp;
+
+	if (p == NULL)
+		*pp = p = must_zalloc (sizeof (*p));
+	if ((p->ncontours & 15) == 0 && (p->contour = realloc (p->contour, (p->ncontours + 16) * sizeof (*p->contour))) == NULL)
+		fatal ("Can't grow polygon contours");
+	p->contour[p->ncontours++] = 0;
+}
+
+// add the x y pairs in tokens to the current contour
+static void
+polygon_points (struct polygon *p, char **tokens, int n)
+{
+	int i;
+
+	if (n & 1)
+		error ("Polygon coordinates must be x y pairs, ignoring %s", tokens[n - 1]);
+	for (i = 0; i + 1 < n; i += 2) {
+		if ((p->n & 1023) == 0 && (p->xy = realloc (p->xy, (p->n + 1024) * 2 * sizeof (*p->xy))) == NULL)
+			fatal ("Can't grow polygon");
+		p->xy[p->n * 2 + 0] = xcoord (tokens[i]);
+		p->xy[p->n * 2 + 1] = ycoord (tokens[i + 1]);
+		p->n++;
+		p->contour[p->ncontours - 1]++;
+	}
+}
+
+// add the Polygon that's been read, in the current state
+static void
+polygon_end (struct object *state, struct polygon **pp)
+{
+	struct polygon *p = *pp;
+	struct object *o;
+	int i, minx = INT_MAX, miny = INT_MAX, maxx = INT_MIN, maxy = INT_MIN;
+
+	if (p == NULL)
+		return;
+	*pp = NULL;
+	if (p->contour[0] < 3 || Object_sink != NULL) {
+		if (Object_sink != NULL)
+			Sink_polygons++;
+		else
+			error ("Polygon with %d points ignored", p->contour[0]);
+		free (p->xy);
+		free (p->contour);
+		free (p);
+		return;
+	}
+	for (i = 0; i < p->n; i++) {
+		minx = p->xy[i * 2] < minx ? p->xy[i * 2] : minx;
+		maxx = p->xy[i * 2] > maxx ? p->xy[i * 2] : maxx;
+		miny = p->xy[i * 2 + 1] < miny ? p->xy[i * 2 + 1] : miny;
+		maxy = p->xy[i * 2 + 1] > maxy ? p->xy[i * 2 + 1] : maxy;
+	}
+	o = object_new (state, TYPE_POLYGON, minx, miny, maxx, maxy, 0, 0, NULL);
+	o->poly = p;
+	if ((Npolygons & 1023) == 0 && (Polygons = realloc (Polygons, (Npolygons + 1024) * sizeof (*Polygons))) == NULL)
+		fatal ("Can't grow polygon list");
+	Polygons[Npolygons++] = p;
+}
+
+// is this (or the next) line part of the Polygon being read? returns 1 if it's used
+static int
+polygon_line (struct object *state, struct polygon **pp, char **tokens, int n)
+{
+	if (n > 0 && strcasecmp (tokens[0], "polygon") == 0) {
+		polygon_end (state, pp);
+		polygon_contour (pp);
+		polygon_points (*pp, tokens + 1, n - 1);
+		return 1;
+	}
+	if (*pp == NULL)
+		return 0;
+	if (n == 0)
+		return 1;
+	if (strcasecmp (tokens[0], "hole") == 0) {
+		polygon_contour (pp);
+		polygon_points (*pp, tokens + 1, n - 1);
+		return 1;
+	}
+	if (isdigit (tokens[0][0]) || tokens[0][0] == '-' || tokens[0][0] == '+') {
+		polygon_points (*pp, tokens, n);
+		return 1;
+	}
+	polygon_end (state, pp);	// End, or anything else ends it
+	return strcasecmp (tokens[0], "end") == 0;
+}
+
+static void
+tess_vertex (void *vertex, void *arg)
+{
+	struct tess *t = arg;
+	struct polygon *p = t->p;
+	GLdouble *v = vertex;
+
+	if (t->corner == 0 && p->ntri == t->max && (p->tri = realloc (p->tri, (t->max = t->max * 2 + 64) * 6 * sizeof (*p->tri))) == NULL)
+		fatal ("Can't grow polygon triangles");
+	p->tri[p->ntri * 6 + t->corner * 2 + 0] = (int) llround (v[0]);
+	p->tri[p->ntri * 6 + t->corner * 2 + 1] = (int) llround (v[1]);
+	if (++t->corner == 3) {
+		t->corner = 0;
+		p->ntri++;
+	}
+}
+
+// a new vertex where edges cross
+static void
+tess_combine (GLdouble coords[3], void *data[4], GLfloat weight[4], void **out, void *arg)
+{
+	struct tess *t = arg;
+	GLdouble *v = must_malloc (3 * sizeof (*v));
+
+	(void) data;
+	(void) weight;
+	memcpy (v, coords, 3 * sizeof (*v));
+	if (t->nextra == t->maxextra && (t->extra = realloc (t->extra, (t->maxextra = t->maxextra * 2 + 16) * sizeof (*t->extra))) == NULL)
+		fatal ("Can't grow polygon vertices");
+	t->extra[t->nextra++] = v;
+	*out = v;
+}
+
+// only called so the tessellator emits separate triangles
+static void
+tess_edge (GLboolean flag, void *arg)
+{
+	(void) flag;
+	(void) arg;
+}
+
+static void
+tess_error (GLenum err, void *arg)
+{
+	struct tess *t = arg;
+
+	t->error = err;
+}
+
+// parallel_for() worker, triangulate one Polygon with this thread's tessellator
+static void
+tessellate_one (void *arg, int index, int thread)
+{
+	GLUtesselator **tess = arg;
+	struct polygon *p = Polygons[index];
+	struct tess t = {.p = p };
+	GLdouble *v = must_malloc (p->n * 3 * sizeof (*v));
+	int i, j, k = 0;
+
+	if (tess[thread] == NULL) {
+		if ((tess[thread] = gluNewTess ()) == NULL)
+			fatal ("Can't make a tessellator");
+		gluTessProperty (tess[thread], GLU_TESS_WINDING_RULE, GLU_TESS_WINDING_ODD);
+		gluTessNormal (tess[thread], 0, 0, 1);
+		gluTessCallback (tess[thread], GLU_TESS_VERTEX_DATA, (_GLUfuncptr) tess_vertex);
+		gluTessCallback (tess[thread], GLU_TESS_COMBINE_DATA, (_GLUfuncptr) tess_combine);
+		gluTessCallback (tess[thread], GLU_TESS_EDGE_FLAG_DATA, (_GLUfuncptr) tess_edge);
+		gluTessCallback (tess[thread], GLU_TESS_ERROR_DATA, (_GLUfuncptr) tess_error);
+	}
+	gluTessBeginPolygon (tess[thread], &t);
+	for (i = 0; i < p->ncontours; i++) {
+		gluTessBeginContour (tess[thread]);
+		for (j = 0; j < p->contour[i]; j++, k++) {
+			v[k * 3 + 0] = p->xy[k * 2 + 0];
+			v[k * 3 + 1] = p->xy[k * 2 + 1];
+			v[k * 3 + 2] = 0;
+			gluTessVertex (tess[thread], &v[k * 3], &v[k * 3]);
+		}
+		gluTessEndContour (tess[thread]);
+	}
+	gluTessEndPolygon (tess[thread]);
+	if (t.error) {
+		error ("Polygon at %d,%d: %s", p->xy[0], p->xy[1], gluErrorString (t.error));
+		p->ntri = 0;
+	}
+	for (i = 0; i < t.nextra; i++)
+		free (t.extra[i]);
+	free (t.extra);
+	free (v);
+}
+
+// triangulate every Polygon, in parallel
+static void
+tessellate (void)
+{
+	GLUtesselator *tess[MAX_THREADS] = { NULL };
+	double t = now ();
+	long ntri = 0;
+	int i;
+
+	if (Npolygons == 0)
+		return;
+	parallel_for (Npolygons, tessellate_one, tess);
+	for (i = 0; i < MAX_THREADS; i++)
+		if (tess[i] != NULL)
+			gluDeleteTess (tess[i]);
+	for (i = 0; i < Npolygons; i++)
+		ntri += Polygons[i]->ntri;
+	printf ("Polygons: %d tessellated into %ld triangles, %d threads, %.2f seconds\n", Npolygons, ntri, nthreads (), now () - t);
+	free (Polygons);
+	Polygons = NULL;
+	Npolygons = 0;
+}
+
+// Compact object store --------------------------------------------------------------
+//
+//      With --compact each layer's objects are packed into a byte stream
+//      once loading is done.  Coordinates are 16 bit offsets from the
+//      origin of a 65536 unit tile, colors are an index in a palette of
+//      256, and only the arguments a type uses are kept.  An object that
+//      doesn't fit (or a 257th color) is stored in full.  Records are
+//      self contained so any one can be decoded from its offset.
+//      Everything is exact; objects are decoded while building batches.
+//
+//      record: header, color index or rgb, [tile index], args, width, [text or polygon]
+
+#define	PACK_TYPE	0x0f	// header bits
+#define	PACK_FILLED	0x10
+#define	PACK_WIDE	0x20	// tile index and args are 32 bit
+#define	PACK_WIDTH	0x40	// width is 32 bit, else 8
+#define	PACK_RGB	0x80	// rgb follows, not a palette index
+#define	TILE_BITS	16
+
+static const unsigned char Pack_args[] = { 0, 4, 2, 4, 3, 5, 6, 4, 4 };	// arguments used, by type
+static const unsigned char Pack_coords[] = { 0, 4, 2, 4, 2, 2, 6, 2, 4 };	// of those, x,y coordinates
+
+// iterating over a layer's objects, packed or not
+struct cursor
+{
+	size_t next;		// index, or offset in packed[]
+	size_t at;		// of the object last returned
+	struct object o[2];	// decoded objects, the last two stay valid
+	int k;
+};
+
+// Walk every object on a layer, packed or not, using o as the object and c as the cursor
+#define	OBJECT_SCAN(L,c,o)	for((c).next=0,(c).k=0; ((o)=object_next((L),&(c))) != NULL; )
+
+static inline int
+tile_of (int v)
+{
+	return (int) (((long long) v + (1 << (TILE_BITS - 1))) >> TILE_BITS);
+}
+
+// decode the packed object at p, returns its size
+static size_t
+unpack (struct layer *L, const unsigned char *p, struct object *o)
+{
+	const unsigned char *start = p;
+	int h = *p++, i, n, tile = 0;
+	short v16;
+
+	memset (o, 0, sizeof (*o));
+	o->type = h & PACK_TYPE;
+	o->layer = L->number;
+	o->filled = (h & PACK_FILLED) != 0;
+	if (h & PACK_RGB) {
+		memcpy (o->rgb, p, 3);
+		p += 3;
+	}
+	else
+		memcpy (o->rgb, Palette[*p++], 3);
+	n = Pack_args[o->type];
+	if (h & PACK_WIDE) {
+		memcpy (o->arg, p, n * sizeof (int));
+		p += n * sizeof (int);
+	}
+	else {
+		tile = p[0] | p[1] << 8;
+		p += 2;
+		for (i = 0; i < n; i++, p += 2) {
+			memcpy (&v16, p, 2);
+			o->arg[i] = v16;
+			if (i < Pack_coords[o->type])
+				o->arg[i] = (int) (((long long) L->tiles[tile][i & 1] << TILE_BITS) + v16);
+		}
+	}
+	if (h & PACK_WIDTH) {
+		memcpy (&o->width, p, sizeof (int));
+		p += sizeof (int);
+	}
+	else
+		o->width = *p++;
+	if (o->type == TYPE_TEXT || o->type == TYPE_POLYGON) {
+		memcpy (&o->text, p, sizeof (char *));
+		p += sizeof (char *);
+	}
+	return p - start;
+}
+
+// the object at 'at' (as returned by object_next()), decoded into o if packed
+static inline struct object *
+object_at (struct layer *L, size_t at, struct object *o)
+{
+	if (L->packed == NULL)
+		return &L->obj[at];
+	unpack (L, L->packed + at, o);
+	return o;
+}
+
+static inline struct object *
+object_next (struct layer *L, struct cursor *c)
+{
+	if (L->packed == NULL) {
+		if (c->next >= (size_t) L->n)
+			return NULL;
+		c->at = c->next++;
+		return &L->obj[c->at];
+	}
+	if (c->next >= L->size)
+		return NULL;
+	c->at = c->next;
+	c->k ^= 1;
+	c->next += unpack (L, L->packed + c->at, &c->o[c->k]);
+	return &c->o[c->k];
+}
+
+// palette index of a color, -1 if the palette is full
+static int
+palette_index (const unsigned char rgb[3])
+{
+	static int last;
+	int i;
+
+	if (last < Npalette && memcmp (Palette[last], rgb, 3) == 0)
+		return last;
+	for (i = 0; i < Npalette; i++)
+		if (memcmp (Palette[i], rgb, 3) == 0)
+			return last = i;
+	if (Npalette == 256)
+		return -1;
+	memcpy (Palette[Npalette], rgb, 3);
+	return last = Npalette++;
+}
+
+// pack one object into p, which has room for the largest record; returns its size
+static size_t
+pack (struct layer *L, struct object *o, int *hash, int hsize, unsigned char *p)
+{
+	unsigned char *start = p;
+	unsigned char *hdr = p++;
+	int n = Pack_args[o->type];
+	int c = palette_index (o->rgb);
+	int tile[2], t = -1, i, h;
+	short v16;
+
+	*hdr = o->type | (o->filled ? PACK_FILLED : 0);
+	if (c < 0) {
+		*hdr |= PACK_RGB;
+		memcpy (p, o->rgb, 3);
+		p += 3;
+	}
+	else
+		*p++ = c;
+
+	// the tile of the first point, if every argument fits in 16 bits from it
+	tile[0] = tile_of (X1);
+	tile[1] = tile_of (Y1);
+	for (i = 0; i < n; i++) {
+		long long v = o->arg[i];
+
+		if (i < Pack_coords[o->type])
+			v -= (long long) tile[i & 1] << TILE_BITS;
+		if (v < SHRT_MIN || v > SHRT_MAX)
+			break;
+	}
+	if (i == n) {
+		for (h = ((unsigned int) tile[0] * 0x9e3779b1u ^ (unsigned int) tile[1] * 0x85ebca6bu) & (hsize - 1);
+		     hash[h] >= 0; h = (h + 1) & (hsize - 1))
+			if (L->tiles[hash[h]][0] == tile[0] && L->tiles[hash[h]][1] == tile[1])
+				break;
+		if (hash[h] < 0 && L->ntiles < (1 << 16)) {
+			hash[h] = L->ntiles++;
+			L->tiles[hash[h]][0] = tile[0];
+			L->tiles[hash[h]][1] = tile[1];
+		}
+		t = hash[h];
+	}
+	if (t >= 0) {
+		*p++ = t & 0xff;
+		*p++ = t >> 8;
+		for (i = 0; i < n; i++, p += 2) {
+			v16 = (i < Pack_coords[o->type]) ? (short) (o->arg[i] - ((long long) tile[i & 1] << TILE_BITS)) : o->arg[i];
+			memcpy (p, &v16, 2);
+		}
+	}
+	else {
+		*hdr |= PACK_WIDE;
+		memcpy (p, o->arg, n * sizeof (int));
+		p += n * sizeof (int);
+	}
+	if (o->width < 0 || o->width > 255) {
+		*hdr |= PACK_WIDTH;
+		memcpy (p, &o->width, sizeof (int));
+		p += sizeof (int);
+	}
+	else
+		*p++ = o->width;
+	if (o->type == TYPE_TEXT || o->type == TYPE_POLYGON) {
+		memcpy (p, &o->text, sizeof (char *));
+		p += sizeof (char *);
+	}
+	return p - start;
+}
+
+// pack every layer's objects, and report the memory saved
+static void
+compact (void)
+{
+	struct layer *L;
+	struct object *o;
+	size_t before = 0, after = 0;
+	double t = now ();
+	int i, j, hsize, *hash;
+
+	LAYER_WALK (i, L) {
+		// worst case: header, rgb, args, width and text
+		size_t room = L->n * (size_t) (1 + 3 + 6 * sizeof (int) + sizeof (int) + sizeof (char *));
+
+		for (hsize = 16; hsize < L->n * 2; hsize *= 2);
+		hash = must_malloc (hsize * sizeof (*hash));
+		for (j = 0; j < hsize; j++)
+			hash[j] = -1;
+		L->tiles = must_malloc ((L->n + 1) * sizeof (*L->tiles));
+		L->packed = must_malloc (room + 1);
+		L->size = 0;
+		OBJECT_WALK (L, o)
+			L->size += pack (L, o, hash, hsize, L->packed + L->size);
+		free (hash);
+		if ((L->packed = realloc (L->packed, L->size + 1)) == NULL || (L->tiles = realloc (L->tiles, (L->ntiles + 1) * sizeof (*L->tiles))) == NULL)
+			fatal ("Can't realloc layer %d", L->number);
+		before += L->n * sizeof (*L->obj);
+		after += L->size + L->ntiles * sizeof (*L->tiles);
+		free (L->obj);
+		L->obj = NULL;
+		L->max = 0;
+	}
+	printf ("Compact: %zu to %zu bytes (%.1f%%), %d colors, %.2f seconds\n", before, after,
+		before ? 100.0 * after / before : 0.0, Npalette, now () - t);
+}
+
+// can objects called 'name' be removed?
+static int
+removable (char *name)
+{
+	static char *names[] = { "line", "point", "rectangle", "circle", "arc", "triangle", "text" };
+	unsigned int i;
+
+	for (i = 0; i < sizeof (names) / sizeof (*names); i++)
+		if (strcasecmp (name, names[i]) == 0)
+			return 1;
+	return 0;
+}
+
+// read the input file, handing every object to object_add()
+static void
+parse (FILE * fp)
+{
+	char buf[MAXBUF];
+	char *tokens[MAXTOKENS];
+	struct object state = {.layer = 1,.width = DEF_LINE_WIDTH,.rgb = {DEF_RED, DEF_GREEN, DEF_BLUE},.filled = (DEF_POLY == GL_FILL) };
+	struct polygon *poly = NULL;	// being read
+	int n;
+
+	layer_get (1);		// the starting layer, and the background's
+	while (fgets (buf, sizeof (buf), fp) != NULL) {
+		n = tokenize (buf, tokens, MAXTOKENS);
+		if (polygon_line (&state, &poly, tokens, n))
+			continue;
+		Removing = (n > 1 && strcasecmp (tokens[0], "remove") == 0);
+		if (Removing && !removable (tokens[1])) {
+			error ("Remove %s ignored, only Line, Point, Rectangle, Circle, Arc, Triangle and Text can be removed", tokens[1]);
+			continue;
+		}
+		if (Removing)	// the object that follows is removed, not added
+			memmove (tokens, tokens + 1, n-- * sizeof (*tokens));
+		switch (n) {
+		case 1:
+			if (strcasecmp (tokens[0], "fill") == 0)
+				state.filled = 1;
+			else if (strcasecmp (tokens[0], "wire") == 0)
+				state.filled = 0;
+			break;
+		case 2:
+			if (strcasecmp (tokens[0], "width") == 0) {
+				state.width = scale (tokens[1]);
+			}
+			if (strcasecmp (tokens[0], "frame") == 0)
+				frame_start (atoi (tokens[1]));
+			if (strcasecmp (tokens[0], "layer") == 0) {
+				if (isdigit (tokens[1][0]) || tokens[1][0] == '-')
+					state.layer = layer (tokens[1]);
+				else
+					state.layer = layer_named (tokens[1]);
+			}
+			break;
+		case 3:
+			if (strcasecmp (tokens[0], "point") == 0)
+				object_new (&state, TYPE_POINT, xcoord (tokens[1]), ycoord (tokens[2]), 0, 0, 0, 0, NULL);
+			else if (strcasecmp (tokens[0], "layer") == 0) {
+				state.layer = layer (tokens[1]);
+				layer_name (state.layer, tokens[2]);
+			}
+			break;
+		case 4:
+			if (strcasecmp (tokens[0], "circle") == 0)
+				object_new (&state, TYPE_CIRCLE, xcoord (tokens[1]), ycoord (tokens[2]), radius (tokens[3]), 0, 0, 0, NULL);
+			else if (strcasecmp (tokens[0], "color") == 0) {
+				state.rgb[0] = color (tokens[1]);
+				state.rgb[1] = color (tokens[2]);
+				state.rgb[2] = color (tokens[3]);
+			}
+			break;
+		case 5:
+			if (strcasecmp (tokens[0], "rectangle") == 0)
+				object_new (&state, TYPE_RECT, xcoord (tokens[1]), ycoord (tokens[2]), xcoord (tokens[3]), ycoord (tokens[4]), 0, 0, NULL);
+			else if (strcasecmp (tokens[0], "line") == 0)
+				object_new (&state, TYPE_LINE, xcoord (tokens[1]), ycoord (tokens[2]), xcoord (tokens[3]), ycoord (tokens[4]), 0, 0, NULL);
+			break;
+		case 6:
+			if (strcasecmp (tokens[0], "text") == 0)
+				object_new (&state, TYPE_TEXT, xcoord (tokens[1]), ycoord (tokens[2]), angle (tokens[3]), scale (tokens[4]), 0, 0, Object_sink != NULL ? tokens[5] : strsave (tokens[5]));
+			else if (strcasecmp (tokens[0], "arc") == 0)
+				object_new (&state, TYPE_ARC, xcoord (tokens[1]), ycoord (tokens[2]), radius (tokens[3]), angle (tokens[4]), dangle (tokens[5]), 0, NULL);
+			break;
+		case 7:
+			if (strcasecmp (tokens[0], "triangle") == 0)
+				object_new (&state, TYPE_TRIANGLE, xcoord (tokens[1]), ycoord (tokens[2]), xcoord (tokens[3]), ycoord (tokens[4]), xcoord (tokens[5]), ycoord (tokens[6]), NULL);
+			break;
+		default:
+			break;
+		}
+	}
+	Removing = 0;
+	polygon_end (&state, &poly);
+}
+
+// grow the bounding rectangle by 10%
+static void
+bounds_margin (void)
+{
+	Minx -= (Maxx - Minx) / 20;
+	Miny -= (Maxy - Miny) / 20;
+	Maxx += (Maxx - Minx) / 20;
+	Maxy += (Maxy - Miny) / 20;
+}
+
+// read input file (NULL if the objects are already loaded), build display object list
+static void
+Init (FILE * fp)
+{
+	struct object state = {.layer = 1,.width = DEF_LINE_WIDTH,.rgb = {DEF_RED, DEF_GREEN, DEF_BLUE},.filled = (DEF_POLY == GL_FILL) };
+	struct object *o;
+	struct layer *L;
+	int i, w, h;
+
+	if (fp != NULL)
+		parse (fp);
+	tessellate ();
+	if (Frame_count > 0 && (Dedup || Merge || Simplify > 0 || Compact)) {
+		error ("--dedup, --merge, --simplify and --compact don't work with Frame, ignored");
+		Dedup = Merge = Compact = 0;
+		Simplify = 0;
+	}
+
+	if (Dedup)
+		dedup (Dedup > 1);
+	if (Merge || Simplify > 0)
+		simplify (Simplify);
+
+	// find bounding rectangle for all primitives
+	LAYER_WALK (i, L) {
+		OBJECT_WALK (L, o) {
+			switch (o->type) {
+			case TYPE_LINE:
+			case TYPE_RECT:
+			case TYPE_POLYGON:
+				min_max_point (X1, Y1);
+				min_max_point (X2, Y2);
+				break;
+			case TYPE_CIRCLE:
+			case TYPE_ARC:
+				min_max_point (X1 - RADIUS, Y1 - RADIUS);
+				min_max_point (X1 + RADIUS, Y1 + RADIUS);
+				break;
+			case TYPE_TRIANGLE:
+				min_max_point (X1, Y1);
+				min_max_point (X2, Y2);
+				min_max_point (X3, Y3);
+				break;
+			case TYPE_POINT:
+				min_max_point (X1, Y1);
+				break;
+			case TYPE_TEXT:
+				min_max_point (X1, Y1);
+				w = strlen (TEXT) * SCALE;
+				h = SCALE;
+				switch (ROTATE) {
+				case 0:
+					min_max_point (X1 + w, Y1 + h);
+					break;
+				case 90:
+					min_max_point (X1 - h, Y1 + w);
+					break;
+				case 180:
+					min_max_point (X1 - w, Y1 - h);
+					break;
+				case 270:
+					min_max_point (X1 + h, Y1 - w);
+					break;
+				}
+				break;
+			}
+		}
+	}
+	if (Maxx < Minx || Maxy < Miny)
+		exit (0);	// nothing to draw
+
+	bounds_margin ();
+
+	// Add a background rectangle, in the default state at the front of layer 1
+	o = object_new (&state, TYPE_RECT, Minx, Miny, Maxx, Maxy, 0, 0, NULL);
+	L = Layers[1];
+	state = *o;
+	memmove (L->obj + 1, L->obj, (L->n - 1) * sizeof (*L->obj));
+	L->obj[0] = state;
+	if (L->born != NULL) {
+		memmove (L->born + 1, L->born, (L->n - 1) * sizeof (*L->born));
+		L->born[0] = 0;
+	}
+	if (Frame_count > 0)
+		frames_setup ();
+
+	if (Compact)
+		compact ();
+	layer_setup ();
+}
+
+// Drawing diff ---------------------------------------------------------------
+//
+//      --diff old new reads both files into the same layers, so a layer
+//      name means the same layer in both, setting the old file's objects
+//      aside.  Then every layer is matched in parallel: its old objects
+//      are hashed by canon() into lists of identical objects, and each new
+//      object takes the first one off its list.  The old objects left over
+//      were removed, the new ones that found none were added.  The result
+//      is drawn as three groups of layers, unchanged/, removed/ and added/
+//      followed by the layer's name (or number), each group in one color.
+
+#define	DIFF_UNCHANGED	0
+#define	DIFF_REMOVED	1
+#define	DIFF_ADDED	2
+
+char *Diff_group[3] = { "unchanged", "removed", "added" };
+unsigned char Diff_rgb[3][3] = { {112, 112, 112}, {255, 64, 64}, {64, 255, 64} };
+
+struct diff
+{
+	struct object **old;	// the old file's objects, by layer number
+	int *nold;
+	unsigned char **old_result, **new_result;	// each object's DIFF_ result, by layer number
+	int count[3];		// objects unchanged, removed and added
+} Diff;
+
+// parallel_for() worker, match one layer's objects, leaving each one's DIFF_ result in Diff
+static void
+diff_layer (void *arg, int index, int thread)
+{
+	struct layer *L = Layers[Layer_order[index]];
+	struct object *old = Diff.old[L->number];
+	struct object c, e;
+	int nold = Diff.nold[L->number];
+	unsigned char *old_result = must_malloc (nold + 1), *new_result = must_malloc (L->n + 1);
+	int *key, *head, *next, i, j, same = 0;
+	unsigned int size, mask, h;
+
+	(void) arg;
+	(void) thread;
+	for (size = 16; size < (unsigned int) nold * 2; size *= 2);
+	mask = size - 1;
+	key = must_malloc (size * sizeof (*key));	// an old object for each list, the slot's -1 if empty
+	head = must_malloc (size * sizeof (*head));	// and the first one not matched yet
+	next = must_malloc ((nold + 1) * sizeof (*next));
+	memset (key, 0xff, size * sizeof (*key));
+	for (i = nold - 1; i >= 0; i--) {	// backwards, so the lists are in input order
+		canon (&old[i], &c, 0);
+		for (h = canon_hash (&c) & mask; key[h] >= 0; h = (h + 1) & mask) {
+			canon (&old[key[h]], &e, 0);
+			if (canon_equal (&c, &e))
+				break;
+		}
+		next[i] = key[h] >= 0 ? head[h] : -1;
+		key[h] = head[h] = i;
+		old_result[i] = DIFF_REMOVED;
+	}
+	for (i = 0; i < L->n; i++) {
+		canon (&L->obj[i], &c, 0);
+		for (h = canon_hash (&c) & mask; key[h] >= 0; h = (h + 1) & mask) {
+			canon (&old[key[h]], &e, 0);
+			if (canon_equal (&c, &e))
+				break;
+		}
+		if (key[h] >= 0 && (j = head[h]) >= 0) {
+			head[h] = next[j];
+			old_result[j] = new_result[i] = DIFF_UNCHANGED;
+			same++;
+		}
+		else
+			new_result[i] = DIFF_ADDED;
+	}
+	for (i = 0; i < nold; i++)	// the new objects are drawn instead
+		if (old_result[i] == DIFF_UNCHANGED && old[i].type == TYPE_POLYGON) {
+			free (old[i].poly->xy);
+			free (old[i].poly->contour);
+			free (old[i].poly->tri);
+			free (old[i].poly);
+		}
+	Diff.old_result[L->number] = old_result;
+	Diff.new_result[L->number] = new_result;
+	__sync_fetch_and_add (&Diff.count[DIFF_UNCHANGED], same);
+	__sync_fetch_and_add (&Diff.count[DIFF_REMOVED], nold - same);
+	__sync_fetch_and_add (&Diff.count[DIFF_ADDED], L->n - same);
+	free (key);
+	free (head);
+	free (next);
+}
+
+// add the objects of L whose DIFF_ result is 'result', in its color, to the result layer for L
+static void
+diff_add (struct layer *L, struct object *obj, unsigned char *results, int n, int result)
+{
+	char name[MAXSTRING];
+	struct object o;
+	int i, layer = 0;
+
+	for (i = 0; i < n; i++) {
+		if (results[i] != result)
+			continue;
+		if (layer == 0) {
+			if (L->name != NULL)
+				snprintf (name, sizeof (name), "%s/%s", Diff_group[result], L->name);
+			else
+				snprintf (name, sizeof (name), "%s/%d", Diff_group[result], L->number);
+			layer = layer_named (name);
+		}
+		o = obj[i];
+		o.layer = layer;
+		memcpy (o.rgb, Diff_rgb[result], sizeof (o.rgb));
+		object_add (&o);
+	}
+}
+
+// read the old and new files, and replace their layers with the differences
+static void
+diff_load (char *old, char *new)
+{
+	struct layer *L, **from;
+	FILE *fp;
+	double t;
+	int i, k, nfrom;
+
+	if ((fp = fopen (old, "r")) == NULL)
+		fatal ("Can't open %s", old);
+	parse (fp);
+	fclose (fp);
+	Diff.old = must_zalloc ((MAX_LAYERS + 1) * sizeof (*Diff.old));
+	Diff.nold = must_zalloc ((MAX_LAYERS + 1) * sizeof (*Diff.nold));
+	Diff.old_result = must_zalloc ((MAX_LAYERS + 1) * sizeof (*Diff.old_result));
+	Diff.new_result = must_zalloc ((MAX_LAYERS + 1) * sizeof (*Diff.new_result));
+	LAYER_WALK (i, L) {
+		Diff.old[L->number] = L->obj;
+		Diff.nold[L->number] = L->n;
+		L->obj = NULL;
+		L->n = L->max = 0;
+	}
+	if ((fp = fopen (new, "r")) == NULL)
+		fatal ("Can't open %s", new);
+	parse (fp);
+	fclose (fp);
+	if (Frame_count > 0)
+		fatal ("--diff doesn't work with Frame");
+	tessellate ();
+
+	t = now ();
+	parallel_for (Nlayers, diff_layer, NULL);
+	nfrom = Nlayers;
+	from = must_malloc (nfrom * sizeof (*from));
+	LAYER_WALK (i, L)
+		from[i] = L;
+	for (i = 0; i < nfrom; i++)
+		Layers[from[i]->number] = NULL;
+	Nlayers = 0;
+	memset (Layer_hash, 0, sizeof (Layer_hash));
+	for (k = DIFF_UNCHANGED; k <= DIFF_ADDED; k++)	// groups in drawing order
+		for (i = 0; i < nfrom; i++) {
+			L = from[i];
+			if (k == DIFF_REMOVED)
+				diff_add (L, Diff.old[L->number], Diff.old_result[L->number], Diff.nold[L->number], k);
+			else
+				diff_add (L, L->obj, Diff.new_result[L->number], L->n, k);
+		}
+	for (i = 0; i < nfrom; i++) {
+		free (Diff.old[from[i]->number]);
+		free (Diff.old_result[from[i]->number]);
+		free (Diff.new_result[from[i]->number]);
+		free (from[i]->obj);
+		free (from[i]);
+	}
+	free (from);
+	free (Diff.old);
+	free (Diff.nold);
+	free (Diff.old_result);
+	free (Diff.new_result);
+	printf ("Diff: %d unchanged, %d removed, %d added objects, %d layers, %d threads, %.2f seconds\n",
+		Diff.count[DIFF_UNCHANGED], Diff.count[DIFF_REMOVED], Diff.count[DIFF_ADDED], Nlayers, nthreads (), now () - t);
+	Init (NULL);
+}
+
+// Out-of-core store ---------------------------------------------------------------
+//
+//      --build-store dir reads the input twice: once for its bounds, then
+//      to bin every object by the center of its box into a grid of
+//      --store-grid tiles on a side.  dir/data holds the objects as self
+//      contained records, each tile's in a few contiguous chunks (one for
+//      every STORE_FLUSH bytes buffered while building).  dir/index holds
+//      the chunks, and for every used tile the bounds of its objects and a
+//      summary: the color of the topmost object covering each of
+//      STORE_SUMMARY x STORE_SUMMARY cells (a tile may have just that).
+//      Polygons, Frames and Removes aren't stored.
+//
+//      --store dir maps both files and loads the tiles around the view on
+//      a thread, see store_render().
+//
+//      index: header, chunks (by tile, then offset), tiles, then for every
+//             layer its number, name length and name
+//      record: header (type, fill), rgb, layer, width, args, [text, NUL]
+
+#define	STORE_MAGIC	"glvstor"
+#define	STORE_VERSION	1
+#define	STORE_RECORD	12	// bytes before the args
+
+struct store_header
+{
+	char magic[8];
+	int version;
+	int grid;		// tiles along each side
+	int minx, miny, maxx, maxy;	// bounds of the objects
+	int ntiles;		// tiles with objects or summary cells
+	int nchunks;
+	int nlayers;
+	int spill;		// furthest any tile's objects reach past it, in tiles
+	long long objects;
+};
+
+struct store_cell
+{
+	unsigned char rgb[3];
+	int layer;		// of the topmost object, 0 if there's none
+};
+
+struct store_tile
+{
+	int tx, ty;		// grid position
+	double b[4];		// bounds of its objects
+	int count;		// objects
+	int first, nchunks;	// its chunks
+	struct store_cell cell[STORE_SUMMARY * STORE_SUMMARY];
+};
+
+struct store_chunk
+{
+	long long offset;	// in dir/data
+	int size;
+	int tile;
+};
+
+// a tile being built
+struct build_tile
+{
+	struct store_tile t;
+	unsigned char *buf;	// records not written yet
+	size_t n, max;
+	int index;		// in the index
+};
+
+struct build
+{
+	int fd;			// dir/data
+	double tw, th;		// tile size
+	struct build_tile **tile;	// grid x grid, NULL when unused
+	struct store_chunk *chunk;
+	int nchunks;
+	long long offset;	// data written
+	size_t buffered;
+	long long objects;
+} Build;
+
+// bounds of o, as object_extent() but Text is just its box, rotated as text_bar()
+static int
+object_box (struct object *o, double b[4])
+{
+	double c, sn, w, h, x[4], y[4];
+	int i;
+
+	if (o->type != TYPE_TEXT)
+		return object_extent (o, b);
+	c = cos (dtor (ROTATE)), sn = sin (dtor (ROTATE));
+	w = (double) strlen (TEXT) * SCALE;
+	h = SCALE;
+	x[0] = 0, y[0] = 0;
+	x[1] = w * c, y[1] = w * sn;
+	x[2] = w * c - h * sn, y[2] = w * sn + h * c;
+	x[3] = -h * sn, y[3] = h * c;
+	b[0] = b[2] = X1, b[1] = b[3] = Y1;
+	for (i = 0; i < 4; i++) {
+		b[0] = fmin (b[0], X1 + x[i]), b[2] = fmax (b[2], X1 + x[i]);
+		b[1] = fmin (b[1], Y1 + y[i]), b[3] = fmax (b[3], Y1 + y[i]);
+	}
+	return 1;
+}
+
+// Object_sink for the first pass, just the bounds
+static struct object *
+store_bound (struct object *o)
+{
+	double b[4];
+
+	layer_get (o->layer);
+	if (object_box (o, b)) {
+		min_max_point ((int) fmax (b[0], -LARGE), (int) fmax (b[1], -LARGE));
+		min_max_point ((int) fmin (b[2], LARGE), (int) fmin (b[3], LARGE));
+	}
+	return o;
+}
+
+// write every tile's buffered records, each as a chunk
+static void
+store_flush (void)
+{
+	struct build_tile *bt;
+	int i;
+
+	for (i = 0; i < Store_grid * Store_grid; i++) {
+		if ((bt = Build.tile[i]) == NULL || bt->n == 0)
+			continue;
+		if (write (Build.fd, bt->buf, bt->n) != (ssize_t) bt->n)
+			fatal ("Can't write the store data");
+		if ((Build.nchunks & 1023) == 0 && (Build.chunk = realloc (Build.chunk, (Build.nchunks + 1024) * sizeof (*Build.chunk))) == NULL)
+			fatal ("Can't grow the store chunks");
+		Build.chunk[Build.nchunks].offset = Build.offset;
+		Build.chunk[Build.nchunks].size = bt->n;
+		Build.chunk[Build.nchunks++].tile = i;
+		Build.offset += bt->n;
+		free (bt->buf);
+		bt->buf = NULL;
+		bt->n = bt->max = 0;
+	}
+	Build.buffered = 0;
+}
+
+// the tile at grid position tx,ty, created if needed
+static struct build_tile *
+build_tile (int tx, int ty)
+{
+	struct build_tile *bt = Build.tile[ty * Store_grid + tx];
+
+	if (bt != NULL)
+		return bt;
+	bt = Build.tile[ty * Store_grid + tx] = must_zalloc (sizeof (*bt));
+	bt->t.tx = tx;
+	bt->t.ty = ty;
+	bt->t.b[0] = bt->t.b[1] = HUGE_VAL;	// no objects yet
+	bt->t.b[2] = bt->t.b[3] = -HUGE_VAL;
+	return bt;
+}
+
+// Object_sink for the second pass, append o's record to its tile
+static struct object *
+store_add (struct object *o)
+{
+	struct build_tile *bt;
+	struct store_cell *cell;
+	unsigned char *p;
+	double b[4];
+	int tx, ty, x, y, c[4], n, outline, args, len = 0, size;
+
+	if (!object_box (o, b))
+		return o;
+
+	// the summary cells it covers, just the edge ones of a big Wire shape
+	n = Store_grid * STORE_SUMMARY - 1;
+	c[0] = clamp ((int) floor ((b[0] - Minx) / Build.tw * STORE_SUMMARY), 0, n);
+	c[1] = clamp ((int) floor ((b[1] - Miny) / Build.th * STORE_SUMMARY), 0, n);
+	c[2] = clamp ((int) floor ((b[2] - Minx) / Build.tw * STORE_SUMMARY), 0, n);
+	c[3] = clamp ((int) floor ((b[3] - Miny) / Build.th * STORE_SUMMARY), 0, n);
+	outline = !o->filled && o->type != TYPE_LINE && o->type != TYPE_POINT && o->type != TYPE_TEXT;
+	for (y = c[1]; y <= c[3]; y++) {
+		for (x = c[0]; x <= c[2]; x++) {
+			if (outline && x != c[0] && x != c[2] && y != c[1] && y != c[3])
+				continue;
+			bt = build_tile (x / STORE_SUMMARY, y / STORE_SUMMARY);
+			cell = &bt->t.cell[(y % STORE_SUMMARY) * STORE_SUMMARY + x % STORE_SUMMARY];
+			if (o->layer >= cell->layer) {
+				cell->layer = o->layer;
+				memcpy (cell->rgb, o->rgb, sizeof (cell->rgb));
+			}
+		}
+	}
+
+	// stored in the tile its center is in
+	tx = clamp ((int) floor (((b[0] + b[2]) / 2 - Minx) / Build.tw), 0, Store_grid - 1);
+	ty = clamp ((int) floor (((b[1] + b[3]) / 2 - Miny) / Build.th), 0, Store_grid - 1);
+	bt = build_tile (tx, ty);
+	bt->t.b[0] = fmin (bt->t.b[0], b[0]);
+	bt->t.b[1] = fmin (bt->t.b[1], b[1]);
+	bt->t.b[2] = fmax (bt->t.b[2], b[2]);
+	bt->t.b[3] = fmax (bt->t.b[3], b[3]);
+	bt->t.count++;
+
+	args = Pack_args[o->type] * sizeof (int);
+	if (o->type == TYPE_TEXT)
+		len = strlen (TEXT) + 1;
+	size = STORE_RECORD + args + len;
+	if (bt->n + size > bt->max) {
+		bt->max = bt->max ? bt->max * 2 : 4096;
+		if ((bt->buf = realloc (bt->buf, bt->max)) == NULL)
+			fatal ("Can't grow a store tile");
+	}
+	p = bt->buf + bt->n;
+	p[0] = o->type | (o->filled ? PACK_FILLED : 0);
+	memcpy (p + 1, o->rgb, 3);
+	memcpy (p + 4, &o->layer, sizeof (int));
+	memcpy (p + 8, &o->width, sizeof (int));
+	memcpy (p + STORE_RECORD, o->arg, args);
+	memcpy (p + STORE_RECORD + args, TEXT, len);
+	bt->n += size;
+	Build.objects++;
+	if ((Build.buffered += size) > STORE_FLUSH)
+		store_flush ();
+	return o;
+}
+
+static int
+chunk_cmp (const void *a, const void *b)
+{
+	const struct store_chunk *x = a, *y = b;
+
+	if (x->tile != y->tile)
+		return x->tile - y->tile;
+	return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+// --build-store: bin the objects in file into a tiled store in dir
+static void
+store_build (char *dir, char *file)
+{
+	struct store_header h;
+	struct build_tile *bt;
+	char path[MAXSTRING];
+	double t = now ();
+	FILE *fp;
+	int i, j, g, n, len;
+
+	if ((fp = fopen (file, "r")) == NULL)
+		fatal ("Can't open %s", file);
+	Object_sink = store_bound;
+	parse (fp);
+	if (Maxx < Minx || Maxy < Miny)
+		fatal ("Nothing to store in %s", file);
+	if (mkdir (dir, 0755) != 0 && errno != EEXIST)
+		fatal ("Can't create %s", dir);
+	snprintf (path, sizeof (path), "%s/data", dir);
+	if ((Build.fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		fatal ("Can't create %s", path);
+	Build.tw = ((double) Maxx - Minx + 1) / Store_grid;
+	Build.th = ((double) Maxy - Miny + 1) / Store_grid;
+	Build.tile = must_zalloc (Store_grid * Store_grid * sizeof (*Build.tile));
+	rewind (fp);
+	Frame_read = 0;
+	Object_sink = store_add;
+	parse (fp);
+	Object_sink = NULL;
+	fclose (fp);
+	store_flush ();
+	if (close (Build.fd) != 0)
+		fatal ("Can't write %s", path);
+
+	// number the tiles in grid order, and point them at their chunks
+	memset (&h, 0, sizeof (h));
+	memcpy (h.magic, STORE_MAGIC, sizeof (h.magic));
+	h.version = STORE_VERSION;
+	h.grid = Store_grid;
+	h.minx = Minx, h.miny = Miny, h.maxx = Maxx, h.maxy = Maxy;
+	h.nchunks = Build.nchunks;
+	h.nlayers = Nlayers;
+	h.objects = Build.objects;
+	for (i = 0; i < Store_grid * Store_grid; i++)
+		if ((bt = Build.tile[i]) != NULL)
+			bt->index = h.ntiles++;
+	qsort (Build.chunk, Build.nchunks, sizeof (*Build.chunk), chunk_cmp);
+	for (i = 0; i < Build.nchunks; i = j) {
+		g = Build.chunk[i].tile;
+		bt = Build.tile[g];
+		bt->t.first = i;
+		for (j = i; j < Build.nchunks && Build.chunk[j].tile == g; j++)
+			Build.chunk[j].tile = bt->index;
+		bt->t.nchunks = j - i;
+		n = ceil (fmax (fmax (Minx + bt->t.tx * Build.tw - bt->t.b[0], bt->t.b[2] - (Minx + (bt->t.tx + 1) * Build.tw)) / Build.tw,
+				fmax (Miny + bt->t.ty * Build.th - bt->t.b[1], bt->t.b[3] - (Miny + (bt->t.ty + 1) * Build.th)) / Build.th));
+		h.spill = clamp (n, h.spill, Store_grid);
+	}
+
+	snprintf (path, sizeof (path), "%s/index", dir);
+	if ((fp = fopen (path, "w")) == NULL)
+		fatal ("Can't create %s", path);
+	fwrite (&h, sizeof (h), 1, fp);
+	fwrite (Build.chunk, sizeof (*Build.chunk), Build.nchunks, fp);
+	for (i = 0; i < Store_grid * Store_grid; i++)
+		if ((bt = Build.tile[i]) != NULL)
+			fwrite (&bt->t, sizeof (bt->t), 1, fp);
+	for (i = 0; i < Nlayers; i++) {
+		n = Layer_order[i];
+		len = Layers[n]->name != NULL ? strlen (Layers[n]->name) : 0;
+		fwrite (&n, sizeof (n), 1, fp);
+		fwrite (&len, sizeof (len), 1, fp);
+		if (len > 0)
+			fwrite (Layers[n]->name, 1, len, fp);
+	}
+	if (ferror (fp) || fclose (fp) != 0)
+		fatal ("Can't write %s", path);
+	if (Sink_polygons > 0)
+		error ("%d Polygons not stored", Sink_polygons);
+	if (Frame_count > 0)
+		error ("Frames and Removes aren't stored, every object added is");
+	printf ("Stored %s: %lld objects in %d tiles, %d chunks, %.1f MB, %.2f seconds\n", dir, h.objects, h.ntiles, h.nchunks, Build.offset / 1048576.0, now () - t);
+}
+
+// a tile of the open store
+struct tile
+{
+	struct store_tile *t;	// in the index
+	int state;		// TILE_OUT ... TILE_IN
+	struct layer *layers;	// loaded: one for each layer number, in order
+	int nlayers;
+	size_t bytes;		// memory it holds when loaded
+	unsigned int wanted;	// Store.frame it was last in or near the view
+	GLuint summary;		// summary display list, 0 when not built
+	unsigned int summary_gen;	// Layer_vis_gen it was built for
+};
+
+#define	TILE_OUT	0
+#define	TILE_QUEUED	1
+#define	TILE_LOADING	2
+#define	TILE_IN		3	// only the main thread touches loaded tiles
+
+struct store
+{
+	struct store_header *h;	// mapped dir/index
+	struct store_chunk *chunk;
+	struct store_tile *rec;
+	struct tile *tile;
+	int *at;		// tile index at each grid position, -1 if unused
+	int *lru;		// eviction candidates
+	unsigned char *data;	// mapped dir/data
+	size_t size;
+	double tw, th;		// tile size
+	size_t bytes;		// held by loaded tiles
+	unsigned int frame;	// frames drawn
+	double panx, pany;	// the view the last one was drawn at
+	pthread_t thread;	// the loader
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int *queue;		// tiles to load, the last first
+	int nqueue;
+	int loading;		// the loader is decoding a tile
+	int loaded;		// a tile was loaded since Store_poll() last looked
+	int polling;		// the Store_poll() timer is armed
+} Store;
+
+// map a whole file read only, NULL if it's empty
+static unsigned char *
+store_map (char *path, size_t * size)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	if ((fd = open (path, O_RDONLY)) < 0 || fstat (fd, &st) != 0)
+		fatal ("Can't open %s", path);
+	*size = st.st_size;
+	p = (*size > 0) ? mmap (NULL, *size, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+	if (p == MAP_FAILED)
+		fatal ("Can't map %s", path);
+	close (fd);
+	return p;
+}
+
+// decode the store record at p into o, returns its size (0 if it's corrupt or doesn't fit in 'room' bytes)
+static int
+store_unpack (const unsigned char *p, size_t room, struct object *o)
+{
+	const unsigned char *nul;
+	size_t args;
+
+	memset (o, 0, sizeof (*o));
+	if (room < STORE_RECORD)
+		return 0;
+	o->type = p[0] & PACK_TYPE;
+	if (o->type == TYPE_NONE || o->type >= (int) sizeof (Pack_args))
+		return 0;
+	args = Pack_args[o->type] * sizeof (int);
+	if (args > room - STORE_RECORD)
+		return 0;
+	o->filled = (p[0] & PACK_FILLED) != 0;
+	memcpy (o->rgb, p + 1, 3);
+	memcpy (&o->layer, p + 4, sizeof (int));
+	memcpy (&o->width, p + 8, sizeof (int));
+	memcpy (o->arg, p + STORE_RECORD, args);
+	if (o->layer < 1 || o->layer > MAX_LAYERS)
+		return 0;
+	if (o->type != TYPE_TEXT)
+		return STORE_RECORD + args;
+	o->text = (char *) p + STORE_RECORD + args;	// used in place
+	if ((nul = memchr (o->text, '\0', room - STORE_RECORD - args)) == NULL)
+		return 0;
+	return nul + 1 - p;
+}
+
+// the layer for number n of a loading tile, added if needed
+static struct layer *
+tile_layer (struct tile *T, int n)
+{
+	int i;
+
+	for (i = T->nlayers; i > 0 && T->layers[i - 1].number > n; i--);
+	if (i > 0 && T->layers[i - 1].number == n)
+		return &T->layers[i - 1];
+	if ((T->layers = realloc (T->layers, (T->nlayers + 1) * sizeof (*T->layers))) == NULL)
+		fatal ("Can't grow a tile's layers");
+	memmove (T->layers + i + 1, T->layers + i, (T->nlayers++ - i) * sizeof (*T->layers));
+	memset (&T->layers[i], 0, sizeof (*T->layers));
+	T->layers[i].number = n;
+	return &T->layers[i];
+}
+
+// decode a tile's records into its layers
+static void
+tile_load (struct tile *T)
+{
+	struct store_chunk *c;
+	struct layer *L = NULL;
+	struct object o;
+	const unsigned char *p, *end;
+	size_t bytes = 0;
+	int i, size;
+
+	for (i = 0; i < T->t->nchunks; i++) {
+		c = &Store.chunk[T->t->first + i];
+		bytes += c->size;
+		for (p = Store.data + c->offset, end = p + c->size; p < end; p += size) {
+			if ((size = store_unpack (p, end - p, &o)) == 0) {
+				error ("Store tile %d,%d is corrupt", T->t->tx, T->t->ty);
+				break;
+			}
+			if (L == NULL || L->number != o.layer)
+				L = tile_layer (T, o.layer);
+			if (L->n == L->max) {
+				L->max = L->max ? L->max * 2 : 64;
+				if ((L->obj = realloc (L->obj, L->max * sizeof (*L->obj))) == NULL)
+					fatal ("Can't grow a tile's layer");
+			}
+			L->obj[L->n++] = o;
+		}
+	}
+	for (i = 0; i < T->nlayers; i++)
+		bytes += T->layers[i].max * sizeof (struct object);
+	T->bytes = bytes + T->nlayers * sizeof (struct layer);
+	__sync_fetch_and_add (&Store.bytes, T->bytes);
+}
+
+// load the queued tiles, the most recently queued first
+static void *
+store_loader (void *arg)
+{
+	struct tile *T;
+
+	(void) arg;
+	pthread_mutex_lock (&Store.lock);
+	for (;;) {
+		while (Store.nqueue == 0)
+			pthread_cond_wait (&Store.wake, &Store.lock);
+		T = &Store.tile[Store.queue[--Store.nqueue]];
+		T->state = TILE_LOADING;
+		Store.loading = 1;
+		pthread_mutex_unlock (&Store.lock);
+		tile_load (T);
+		pthread_mutex_lock (&Store.lock);
+		__atomic_store_n (&T->state, TILE_IN, __ATOMIC_RELEASE);
+		Store.loading = 0;
+		__atomic_store_n (&Store.loaded, 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+// --store: open the store in dir instead of reading a drawing
+static void
+store_open (char *dir)
+{
+	struct object state = {.layer = 1,.width = DEF_LINE_WIDTH,.rgb = {DEF_RED, DEF_GREEN, DEF_BLUE},.filled = (DEF_POLY == GL_FILL) };
+	struct store_header *h;
+	struct store_tile *t;
+	struct store_chunk *c;
+	char path[MAXSTRING], name[MAXSTRING];
+	unsigned char *p, *end;
+	size_t size;
+	int i, n, len;
+
+	snprintf (path, sizeof (path), "%s/index", dir);
+	h = Store.h = (struct store_header *) store_map (path, &size);
+	if (size < sizeof (*h) || memcmp (h->magic, STORE_MAGIC, sizeof (h->magic)) != 0 || h->version != STORE_VERSION)
+		fatal ("%s isn't a store index", path);
+	Store.chunk = (struct store_chunk *) (h + 1);
+	Store.rec = (struct store_tile *) (Store.chunk + h->nchunks);
+	p = (unsigned char *) (Store.rec + h->ntiles);
+	end = (unsigned char *) h + size;
+	if (h->grid < 1 || h->ntiles < 0 || h->nchunks < 0 || p > end)
+		fatal ("%s is truncated", path);
+	for (i = 0; i < h->nlayers; i++) {
+		if (p + 2 * sizeof (int) > end)
+			fatal ("%s is truncated", path);
+		memcpy (&n, p, sizeof (n));
+		memcpy (&len, p + sizeof (n), sizeof (len));
+		p += 2 * sizeof (int);
+		if (n < 1 || n > MAX_LAYERS || len < 0 || len >= MAXSTRING || p + len > end)
+			fatal ("%s is corrupt", path);
+		layer_get (n);
+		if (len > 0) {
+			memcpy (name, p, len);
+			name[len] = '\0';
+			layer_name (n, name);
+		}
+		p += len;
+	}
+
+	snprintf (path, sizeof (path), "%s/data", dir);
+	Store.data = store_map (path, &Store.size);
+	Store.tile = must_zalloc (h->ntiles * sizeof (*Store.tile));
+	Store.lru = must_malloc (h->ntiles * sizeof (*Store.lru));
+	Store.queue = must_malloc (h->ntiles * sizeof (*Store.queue));
+	Store.at = must_malloc (h->grid * h->grid * sizeof (*Store.at));
+	for (i = 0; i < h->grid * h->grid; i++)
+		Store.at[i] = -1;
+	for (i = 0; i < h->ntiles; i++) {
+		t = Store.tile[i].t = &Store.rec[i];
+		if (t->tx < 0 || t->tx >= h->grid || t->ty < 0 || t->ty >= h->grid || t->first < 0 || t->nchunks < 0 || t->first + t->nchunks > h->nchunks)
+			fatal ("%s is corrupt", dir);
+		for (n = 0; n < t->nchunks; n++) {
+			c = &Store.chunk[t->first + n];
+			if (c->offset < 0 || c->size < 0 || (size_t) (c->offset + c->size) > Store.size)
+				fatal ("%s/data is truncated", dir);
+		}
+		Store.at[t->ty * h->grid + t->tx] = i;
+		if (t->nchunks == 0)
+			Store.tile[i].state = TILE_IN;	// just a summary, nothing to load
+	}
+	Minx = h->minx, Miny = h->miny, Maxx = h->maxx, Maxy = h->maxy;
+	Store.tw = ((double) Maxx - Minx + 1) / h->grid;
+	Store.th = ((double) Maxy - Miny + 1) / h->grid;
+	bounds_margin ();
+	object_new (&state, TYPE_RECT, Minx, Miny, Maxx, Maxy, 0, 0, NULL);	// the background, as Init() adds it
+
+	pthread_mutex_init (&Store.lock, NULL);
+	pthread_cond_init (&Store.wake, NULL);
+	if (pthread_create (&Store.thread, NULL, store_loader, NULL) != 0)
+		fatal ("Can't create the store loader thread");
+	printf ("Store %s: %lld objects in %d tiles, %.1f MB\n", dir, h->objects, h->ntiles, Store.size / 1048576.0);
+	all_layers_on ();
+	if (Layers_spec != NULL && layer_select (Layers_spec, '=') == 0)
+		error ("No layers match %s", Layers_spec);
+}
+
+// ask for the window to be redrawn
+static void
+post_redisplay (void)
+{
+	if (Headless)
+		Redisplay = 1;
+	else
+		glutPostRedisplay ();
+}
+
+static void
+set_title (char *title)
+{
+	if (!Headless)
+		glutSetWindowTitle (title);
+}
+
+static inline int
+is_shift_pressed (void)
+{
+	return Mods & GLUT_ACTIVE_SHIFT;
+}
+
+static inline int
+is_ctrl_pressed (void)
+{
+	return Mods & GLUT_ACTIVE_CTRL;
+}
+
+static inline int
+is_alt_pressed (void)
+{
+	return Mods & GLUT_ACTIVE_ALT;
+}
+
+static inline void
+bitmap_output (char *s)
+{
+	glRasterPos2f (0, 0);
+	while (*s)
+		glutBitmapCharacter (BITMAP_FONT, *s++);
+}
+
+// Stroke font ---------------------------------------------------------------------
+//
+//      Text is drawn with glview's own copy of GLUT's Mono Roman stroke
+//      font, in font.h, not with glutStrokeCharacter(): workers recording
+//      batches and the software renderer can't call glut, and without a
+//      window (--export, --headless) glut isn't even initialised, so every
+//      renderer draws the same strokes from the same table.
+
+//
+//      stroke_text --- call line() for every stroke segment of a Text object
+//
+//      Coordinates are in model space, transformed exactly as glPrintf()
+//      does for the GL renderer.
+//
+static void
+stroke_text (int x, int y, int rot, int scale, char *s, void (*line) (void *arg, double x1, double y1, double x2, double y2), void *arg)
+{
+	double k = MIN_TEXT_SCALE * scale;
+	double c = cos (dtor (rot)) * k;
+	double sn = sin (dtor (rot)) * k;
+	double cursor = 0;
+	int i, j;
+
+	for (; *s; s++) {
+		const struct font_glyph *ch;
+
+		if (*s < 0)
+			continue;
+		ch = &Font_glyph[(int) *s];
+		for (i = ch->first; i < ch->first + ch->n; i++) {
+			const float (*v)[2] = Font_v + Font_strip[i][0];
+
+			for (j = 1; j < Font_strip[i][1]; j++) {
+				double ax = cursor + v[j - 1][0], ay = v[j - 1][1];
+				double bx = cursor + v[j][0], by = v[j][1];
+
+				line (arg, x + ax * c - ay * sn, y + ax * sn + ay * c, x + bx * c - by * sn, y + bx * sn + by * c);
+			}
+		}
+		cursor += ch->right;
+	}
+}
+
+// Recorded drawing --------------------------------------------------------------------
+//
+//      Objects are drawn through these rec_ calls, which are the GL calls
+//      of the same name on the render thread.  On a tessellation worker
+//      (see record_run()) Rec is set and they're appended to it instead, to
+//      be played back by the render thread, so the batch it compiles is
+//      exactly the one drawing directly would.
+
+#define	REC_BEGIN	0
+#define	REC_END		1
+#define	REC_VERTEX3I	2
+#define	REC_VERTEX2F	3
+#define	REC_TEXCOORD	4
+#define	REC_POLYMODE	5
+#define	REC_WIDTH	6	// line width and point size
+#define	REC_COLOR	7
+#define	REC_PUSH	8
+#define	REC_POP		9
+#define	REC_TRANSLATE	10
+#define	REC_ROTATE	11	// about z
+#define	REC_SCALE	12
+#define	REC_TEXTURE	13	// the glyph atlas on or off
+
+struct rec_op
+{
+	int op;
+	union
+	{
+		int i[3];
+		float f[3];
+		unsigned char rgb[3];
+	};
+};
+
+struct recording
+{
+	struct rec_op *op;
+	int n;
+	int max;
+	int texts;		// Text objects in it
+	double zoom;		// drawn for this Zoom
+};
+
+__thread struct recording *Rec = NULL;	// recording on this thread, NULL when drawing
+
+static inline struct rec_op *
+rec_op (int op)
+{
+	if (Rec->n >= Rec->max) {
+		Rec->max = Rec->max * 2 + 1024;
+		if ((Rec->op = realloc (Rec->op, Rec->max * sizeof (*Rec->op))) == NULL)
+			fatal ("Can't allocate %d recorded calls", Rec->max);
+	}
+	Rec->op[Rec->n].op = op;
+	return &Rec->op[Rec->n++];
+}
+
+static inline void
+rec_begin (GLenum mode)
+{
+	if (Rec == NULL)
+		glBegin (mode);
+	else
+		rec_op (REC_BEGIN)->i[0] = mode;
+}
+
+static inline void
+rec_end (void)
+{
+	if (Rec == NULL)
+		glEnd ();
+	else
+		rec_op (REC_END);
+}
+
+static inline void
+rec_vertex3i (int x, int y, int z)
+{
+	struct rec_op *r;
+
+	if (Rec == NULL) {
+		glVertex3i (x, y, z);
+		return;
+	}
+	r = rec_op (REC_VERTEX3I);
+	r->i[0] = x, r->i[1] = y, r->i[2] = z;
+}
+
+static inline void
+rec_vertex2f (float x, float y)
+{
+	struct rec_op *r;
+
+	if (Rec == NULL) {
+		glVertex2f (x, y);
+		return;
+	}
+	r = rec_op (REC_VERTEX2F);
+	r->f[0] = x, r->f[1] = y;
+}
+
+static inline void
+rec_texcoord2f (float s, float t)
+{
+	struct rec_op *r;
+
+	if (Rec == NULL) {
+		glTexCoord2f (s, t);
+		return;
+	}
+	r = rec_op (REC_TEXCOORD);
+	r->f[0] = s, r->f[1] = t;
+}
+
+static inline void
+rec_polygon_mode (GLenum mode)
+{
+	if (Rec == NULL)
+		glPolygonMode (GL_FRONT_AND_BACK, mode);
+	else
+		rec_op (REC_POLYMODE)->i[0] = mode;
+}
+
+static inline void
+rec_width (float w)
+{
+	if (Rec == NULL) {
+		glLineWidth (w);
+		glPointSize (w);
+	}
+	else
+		rec_op (REC_WIDTH)->f[0] = w;
+}
+
+static inline void
+rec_color3ubv (unsigned char *rgb)
+{
+	if (Rec == NULL)
+		glColor3ubv (rgb);
+	else
+		memcpy (rec_op (REC_COLOR)->rgb, rgb, 3);
+}
+
+static inline void
+rec_push (void)
+{
+	if (Rec == NULL)
+		glPushMatrix ();
+	else
+		rec_op (REC_PUSH);
+}
+
+static inline void
+rec_pop (void)
+{
+	if (Rec == NULL)
+		glPopMatrix ();
+	else
+		rec_op (REC_POP);
+}
+
+static inline void
+rec_translatef (float x, float y, float z)
+{
+	struct rec_op *r;
+
+	if (Rec == NULL) {
+		glTranslatef (x, y, z);
+		return;
+	}
+	r = rec_op (REC_TRANSLATE);
+	r->f[0] = x, r->f[1] = y, r->f[2] = z;
+}
+
+static inline void
+rec_rotatef (float angle)
+{
+	if (Rec == NULL)
+		glRotatef (angle, 0, 0, 1);
+	else
+		rec_op (REC_ROTATE)->f[0] = angle;
+}
+
+static inline void
+rec_scalef (float x, float y, float z)
+{
+	struct rec_op *r;
+
+	if (Rec == NULL) {
+		glScalef (x, y, z);
+		return;
+	}
+	r = rec_op (REC_SCALE);
+	r->f[0] = x, r->f[1] = y, r->f[2] = z;
+}
+
+// the glyph atlas texture on or off
+static inline void
+rec_texture (int on)
+{
+	if (Rec != NULL)
+		rec_op (REC_TEXTURE)->i[0] = on;
+	else if (on) {
+		glEnable (GL_TEXTURE_2D);
+		glBindTexture (GL_TEXTURE_2D, Atlas);
+	}
+	else
+		glDisable (GL_TEXTURE_2D);
+}
+
+// the zoom being drawn for
+static inline double
+rec_zoom (void)
+{
+	return Rec != NULL ? Rec->zoom : Zoom;
+}
+
+// stroke text at the origin, as glutStrokeCharacter() draws it
+static void
+stroke_output (char *s)
+{
+	const struct font_glyph *ch;
+	int i, j;
+
+	for (; *s != '\0'; s++) {
+		if (*s < 0)
+			continue;	// as glutStrokeCharacter() does
+		ch = &Font_glyph[(int) *s];
+		for (i = ch->first; i < ch->first + ch->n; i++) {
+			rec_begin (GL_LINE_STRIP);
+			for (j = 0; j < Font_strip[i][1]; j++)
+				rec_vertex2f (Font_v[Font_strip[i][0] + j][0], Font_v[Font_strip[i][0] + j][1]);
+			rec_end ();
+		}
+		rec_translatef (ch->right, 0, 0);
+	}
+}
+
+// play a recording back into GL
+static void
+rec_play (struct recording *R)
+{
+	struct rec_op *r;
+
+	for (r = R->op; r < R->op + R->n; r++) {
+		switch (r->op) {
+		case REC_BEGIN:
+			glBegin (r->i[0]);
+			break;
+		case REC_END:
+			glEnd ();
+			break;
+		case REC_VERTEX3I:
+			glVertex3i (r->i[0], r->i[1], r->i[2]);
+			break;
+		case REC_VERTEX2F:
+			glVertex2f (r->f[0], r->f[1]);
+			break;
+		case REC_TEXCOORD:
+			glTexCoord2f (r->f[0], r->f[1]);
+			break;
+		case REC_POLYMODE:
+			glPolygonMode (GL_FRONT_AND_BACK, r->i[0]);
+			break;
+		case REC_WIDTH:
+			glLineWidth (r->f[0]);
+			glPointSize (r->f[0]);
+			break;
+		case REC_COLOR:
+			glColor3ubv (r->rgb);
+			break;
+		case REC_PUSH:
+			glPushMatrix ();
+			break;
+		case REC_POP:
+			glPopMatrix ();
+			break;
+		case REC_TRANSLATE:
+			glTranslatef (r->f[0], r->f[1], r->f[2]);
+			break;
+		case REC_ROTATE:
+			glRotatef (r->f[0], 0, 0, 1);
+			break;
+		case REC_SCALE:
+			glScalef (r->f[0], r->f[1], r->f[2]);
+			break;
+		case REC_TEXTURE:
+			if (r->i[0]) {
+				glEnable (GL_TEXTURE_2D);
+				glBindTexture (GL_TEXTURE_2D, Atlas);
+			}
+			else
+				glDisable (GL_TEXTURE_2D);
+			break;
+		}
+	}
+}
+
+static void
+glPrintf (int x, int y, int rot, int scale, int z, char *format, ...)
+{
+	va_list args;
+	char buffer[MAXSTRING + 64];
+
+	va_start (args, format);
+	vsnprintf (buffer, sizeof (buffer), format, args);
+	va_end (args);
+
+	rec_push ();
+	rec_translatef ((float) x, (float) y, (float) z);
+	rec_rotatef ((float) rot);
+	rec_scalef (MIN_TEXT_SCALE * scale, MIN_TEXT_SCALE * scale, MIN_TEXT_SCALE * scale);
+	stroke_output (buffer);
+	rec_pop ();
+}
+
+// Primitive geometry, shared by the OpenGL and software renderers ----------------
+
+// corners of a wide line of 'width' as a quad, returns 0 when the line is thin
+static int
+line_quad (int x1, int y1, int x2, int y2, int width, int q[8])
+{
+	width /= 2;
+
+	if (width <= 0)
+		return 0;
+	if (y1 == y2) {		// horizontal, square ends
+		if (x1 > x2) {
+			int t = x1;
+
+			x1 = x2;
+			x2 = t;
+		}
+		q[0] = x1 - width, q[1] = y1 - width;
+		q[2] = x1 - width, q[3] = y1 + width;
+		q[4] = x2 + width, q[5] = y2 + width;
+		q[6] = x2 + width, q[7] = y2 - width;
+	}
+	else if (x1 == x2) {	// vertical, square ends
+		if (y1 > y2) {
+			int t = y1;
+
+			y1 = y2;
+			y2 = t;
+		}
+		q[0] = x1 - width, q[1] = y1 - width;
+		q[2] = x1 + width, q[3] = y1 - width;
+		q[4] = x2 + width, q[5] = y2 + width;
+		q[6] = x2 - width, q[7] = y2 + width;
+	}
+	else {
+		double angle = atan2 ((double) (y2 - y1), (double) (x2 - x1));
+		int t2sina = (int) (width * sin (angle));
+		int t2cosa = (int) (width * cos (angle));
+
+		q[0] = x1 + t2sina, q[1] = y1 - t2cosa;
+		q[2] = x2 + t2sina, q[3] = y2 - t2cosa;
+		q[4] = x2 - t2sina, q[5] = y2 + t2cosa;
+		q[6] = x1 - t2sina, q[7] = y1 + t2cosa;
+	}
+	return 1;
+}
+
+// arc outline points relative to the center, at most 'steps' per full circle, returns the number of segments
+static int
+arc_points (int radius, int dstart, int ddelta, int w, int steps, int *ox, int *oy, int *ix, int *iy)
+{
+	double angle_start = dtor ((dstart - 90) % 360);
+	double angle_delta = dtor (ddelta);
+	double angle_end = angle_start;
+	double angle;
+	int step = 0;
+
+	if (angle_delta >= 0)
+		angle_end += angle_delta;
+	else
+		angle_start += angle_delta;
+
+	for (angle = angle_start; angle < angle_end && step < steps; angle += (TWO_PI / steps), step++) {
+		ox[step] = (int) (sin (angle) * (radius + (w / 2)));
+		oy[step] = (int) (cos (angle) * (radius + (w / 2)));
+		ix[step] = (int) (sin (angle) * (radius - (w / 2)));
+		iy[step] = (int) (cos (angle) * (radius - (w / 2)));
+	}
+	ox[step] = (int) (sin (angle_end) * (radius + (w / 2)));
+	oy[step] = (int) (cos (angle_end) * (radius + (w / 2)));
+	ix[step] = (int) (sin (angle_end) * (radius - (w / 2)));
+	iy[step] = (int) (cos (angle_end) * (radius - (w / 2)));
+
+	if (step > 0 && ox[step] == ox[step - 1] && oy[step] == oy[step - 1])
+		step--;
+	return step;
+}
+
+// circle outline of 'steps' points (x,y pairs), returns the number of points
+static int
+circle_points (int x, int y, int radius, int steps, int xy[(CIRCLE_STEPS + 1) * 2])
+{
+	double angle;
+	int n = 0;
+
+	for (angle = 0; angle < TWO_PI && n <= steps; angle += (TWO_PI / steps), n++) {
+		xy[n * 2 + 0] = x + (int) (sin (angle) * radius);
+		xy[n * 2 + 1] = y + (int) (cos (angle) * radius);
+	}
+	return n;
+}
+
+#define	TEXT_GREEK	0
+#define	TEXT_ATLAS	1
+#define	TEXT_STROKE	2
+
+// how Text of 'scale' is drawn at 'zoom', by its size on screen
+static inline int
+text_lod (int scale, double zoom)
+{
+	double pixels = scale * zoom;
+
+	if (pixels < GREEK_PIXELS)
+		return TEXT_GREEK;
+	if (pixels < ATLAS_PIXELS)
+		return TEXT_ATLAS;
+	return TEXT_STROKE;
+}
+
+// corners of the bar drawn for Text that is too small to read
+static void
+text_bar (int x, int y, int rot, int scale, int len, int q[8])
+{
+	double c = cos (dtor (rot)), sn = sin (dtor (rot));
+	double w = (double) len * scale, h = scale * 0.6;	// about the x-height
+
+	q[0] = x, q[1] = y;
+	q[2] = x + (int) (w * c), q[3] = y + (int) (w * sn);
+	q[4] = x + (int) (w * c - h * sn), q[5] = y + (int) (w * sn + h * c);
+	q[6] = x - (int) (h * sn), q[7] = y + (int) (h * c);
+}
+
+// Software rasterizer --------------------------------------------------------------------
+//
+//      Renders the same primitives as the GL path into an RGB tile buffer
+//      (pixel centers, no antialiasing), for --export.  Tile coordinates
+//      have y going down from the top-left corner.
+
+#define	RAS_MAX_POLY	((CIRCLE_STEPS + 1) * 2)	// most vertices in one polygon
+
+struct raster
+{
+	unsigned char *pix;	// w*h RGB pixels
+	int x0, y0;		// image position of the tile's top-left pixel
+	int w, h;		// tile size
+	double zoom;		// model to image scale
+	double ox, oy;		// model coordinate at the image's top-left corner
+	unsigned char rgb[3];	// current color
+	int lw;			// current line width in pixels
+};
+
+static inline double
+ras_x (struct raster *r, double x)
+{
+	return (x - r->ox) * r->zoom - r->x0;
+}
+
+static inline double
+ras_y (struct raster *r, double y)
+{
+	return (r->oy - y) * r->zoom - r->y0;
+}
+
+// first pixel whose center is at or after v, limited to lo..hi
+static inline int
+ras_pixel (double v, int lo, int hi)
+{
+	v = ceil (v - 0.5);
+	if (v < lo)
+		return lo;
+	if (v > hi)
+		return hi;
+	return (int) v;
+}
+
+static inline void
+ras_dot (struct raster *r, int x, int y)
+{
+	unsigned char *p;
+
+	if (x < 0 || y < 0 || x >= r->w || y >= r->h)
+		return;
+	p = r->pix + (y * r->w + x) * 3;
+	p[0] = r->rgb[0];
+	p[1] = r->rgb[1];
+	p[2] = r->rgb[2];
+}
+
+// fill pixels xa..xb-1 of row y
+static inline void
+ras_span (struct raster *r, int y, int xa, int xb)
+{
+	unsigned char *p = r->pix + (y * r->w + xa) * 3;
+
+	for (; xa < xb; xa++, p += 3) {
+		p[0] = r->rgb[0];
+		p[1] = r->rgb[1];
+		p[2] = r->rgb[2];
+	}
+}
+
+// line of r->lw pixels width, tile coordinates
+static void
+ras_line (struct raster *r, double x1, double y1, double x2, double y2)
+{
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	double t;
+	int i, k, a, b, off = (r->lw - 1) / 2;
+
+	if (fabs (dx) >= fabs (dy)) {	// x major, one column of lw pixels per x
+		if (x1 > x2) {
+			t = x1, x1 = x2, x2 = t;
+			t = y1, y1 = y2, y2 = t;
+		}
+		a = ras_pixel (x1, -1, r->w);
+		b = ras_pixel (x2, -1, r->w);
+		for (i = a < 0 ? 0 : a; i < b && i < r->w; i++) {
+			int y = (int) floor (y1 + (i + 0.5 - x1) * (dy / dx)) - off;
+
+			for (k = 0; k < r->lw; k++)
+				ras_dot (r, i, y + k);
+		}
+	}
+	else {			// y major, one row of lw pixels per y
+		if (y1 > y2) {
+			t = x1, x1 = x2, x2 = t;
+			t = y1, y1 = y2, y2 = t;
+		}
+		a = ras_pixel (y1, -1, r->h);
+		b = ras_pixel (y2, -1, r->h);
+		for (i = a < 0 ? 0 : a; i < b && i < r->h; i++) {
+			int x = (int) floor (x1 + (i + 0.5 - y1) * (dx / dy)) - off;
+
+			for (k = 0; k < r->lw; k++)
+				ras_dot (r, x + k, i);
+		}
+	}
+}
+
+// filled polygon (even-odd), tile coordinates
+static void
+ras_poly (struct raster *r, int n, const double *xy)
+{
+	double xs[RAS_MAX_POLY];
+	double ymin, ymax;
+	int i, j, k, nx, y, ya, yb;
+
+	if (n < 3)
+		return;
+	ymin = ymax = xy[1];
+	for (i = 1; i < n; i++) {
+		ymin = fmin (ymin, xy[i * 2 + 1]);
+		ymax = fmax (ymax, xy[i * 2 + 1]);
+	}
+	ya = ras_pixel (ymin, 0, r->h);
+	yb = ras_pixel (ymax, 0, r->h);
+	for (y = ya; y < yb; y++) {
+		double yc = y + 0.5;
+
+		for (nx = 0, i = 0, j = n - 1; i < n; j = i++) {
+			double xa = xy[j * 2], ya = xy[j * 2 + 1];
+			double xb = xy[i * 2], yb = xy[i * 2 + 1];
+
+			if ((ya <= yc && yb > yc) || (yb <= yc && ya > yc))
+				xs[nx++] = xa + (yc - ya) * (xb - xa) / (yb - ya);
+		}
+		for (i = 1; i < nx; i++) {	// insertion sort, nx is small
+			double v = xs[i];
+
+			for (k = i; k > 0 && xs[k - 1] > v; k--)
+				xs[k] = xs[k - 1];
+			xs[k] = v;
+		}
+		for (i = 0; i + 1 < nx; i += 2)
+			ras_span (r, y, ras_pixel (xs[i], 0, r->w), ras_pixel (xs[i + 1], 0, r->w));
+	}
+}
+
+// polygon in model coordinates, filled or as an outline of r->lw pixels
+static void
+ras_polyi (struct raster *r, int n, const int *xy, int fill)
+{
+	double t[RAS_MAX_POLY * 2];
+	int i;
+
+	if (n <= 0)
+		return;
+	if (n > RAS_MAX_POLY)
+		n = RAS_MAX_POLY;
+	for (i = 0; i < n; i++) {
+		t[i * 2 + 0] = ras_x (r, xy[i * 2 + 0]);
+		t[i * 2 + 1] = ras_y (r, xy[i * 2 + 1]);
+	}
+	if (fill == GL_FILL) {
+		ras_poly (r, n, t);
+		return;
+	}
+	for (i = 0; i < n; i++)
+		ras_line (r, t[i * 2], t[i * 2 + 1], t[((i + 1) % n) * 2], t[((i + 1) % n) * 2 + 1]);
+}
+
+// closed outline of n points of any size, model coordinates
+static void
+ras_contour (struct raster *r, const int *xy, int n)
+{
+	int i, j;
+
+	for (i = 0, j = n - 1; i < n; j = i++)
+		ras_line (r, ras_x (r, xy[j * 2]), ras_y (r, xy[j * 2 + 1]), ras_x (r, xy[i * 2]), ras_y (r, xy[i * 2 + 1]));
+}
+
+// stroke_text() callback
+static void
+ras_text_line (void *arg, double x1, double y1, double x2, double y2)
+{
+	struct raster *r = arg;
+
+	ras_line (r, ras_x (r, x1), ras_y (r, y1), ras_x (r, x2), ras_y (r, y2));
+}
+
+// rasterize one object, with the same semantics as Render()
+static void
+ras_object (struct raster *r, struct object *o)
+{
+	int width = WIDTH;
+	int fill = POLYMODE;
+	int xy[(CIRCLE_STEPS + 1) * 2];
+	int ox[CIRCLE_STEPS + 1], oy[CIRCLE_STEPS + 1];
+	int ix[CIRCLE_STEPS + 1], iy[CIRCLE_STEPS + 1];
+	int i, n;
+
+	r->lw = width;
+	memcpy (r->rgb, o->rgb, sizeof (r->rgb));
+	switch (o->type) {
+	case TYPE_LINE:
+		if (line_quad (X1, Y1, X2, Y2, width, xy))
+			ras_polyi (r, 4, xy, GL_FILL);
+		else
+			ras_line (r, ras_x (r, X1), ras_y (r, Y1), ras_x (r, X2), ras_y (r, Y2));
+		break;
+	case TYPE_POINT:
+		ras_polyi (r, circle_points (X1, Y1, width / 2, CIRCLE_STEPS, xy), xy, fill);
+		break;
+	case TYPE_RECT:
+		xy[0] = X1, xy[1] = Y1;
+		xy[2] = X2, xy[3] = Y1;
+		xy[4] = X2, xy[5] = Y2;
+		xy[6] = X1, xy[7] = Y2;
+		ras_polyi (r, 4, xy, fill);
+		break;
+	case TYPE_TEXT:
+		if (text_lod (SCALE, r->zoom) != TEXT_GREEK)
+			stroke_text (X1, Y1, ROTATE, SCALE, TEXT, ras_text_line, r);
+		else if (SCALE * 0.6 * r->zoom < 1) {
+			text_bar (X1, Y1, ROTATE, SCALE, strlen (TEXT), xy);
+			r->lw = 1;
+			ras_text_line (r, xy[0], xy[1], xy[2], xy[3]);
+		} else {
+			text_bar (X1, Y1, ROTATE, SCALE, strlen (TEXT), xy);
+			ras_polyi (r, 4, xy, GL_FILL);
+		}
+		break;
+	case TYPE_TRIANGLE:
+		ras_polyi (r, 3, o->arg, fill);
+		break;
+	case TYPE_CIRCLE:
+		ras_polyi (r, circle_points (X1, Y1, RADIUS, CIRCLE_STEPS, xy), xy, fill);
+		break;
+	case TYPE_ARC:
+		n = arc_points (RADIUS, DSTART, DDELTA, arc_width (width), CIRCLE_STEPS, ox, oy, ix, iy);
+		for (i = 0; i < n; i++) {
+			xy[0] = X1 + ox[i], xy[1] = Y1 + oy[i];
+			xy[2] = X1 + ox[i + 1], xy[3] = Y1 + oy[i + 1];
+			xy[4] = X1 + ix[i + 1], xy[5] = Y1 + iy[i + 1];
+			xy[6] = X1 + ix[i], xy[7] = Y1 + iy[i];
+			ras_polyi (r, 4, xy, GL_FILL);
+		}
+		break;
+	case TYPE_POLYGON:
+		if (fill == GL_FILL) {
+			for (i = 0; i < POLY->ntri; i++)
+				ras_polyi (r, 3, POLY->tri + i * 6, GL_FILL);
+			break;
+		}
+		for (i = n = 0; i < POLY->ncontours; n += POLY->contour[i++])
+			ras_contour (r, POLY->xy + n * 2, POLY->contour[i]);
+		break;
+	}
+}
+
+// an object under a pixel: the pixel whose center it covers, if any, as ras_object() would
+static void
+ras_small (struct raster *r, struct object *o, double x0, double y0, double x1, double y1)
+{
+	double ax = ras_x (r, x0), bx = ras_x (r, x1), ay = ras_y (r, y1), by = ras_y (r, y0);
+	int px = ras_pixel (ax, -1, r->w), py = ras_pixel (ay, -1, r->h);
+	int inx = px + 0.5 < bx, iny = py + 0.5 < by;
+	int area = o->filled && o->type != TYPE_LINE && o->type != TYPE_ARC && o->type != TYPE_TEXT;
+
+	if (area ? !(inx && iny) : !(inx || iny))
+		return;		// a filled shape needs a center inside, a line one in its long direction
+	memcpy (r->rgb, o->rgb, sizeof (r->rgb));
+	ras_dot (r, inx ? px : (int) floor ((ax + bx) / 2), iny ? py : (int) floor ((ay + by) / 2));
+}
+
+// Text level of detail ---------------------------------------------------------------------
+//
+//      Text is drawn by its size on the screen: a bar over its extent when
+//      it is too small to read, textured quads from a glyph atlas when it
+//      is small, and strokes only when it is big enough for them to show.
+//      The full quality batches are rebuilt when the zoom changes enough
+//      to matter, see text_zoom().
+
+// build the glyph atlas by rasterizing the stroke font, one cell per character
+static void
+atlas_init (void)
+{
+	int w = ATLAS_COLS * ATLAS_CELL, h = ATLAS_ROWS * ATLAS_CELL * 2;
+	struct raster r = { must_zalloc (w * h * 3), 0, 0, w, h, ATLAS_CELL, 0, 0, {255, 255, 255}, 3 };	// heavy strokes survive minifying
+	unsigned char *alpha = must_malloc (w * h);
+	char s[2] = { 0, 0 };
+	int i;
+
+	// a cell is 1x2 model units (scale 1), the baseline a quarter up from its bottom
+	for (i = 1; i < ATLAS_COLS * ATLAS_ROWS; i++) {
+		s[0] = i;
+		stroke_text (i % ATLAS_COLS, -(i / ATLAS_COLS) * 2 - 1.5, 0, 1, s, ras_text_line, &r);
+	}
+	for (i = 0; i < w * h; i++)
+		alpha[i] = r.pix[i * 3];
+	glGenTextures (1, &Atlas);
+	glBindTexture (GL_TEXTURE_2D, Atlas);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	gluBuild2DMipmaps (GL_TEXTURE_2D, GL_ALPHA, w, h, GL_ALPHA, GL_UNSIGNED_BYTE, alpha);
+	glBindTexture (GL_TEXTURE_2D, 0);
+	free (alpha);
+	free (r.pix);
+}
+
+// text as one textured quad per character
+static void
+glAtlasText (int x, int y, int rot, int scale, int z, char *s)
+{
+	int i, c;
+
+	rec_push ();
+	rec_translatef ((float) x, (float) y, (float) z);
+	rec_rotatef ((float) rot);
+	rec_scalef ((float) scale, (float) scale, 1);
+	rec_polygon_mode (GL_FILL);
+	rec_texture (1);
+	rec_begin (GL_QUADS);
+	for (i = 0; s[i]; i++) {
+		float s0, s1, t0, t1;
+
+		if ((c = (unsigned char) s[i]) >= ATLAS_COLS * ATLAS_ROWS)
+			continue;
+		s0 = (float) (c % ATLAS_COLS) / ATLAS_COLS;
+		s1 = s0 + 1.0f / ATLAS_COLS;
+		t0 = (float) (c / ATLAS_COLS) / ATLAS_ROWS;
+		t1 = t0 + 1.0f / ATLAS_ROWS;
+		rec_texcoord2f (s0, t1);
+		rec_vertex2f (i, -0.5f);
+		rec_texcoord2f (s1, t1);
+		rec_vertex2f (i + 1, -0.5f);
+		rec_texcoord2f (s1, t0);
+		rec_vertex2f (i + 1, 1.5f);
+		rec_texcoord2f (s0, t0);
+		rec_vertex2f (i, 1.5f);
+	}
+	rec_end ();
+	rec_texture (0);
+	rec_polygon_mode (Fill);
+	rec_pop ();
+}
+
+// text, by its level of detail at the current zoom
+static void
+glTexti (int x, int y, int rot, int scale, int z, char *s)
+{
+	int q[8], i;
+
+	Text_count++;
+	switch (text_lod (scale, rec_zoom ())) {
+	case TEXT_GREEK:
+		text_bar (x, y, rot, scale, strlen (s), q);
+		if (scale * 0.6 * rec_zoom () < 1) {
+			rec_begin (GL_LINES);	// a polygon this thin may cover no pixel at all
+			rec_vertex3i (q[0], q[1], z);
+			rec_vertex3i (q[2], q[3], z);
+			rec_end ();
+			break;
+		}
+		rec_polygon_mode (GL_FILL);
+		rec_begin (GL_QUADS);
+		for (i = 0; i < 4; i++)
+			rec_vertex3i (q[i * 2], q[i * 2 + 1], z);
+		rec_end ();
+		rec_polygon_mode (Fill);
+		break;
+	case TEXT_ATLAS:
+		glAtlasText (x, y, rot, scale, z, s);
+		break;
+	default:
+		glPrintf (x, y, rot, scale, z, "%s", s);
+		break;
+	}
+}
+
+// the zoom step the text in a batch is drawn for at zoom, half an octave
+static inline int
+zoom_step (double zoom)
+{
+	return (int) floor (log2 (zoom) * 2);
+}
+
+// and at the current zoom
+static inline int
+text_zoom (void)
+{
+	return zoom_step (Zoom);
+}
+
+// OpenGL primitives ---------------------------------------------------------------------
+
+// outline of the area a Text object covers, drawn instead of it while moving
+static void
+glTextBoxi (int x, int y, int rot, int scale, int len, int z)
+{
+	glPushMatrix ();
+	glTranslatef ((float) x, (float) y, (float) z);
+	glRotatef ((float) rot, 0, 0, 1);
+	glBegin (GL_LINE_LOOP);
+	glVertex2i (0, 0);
+	glVertex2i (len * scale, 0);
+	glVertex2i (len * scale, scale);
+	glVertex2i (0, scale);
+	glEnd ();
+	glPopMatrix ();
+}
+
+static void
+glLinei (int x1, int y1, int x2, int y2, int width, int z)
+{
+	int q[8];
+
+	if (!line_quad (x1, y1, x2, y2, width, q)) {
+		rec_begin (GL_LINES);
+		rec_vertex3i (x1, y1, z);
+		rec_vertex3i (x2, y2, z);
+		rec_end ();
+		return;
+	}
+	rec_polygon_mode (GL_FILL);	// Lines are always filled
+	rec_begin (GL_QUADS);
+	rec_vertex3i (q[0], q[1], z);
+	rec_vertex3i (q[2], q[3], z);
+	rec_vertex3i (q[4], q[5], z);
+	rec_vertex3i (q[6], q[7], z);
+	rec_end ();
+	rec_polygon_mode (Fill);
+}
+
+static void
+glArci (int x, int y, int radius, int dstart, int ddelta, int z)
+{
+	int arcx_outer[CIRCLE_STEPS + 1];
+	int arcy_outer[CIRCLE_STEPS + 1];
+	int arcx_inner[CIRCLE_STEPS + 1];
+	int arcy_inner[CIRCLE_STEPS + 1];
+	int step = arc_points (radius, dstart, ddelta, arc_width (Width), Circle_steps, arcx_outer, arcy_outer, arcx_inner, arcy_inner);
+	int i;
+
+	rec_polygon_mode (GL_FILL);	// arcs are always filled
+	for (i = 0; i < step; i++) {
+		rec_begin (GL_POLYGON);
+		rec_vertex3i (x + arcx_outer[i + 0], y + arcy_outer[i + 0], z);
+		rec_vertex3i (x + arcx_outer[i + 1], y + arcy_outer[i + 1], z);
+		rec_vertex3i (x + arcx_inner[i + 1], y + arcy_inner[i + 1], z);
+		rec_vertex3i (x + arcx_inner[i + 0], y + arcy_inner[i + 0], z);
+		rec_end ();
+	}
+	rec_polygon_mode (Fill);
+}
+
+static void
+glCirclei (int x, int y, int radius, int z)
+{
+	int xy[(CIRCLE_STEPS + 1) * 2];
+	int i, n = circle_points (x, y, radius, Circle_steps, xy);
+
+	rec_begin (GL_POLYGON);
+	for (i = 0; i < n; i++)
+		rec_vertex3i (xy[i * 2 + 0], xy[i * 2 + 1], z);
+	rec_end ();
+}
+
+static void
+glTrianglei (int x1, int y1, int x2, int y2, int x3, int y3, int z)
+{
+	rec_begin (GL_TRIANGLES);
+	rec_vertex3i (x1, y1, z);
+	rec_vertex3i (x2, y2, z);
+	rec_vertex3i (x3, y3, z);
+	rec_end ();
+}
+
+// a Polygon's triangles, or its contours when it's not filled
+static void
+glPolygoni (struct polygon *p, int filled, int z)
+{
+	int i, j, k = 0;
+
+	if (filled) {
+		rec_begin (GL_TRIANGLES);
+		for (i = 0; i < p->ntri * 3; i++)
+			rec_vertex3i (p->tri[i * 2 + 0], p->tri[i * 2 + 1], z);
+		rec_end ();
+		return;
+	}
+	for (i = 0; i < p->ncontours; i++) {
+		rec_begin (GL_LINE_LOOP);
+		for (j = 0; j < p->contour[i]; j++, k++)
+			rec_vertex3i (p->xy[k * 2 + 0], p->xy[k * 2 + 1], z);
+		rec_end ();
+	}
+}
+
+static void
+my_glRecti (int x1, int y1, int x2, int y2, int z)
+{
+	rec_begin (GL_POLYGON);
+	rec_vertex3i (x1, y1, z);
+	rec_vertex3i (x2, y1, z);
+	rec_vertex3i (x2, y2, z);
+	rec_vertex3i (x1, y2, z);
+	rec_end ();
+}
+
+
+// set up the GL drawing state for o, where it differs from the previous object drawn
+static inline void
+render_state (struct object *o, struct object *prev)
+{
+	if (prev == NULL || prev->width != WIDTH) {
+		rec_width ((float) WIDTH);
+		Width = WIDTH;
+	}
+	if (prev == NULL || memcmp (prev->rgb, o->rgb, sizeof (o->rgb)) != 0)
+		rec_color3ubv (o->rgb);
+	if (prev == NULL || prev->filled != FILLED) {
+		Fill = POLYMODE;
+		rec_polygon_mode (Fill);
+	}
+}
+
+static void
+render_object (struct object *o)
+{
+	switch (o->type) {
+	case TYPE_LINE:
+		glLinei (X1, Y1, X2, Y2, Width, ltoz (LAYER));
+		break;
+	case TYPE_POINT:
+		glCirclei (X1, Y1, Width / 2, ltoz (LAYER));
+		break;
+	case TYPE_RECT:
+		my_glRecti (X1, Y1, X2, Y2, ltoz (LAYER));
+		break;
+	case TYPE_TEXT:
+		if (Declutter)
+			break;	// see labels_draw()
+		if (Interacting && Rec == NULL)
+			glTextBoxi (X1, Y1, ROTATE, SCALE, strlen (TEXT), ltoz (LAYER));
+		else
+			glTexti (X1, Y1, ROTATE, SCALE, ltoz (LAYER), TEXT);
+		break;
+	case TYPE_TRIANGLE:
+		glTrianglei (X1, Y1, X2, Y2, X3, Y3, ltoz (LAYER));
+		break;
+	case TYPE_CIRCLE:
+		glCirclei (X1, Y1, RADIUS, ltoz (LAYER));
+		break;
+	case TYPE_ARC:
+		glArci (X1, Y1, RADIUS, DSTART, DDELTA, ltoz (LAYER));
+		break;
+	case TYPE_POLYGON:
+		glPolygoni (POLY, FILLED, ltoz (LAYER));
+		break;
+	}
+}
+
+// draw every 'decimate'th object of a layer
+static void
+render_objects (struct layer *L, int decimate)
+{
+	struct object *o, *prev = NULL;
+	struct cursor c;
+	int i = 0;
+
+	OBJECT_SCAN (L, c, o) {
+		if (i++ % decimate != 0)
+			continue;
+		render_state (o, prev);
+		render_object (o);
+		prev = o;
+	}
+}
+
+// compile a layer into a render batch while drawing it
+static void
+render_batch (struct layer *L, GLuint * list, int decimate)
+{
+	if (*list == 0 && (*list = glGenLists (1)) == 0) {
+		render_objects (L, decimate);	// out of display lists, draw directly
+		return;
+	}
+	glNewList (*list, GL_COMPILE_AND_EXECUTE);
+	render_objects (L, decimate);
+	glEndList ();
+}
+
+// Analytic shader primitives ---------------------------------------------------------
+//
+//      Circles, points, arcs and wide lines can be drawn as one instanced
+//      quad each, with a fragment shader that tests every pixel against
+//      the exact shape: disc, ring, annulus sector or the line's rectangle
+//      (square ends when axis aligned, like glLinei(), not round caps).  Edges are exact at
+//      any zoom and each object costs four vertices.  Other objects keep
+//      using display lists; a layer is split into runs of each kind so the
+//      drawing order is unchanged.
+
+#define	KIND_DISC	0	// filled circle
+#define	KIND_RING	1	// circle outline, Width pixels wide
+#define	KIND_ARC	2
+#define	KIND_LINE	3	// wide line
+#define	KIND_NONE	-1	// drawn the classic way
+
+#define	ATTR_CORNER	0
+#define	ATTR_P		1
+#define	ATTR_Q		2
+#define	ATTR_ZK		3
+#define	ATTR_COLOR	4
+
+// a run of objects drawn with the shader (count > 0) or a display list
+struct run
+{
+	int first;		// first instance
+	int count;		// number of instances
+	GLuint list;
+};
+
+// per instance attributes
+struct instance
+{
+	GLfloat p[4];		// disc/ring/arc: x y radius arcwidth, line: x1 y1 x2 y2
+	GLfloat q[4];		// ring: pixels, arc: start end (radians), line: half width, end extension
+	GLfloat zk[2];		// z, kind
+	GLubyte rgba[4];
+};
+
+static const char *Vertex_shader =
+	"#version 130\n"
+	"in vec2 a_corner;\n"
+	"in vec4 a_p;\n"
+	"in vec4 a_q;\n"
+	"in vec2 a_zk;\n"
+	"in vec4 a_color;\n"
+	"uniform float u_pixel;\n"
+	"out vec2 v_rel;\n"
+	"flat out vec4 v_p;\n"
+	"flat out vec4 v_q;\n"
+	"flat out float v_kind;\n"
+	"flat out vec4 v_color;\n"
+	"void main ()\n"
+	"{\n"
+	"	float m = 2.0 * u_pixel;\n"	// margin so edge pixels get fragments
+	"	vec2 origin = a_p.xy;\n"
+	"	if (a_zk.y < 2.5) {\n"	// box around the center
+	"		float r = a_p.z + (a_zk.y > 1.5 ? 0.5 * a_p.w : 0.5 * a_q.x * u_pixel) + m;\n"
+	"		v_rel = a_corner * r;\n"
+	"	} else {\n"		// box along the line
+	"		vec2 d = a_p.zw - a_p.xy;\n"
+	"		float len = length (d);\n"
+	"		vec2 u = len > 0.0 ? d / len : vec2 (1.0, 0.0);\n"
+	"		vec2 n = vec2 (-u.y, u.x);\n"
+	"		float ext = a_q.y + m;\n"
+	"		v_rel = (a_corner.x < 0.0 ? -u * ext : d + u * ext) + n * a_corner.y * (a_q.x + m);\n"
+	"	}\n"
+	"	v_p = a_p;\n"
+	"	v_q = a_q;\n"
+	"	v_kind = a_zk.y;\n"
+	"	v_color = a_color;\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4 (origin + v_rel, a_zk.x, 1.0);\n"
+	"}\n";
+
+static const char *Fragment_shader =
+	"#version 130\n"
+	"uniform float u_pixel;\n"
+	"in vec2 v_rel;\n"
+	"flat in vec4 v_p;\n"
+	"flat in vec4 v_q;\n"
+	"flat in float v_kind;\n"
+	"flat in vec4 v_color;\n"
+	"void main ()\n"
+	"{\n"
+	"	vec2 p = v_rel;\n"
+	"	float d;\n"
+	"	if (v_kind < 0.5)\n"
+	"		d = length (p) - v_p.z;\n"
+	"	else if (v_kind < 1.5)\n"
+	"		d = abs (length (p) - v_p.z) - 0.5 * v_q.x * u_pixel;\n"
+	"	else if (v_kind < 2.5) {\n"	// angles run clockwise from +y, as in arc_points()
+	"		d = abs (length (p) - v_p.z) - 0.5 * v_p.w;\n"
+	"		if (mod (atan (p.x, p.y) - v_q.x, 6.28318530718) > v_q.y - v_q.x)\n"
+	"			discard;\n"
+	"	} else {\n"
+	"		vec2 s = v_p.zw - v_p.xy;\n"
+	"		float len = length (s);\n"
+	"		vec2 u = len > 0.0 ? s / len : vec2 (1.0, 0.0);\n"
+	"		float t = dot (p, u);\n"
+	"		d = max (abs (dot (p, vec2 (-u.y, u.x))) - v_q.x, max (-v_q.y - t, t - len - v_q.y));\n"
+	"	}\n"
+	"	if (d > 0.0)\n"
+	"		discard;\n"
+	"	gl_FragColor = v_color;\n"
+	"}\n";
+
+static GLuint
+shader_compile (GLenum type, const char *source)
+{
+	GLuint shader = glCreateShader (type);
+	GLint ok;
+	char log[1024];
+
+	glShaderSource (shader, 1, &source, NULL);
+	glCompileShader (shader);
+	glGetShaderiv (shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		glGetShaderInfoLog (shader, sizeof (log), NULL, log);
+		error ("Shader: %s", log);
+		glDeleteShader (shader);
+		return 0;
+	}
+	return shader;
+}
+
+// set up the shader program, returns 0 (and the classic path is used) if it can't be
+static int
+shaders_init (void)
+{
+	static const GLfloat corners[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+	const char *version = (const char *) glGetString (GL_VERSION);
+	int major = 0, minor = 0;
+	GLuint vs, fs;
+	GLint ok;
+
+	if (version == NULL || sscanf (version, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 33) {
+		error ("Shaders need OpenGL 3.3, this is %s", version ? version : "unknown");
+		return 0;
+	}
+	if ((vs = shader_compile (GL_VERTEX_SHADER, Vertex_shader)) == 0)
+		return 0;
+	if ((fs = shader_compile (GL_FRAGMENT_SHADER, Fragment_shader)) == 0)
+		return 0;
+	Shader_program = glCreateProgram ();
+	glAttachShader (Shader_program, vs);
+	glAttachShader (Shader_program, fs);
+	glBindAttribLocation (Shader_program, ATTR_CORNER, "a_corner");
+	glBindAttribLocation (Shader_program, ATTR_P, "a_p");
+	glBindAttribLocation (Shader_program, ATTR_Q, "a_q");
+	glBindAttribLocation (Shader_program, ATTR_ZK, "a_zk");
+	glBindAttribLocation (Shader_program, ATTR_COLOR, "a_color");
+	glLinkProgram (Shader_program);
+	glDeleteShader (vs);
+	glDeleteShader (fs);
+	glGetProgramiv (Shader_program, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		error ("Shader program doesn't link");
+		glDeleteProgram (Shader_program);
+		return Shader_program = 0;
+	}
+	Shader_pixel = glGetUniformLocation (Shader_program, "u_pixel");
+	glGenBuffers (1, &Corner_vbo);
+	glBindBuffer (GL_ARRAY_BUFFER, Corner_vbo);
+	glBufferData (GL_ARRAY_BUFFER, sizeof (corners), corners, GL_STATIC_DRAW);
+	glBindBuffer (GL_ARRAY_BUFFER, 0);
+	return 1;
+}
+
+// fill in the shader instance for o, returns its kind
+static int
+instance_of (struct object *o, struct instance *in)
+{
+	double start, delta;
+
+	memset (in, 0, sizeof (*in));
+	in->p[0] = X1;
+	in->p[1] = Y1;
+	in->zk[0] = ltoz (LAYER);
+	memcpy (in->rgba, o->rgb, sizeof (o->rgb));
+	in->rgba[3] = 255;
+	switch (o->type) {
+	case TYPE_POINT:
+		if (WIDTH / 2 <= 0)
+			return KIND_NONE;
+		in->p[2] = WIDTH / 2;
+		in->q[0] = WIDTH;
+		return in->zk[1] = FILLED ? KIND_DISC : KIND_RING;
+	case TYPE_CIRCLE:
+		in->p[2] = RADIUS;
+		in->q[0] = WIDTH;
+		return in->zk[1] = FILLED ? KIND_DISC : KIND_RING;
+	case TYPE_ARC:		// arcs and wide lines are filled whatever Fill/Wire says, as in glArci() and glLinei()
+		start = dtor ((DSTART - 90) % 360);
+		delta = dtor (DDELTA);
+		if (delta < 0)
+			start += delta, delta = -delta;
+		in->p[2] = RADIUS;
+		in->p[3] = arc_width (WIDTH) / 2 * 2;	// arc_points() uses w/2 each side
+		in->q[0] = start;
+		in->q[1] = start + delta;
+		return in->zk[1] = KIND_ARC;
+	case TYPE_LINE:
+		if (WIDTH / 2 <= 0)
+			return KIND_NONE;	// thin lines are GL lines
+		in->p[2] = X2;
+		in->p[3] = Y2;
+		in->q[0] = WIDTH / 2;
+		in->q[1] = (X1 == X2 || Y1 == Y2) ? WIDTH / 2 : 0;	// square ends when axis aligned
+		return in->zk[1] = KIND_LINE;
+	}
+	return KIND_NONE;
+}
+
+// split a layer into shader and display list runs, and upload its instances
+static void
+shader_batch (struct layer *L)
+{
+	struct instance *in = must_malloc ((L->n + 1) * sizeof (*in));
+	struct object *o, *prev = NULL;
+	struct cursor c;
+	struct run *r = NULL;
+	int ni = 0, maxruns = 16, kind;
+
+	L->runs = must_malloc (maxruns * sizeof (*L->runs));
+	L->nruns = 0;
+	OBJECT_SCAN (L, c, o) {
+		kind = instance_of (o, &in[ni]);
+		if (r == NULL || (kind == KIND_NONE) != (r->count == 0)) {	// start a run
+			if (r != NULL && r->count == 0)
+				glEndList ();
+			if (L->nruns == maxruns && (L->runs = realloc (L->runs, (maxruns *= 2) * sizeof (*L->runs))) == NULL)
+				fatal ("Can't grow layer %d runs", L->number);
+			r = &L->runs[L->nruns++];
+			r->first = ni;
+			r->count = 0;
+			r->list = 0;
+			if (kind == KIND_NONE) {
+				r->list = glGenLists (1);
+				glNewList (r->list, GL_COMPILE);
+				prev = NULL;
+			}
+		}
+		if (kind != KIND_NONE) {
+			ni++;
+			r->count++;
+			continue;
+		}
+		render_state (o, prev);
+		render_object (o);
+		prev = o;
+	}
+	if (r != NULL && r->count == 0)
+		glEndList ();
+	glGenBuffers (1, &L->vbo);
+	glBindBuffer (GL_ARRAY_BUFFER, L->vbo);
+	glBufferData (GL_ARRAY_BUFFER, ni * sizeof (*in), in, GL_STATIC_DRAW);
+	glBindBuffer (GL_ARRAY_BUFFER, 0);
+	free (in);
+}
+
+// free a layer's shader batch
+static void
+shader_free (struct layer *L)
+{
+	int i;
+
+	for (i = 0; i < L->nruns; i++)
+		if (L->runs[i].list != 0)
+			glDeleteLists (L->runs[i].list, 1);
+	free (L->runs);
+	L->runs = NULL;
+	L->nruns = 0;
+	glDeleteBuffers (1, &L->vbo);
+	L->vbo = 0;
+}
+
+// draw a layer from its shader batch
+static void
+shader_layer (struct layer *L)
+{
+	struct run *r;
+	size_t stride = sizeof (struct instance);
+
+	if (L->runs == NULL)
+		shader_batch (L);
+	for (r = L->runs; r < L->runs + L->nruns; r++) {
+		if (r->count == 0) {
+			glCallList (r->list);
+			continue;
+		}
+		glUseProgram (Shader_program);
+		glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);	// the shader draws outlines itself, the quad is always covered
+		glUniform1f (Shader_pixel, 1.0 / Zoom);
+		glBindBuffer (GL_ARRAY_BUFFER, Corner_vbo);
+		glEnableVertexAttribArray (ATTR_CORNER);
+		glVertexAttribPointer (ATTR_CORNER, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glBindBuffer (GL_ARRAY_BUFFER, L->vbo);
+		glEnableVertexAttribArray (ATTR_P);
+		glEnableVertexAttribArray (ATTR_Q);
+		glEnableVertexAttribArray (ATTR_ZK);
+		glEnableVertexAttribArray (ATTR_COLOR);
+		glVertexAttribPointer (ATTR_P, 4, GL_FLOAT, GL_FALSE, stride, (void *) (r->first * stride + offsetof (struct instance, p)));
+		glVertexAttribPointer (ATTR_Q, 4, GL_FLOAT, GL_FALSE, stride, (void *) (r->first * stride + offsetof (struct instance, q)));
+		glVertexAttribPointer (ATTR_ZK, 2, GL_FLOAT, GL_FALSE, stride, (void *) (r->first * stride + offsetof (struct instance, zk)));
+		glVertexAttribPointer (ATTR_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *) (r->first * stride + offsetof (struct instance, rgba)));
+		glVertexAttribDivisor (ATTR_P, 1);
+		glVertexAttribDivisor (ATTR_Q, 1);
+		glVertexAttribDivisor (ATTR_ZK, 1);
+		glVertexAttribDivisor (ATTR_COLOR, 1);
+		glDrawArraysInstanced (GL_TRIANGLE_STRIP, 0, 4, r->count);
+		glDisableVertexAttribArray (ATTR_CORNER);
+		glDisableVertexAttribArray (ATTR_P);
+		glDisableVertexAttribArray (ATTR_Q);
+		glDisableVertexAttribArray (ATTR_ZK);
+		glDisableVertexAttribArray (ATTR_COLOR);
+		glBindBuffer (GL_ARRAY_BUFFER, 0);
+		glUseProgram (0);
+		glPolygonMode (GL_FRONT_AND_BACK, Fill);
+	}
+}
+
+// build a segment's batch for the current frame, while drawing it
+static void
+segment_batch (struct layer *L, struct segment *g)
+{
+	struct object *o, *prev = NULL;
+	int i, d;
+
+	if (g->list == 0 && (g->list = glGenLists (1)) == 0)
+		fatal ("Out of display lists");
+	g->lo = g->born;
+	g->hi = INT_MAX;
+	Text_count = 0;
+	glNewList (g->list, GL_COMPILE_AND_EXECUTE);
+	for (i = g->first; i < (g + 1)->first; i++) {
+		if ((d = L->died[i]) <= Frame_now) {
+			g->lo = d > g->lo ? d : g->lo;
+			continue;
+		}
+		g->hi = d < g->hi ? d : g->hi;
+		o = &L->obj[i];
+		render_state (o, prev);
+		render_object (o);
+		prev = o;
+	}
+	glEndList ();
+	g->texts = Text_count;
+	g->text_zoom = text_zoom ();
+}
+
+// draw a layer of an animation, rebuilding only the segments that changed
+static void
+frames_layer (struct layer *L)
+{
+	struct segment *g;
+
+	for (g = L->seg; g < L->seg + L->nseg && g->born <= Frame_now; g++) {
+		if (g->list == 0 || Frame_now < g->lo || Frame_now >= g->hi || (g->texts > 0 && g->text_zoom != text_zoom ()))
+			segment_batch (L, g);
+		else
+			glCallList (g->list);
+	}
+}
+
+// Parallel tessellation --------------------------------------------------------------------
+//
+//      Full quality chunks are recorded (see rec_begin()) by a pool of
+//      worker threads, and the render thread compiles each chunk's display
+//      list by playing its recording back, so rebuilding the batches after
+//      a zoom step uses every core.  Jobs go in a ring the render thread
+//      adds to, and whichever thread is free takes the next with a compare
+//      and swap.  A recording is published by setting its job's state, so
+//      neither side takes a lock (the mutex is only for sleeping when
+//      there is nothing to do).  A progressive frame draws the chunks that
+//      are ready and comes back for the rest; otherwise the render thread
+//      does jobs itself while it waits.
+
+#define	RECORD_QUEUE	4096	// jobs waiting, at most
+#define	RECORD_IDLE	0
+#define	RECORD_QUEUED	1
+#define	RECORD_DONE	2
+
+struct record_job
+{
+	struct layer *L;
+	int k;			// the chunk
+	int state;
+	unsigned int gen;	// L->record_gen when it was queued
+	double zoom;
+	int circle_steps;
+	struct recording *rec;	// once state is RECORD_DONE
+};
+
+struct recorder
+{
+	int nthreads;		// workers, 0 before they're started
+	pthread_t thread[MAX_THREADS];
+	struct record_job *job[RECORD_QUEUE];
+	unsigned int head;	// next job to take
+	unsigned int tail;	// and to add
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+} Recorder = {.lock = PTHREAD_MUTEX_INITIALIZER,.wake = PTHREAD_COND_INITIALIZER };
+
+static void
+free_recording (struct recording *R)
+{
+	if (R != NULL)
+		free (R->op);
+	free (R);
+}
+
+// record chunk j->k of j->L
+static void
+record_run (struct record_job *j)
+{
+	struct recording *R = must_zalloc (sizeof (*R));
+	struct object *o, *prev = NULL;
+	struct cursor c = {.next = j->L->chunk[j->k],.k = 0 };
+	int i, width = Width, fill = Fill, steps = Circle_steps, texts = Text_count;	// the render thread's, when it helps
+
+	R->zoom = j->zoom;
+	Circle_steps = j->circle_steps;
+	Text_count = 0;
+	Rec = R;
+	for (i = 0; i < LAYER_CHUNK && (o = object_next (j->L, &c)) != NULL; i++) {
+		render_state (o, prev);
+		render_object (o);
+		prev = o;
+	}
+	Rec = NULL;
+	R->texts = Text_count;
+	Width = width, Fill = fill, Circle_steps = steps, Text_count = texts;
+	j->rec = R;
+	__atomic_store_n (&j->state, RECORD_DONE, __ATOMIC_RELEASE);
+}
+
+// do the next job, returns 0 if there's none
+static int
+record_take (void)
+{
+	unsigned int h = __atomic_load_n (&Recorder.head, __ATOMIC_ACQUIRE);
+	struct record_job *j;
+
+	do {
+		if (h == __atomic_load_n (&Recorder.tail, __ATOMIC_ACQUIRE))
+			return 0;
+		j = Recorder.job[h % RECORD_QUEUE];	// before taking it, when its slot can't be reused yet
+	} while (!__atomic_compare_exchange_n (&Recorder.head, &h, h + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	record_run (j);
+	return 1;
+}
+
+static void *
+record_worker (void *arg)
+{
+	(void) arg;
+	for (;;) {
+		while (record_take ())
+			continue;
+		pthread_mutex_lock (&Recorder.lock);
+		while (__atomic_load_n (&Recorder.head, __ATOMIC_ACQUIRE) == __atomic_load_n (&Recorder.tail, __ATOMIC_ACQUIRE))
+			pthread_cond_wait (&Recorder.wake, &Recorder.lock);
+		pthread_mutex_unlock (&Recorder.lock);
+	}
+	return NULL;
+}
+
+// queue chunk k of L to be recorded at the current zoom, returns 0 if the ring is full
+static int
+record_queue (struct layer *L, int k)
+{
+	struct record_job *j = &L->record[k];
+	unsigned int t = Recorder.tail;
+
+	if (t - __atomic_load_n (&Recorder.head, __ATOMIC_ACQUIRE) >= RECORD_QUEUE)
+		return 0;
+	if (j->state == RECORD_DONE)	// out of date
+		free_recording (j->rec);
+	j->L = L;
+	j->k = k;
+	j->gen = L->record_gen;
+	j->zoom = Zoom;
+	j->circle_steps = Circle_steps;
+	j->rec = NULL;
+	j->state = RECORD_QUEUED;
+	Recorder.job[t % RECORD_QUEUE] = j;
+	__atomic_store_n (&Recorder.tail, t + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// queue L's chunks that aren't built in L->full or being recorded, starting the workers the first time
+static void
+record_begin (struct layer *L)
+{
+	int k, queued = 0;
+
+	if (Recorder.nthreads == 0) {
+		if (nthreads () < 2 || Store.h != NULL)	// store tiles can be freed under a worker
+			return;
+		for (Recorder.nthreads = 0; Recorder.nthreads < nthreads () - 1; Recorder.nthreads++)
+			if (pthread_create (&Recorder.thread[Recorder.nthreads], NULL, record_worker, NULL) != 0)
+				fatal ("Can't create thread");
+	}
+	if (L->record == NULL)
+		L->record = must_zalloc (L->nchunk * sizeof (*L->record));
+	for (k = 0; k < L->nchunk; k++) {
+		if (L->full->built[k] || __atomic_load_n (&L->record[k].state, __ATOMIC_ACQUIRE) == RECORD_QUEUED || (L->record[k].state == RECORD_DONE && L->record[k].gen == L->record_gen))
+			continue;
+		if (!record_queue (L, k))
+			break;
+		queued++;
+	}
+	if (queued > 0) {
+		pthread_mutex_lock (&Recorder.lock);
+		pthread_cond_broadcast (&Recorder.wake);
+		pthread_mutex_unlock (&Recorder.lock);
+	}
+}
+
+// chunk k of L's recording, waiting for it (and helping) if wait is set; NULL if it's not ready or not queued
+static struct recording *
+record_result (struct layer *L, int k, int wait)
+{
+	struct record_job *j;
+	struct recording *R;
+
+	if (L->record == NULL)
+		return NULL;
+	j = &L->record[k];
+	for (;;) {
+		switch (__atomic_load_n (&j->state, __ATOMIC_ACQUIRE)) {
+		case RECORD_IDLE:
+			return NULL;
+		case RECORD_DONE:
+			if (j->gen != L->record_gen || (j->rec->texts > 0 && zoom_step (j->zoom) != text_zoom ())) {	// for an old batch, or another view's zoom
+				if (!record_queue (L, k)) {
+					free_recording (j->rec);
+					j->rec = NULL;
+					j->state = RECORD_IDLE;
+					return NULL;
+				}
+				break;
+			}
+			R = j->rec;
+			j->rec = NULL;
+			j->state = RECORD_IDLE;
+			return R;
+		}
+		if (!wait)
+			return NULL;
+		if (!record_take ())
+			sched_yield ();
+	}
+}
+
+// Occlusion culling ---------------------------------------------------------------
+//
+//      Big filled Rectangles and Triangles hide what earlier layers drew
+//      under them.  For each full quality frame a coverage grid of
+//      OCC_CELL pixel cells holds the last layer (in drawing order) with a
+//      shape covering all of the cell, the shape first shrunk by a pixel
+//      and the float rounding so that every pixel in the cell is painted.
+//      Each coarser level holds the least of four cells below.  Chunks of
+//      a layer (and objects, in the software renderer) that are covered by
+//      later layers everywhere they could draw are skipped, so the frame
+//      is the same.  Occluders are found at load, the biggest OCC_MAX of
+//      each layer, and used when they're at least two cells across on the
+//      screen.  It's off for rotated views, frames, shaders, and layers
+//      that may be heatmaps.
+
+#define	OCC_CELL	8	// pixels
+#define	OCC_LEVELS	16
+#define	OCC_MAX		4096	// occluders kept per layer
+
+struct occluder
+{
+	int n;			// 2 for a Rectangle's corners, 3 for a Triangle
+	int xy[6];
+	double size;		// smallest width
+};
+
+struct occlusion
+{
+	int on;			// there's a grid for this view
+	int any;		// and something in it
+	int levels;
+	int w[OCC_LEVELS], h[OCC_LEVELS];	// size of each level in cells
+	int *cover[OCC_LEVELS];	// last Layer_order index covering each cell, -1 if none
+	int max;		// cells allocated for level 0
+	int *order;		// Layer_order index by layer number
+	double zoom, ox, oy;	// model coordinates of the top left corner
+} Occ;
+
+static int
+occ_cmp (const void *a, const void *b)
+{
+	double x = ((struct occluder *) a)->size, y = ((struct occluder *) b)->size;
+
+	return (x < y) - (x > y);	// biggest first
+}
+
+// find the occluders of every layer
+static void
+occ_init (void)
+{
+	struct occluder *O;
+	struct layer *L;
+	struct object *o;
+	struct cursor c;
+	double a, p;
+	int i, max;
+
+	if (Frame_count > 0)
+		return;
+	LAYER_WALK (i, L) {
+		max = 0;
+		OBJECT_SCAN (L, c, o) {
+			if (!o->filled || (o->type != TYPE_RECT && o->type != TYPE_TRIANGLE))
+				continue;
+			if (L->nocc >= max) {
+				if (max >= 2 * OCC_MAX) {	// keep the biggest
+					qsort (L->occ, L->nocc, sizeof (*L->occ), occ_cmp);
+					L->nocc = OCC_MAX;
+				}
+				else if ((L->occ = realloc (L->occ, (max = max * 2 + 64) * sizeof (*L->occ))) == NULL)
+					fatal ("Can't allocate %d occluders", max);
+			}
+			O = &L->occ[L->nocc];
+			memcpy (O->xy, o->arg, sizeof (O->xy));
+			if (o->type == TYPE_RECT) {
+				O->n = 2;
+				O->size = fmin (fabs ((double) X2 - X1), fabs ((double) Y2 - Y1));
+			}
+			else {
+				O->n = 3;
+				a = fabs (((double) X2 - X1) * ((double) Y3 - Y1) - ((double) X3 - X1) * ((double) Y2 - Y1)) / 2;
+				p = hypot ((double) X2 - X1, (double) Y2 - Y1) + hypot ((double) X3 - X2, (double) Y3 - Y2) + hypot ((double) X1 - X3, (double) Y1 - Y3);
+				O->size = p > 0 ? 4 * a / p : 0;	// the inscribed circle
+			}
+			if (O->size > 0)
+				L->nocc++;
+		}
+		qsort (L->occ, L->nocc, sizeof (*L->occ), occ_cmp);
+		if (L->nocc > OCC_MAX)
+			L->nocc = OCC_MAX;
+	}
+}
+
+// mark the cells O covers as covered by layer q
+static void
+occ_cover (struct occlusion *g, struct occluder *O, int q)
+{
+	double x[3], y[3], e[3][3], m, d, big = 0;
+	int i, k, cx0, cy0, cx1, cy1, cx, cy;
+
+	for (i = 0; i < O->n; i++) {
+		x[i] = (O->xy[i * 2] - g->ox) * g->zoom;
+		y[i] = (g->oy - O->xy[i * 2 + 1]) * g->zoom;
+		big = fmax (big, fmax (fabs ((double) O->xy[i * 2]), fabs ((double) O->xy[i * 2 + 1])));
+	}
+	m = 1 + (big + fabs (g->ox) + fabs (g->oy)) * g->zoom * 1e-6;	// a pixel, and the float rounding
+	if (O->n == 2) {
+		cx0 = (int) ceil ((fmin (x[0], x[1]) + m) / OCC_CELL);
+		cx1 = (int) floor ((fmax (x[0], x[1]) - m) / OCC_CELL) - 1;
+		cy0 = (int) ceil ((fmin (y[0], y[1]) + m) / OCC_CELL);
+		cy1 = (int) floor ((fmax (y[0], y[1]) - m) / OCC_CELL) - 1;
+	}
+	else {
+		cx0 = (int) floor (fmin (x[0], fmin (x[1], x[2])) / OCC_CELL);
+		cx1 = (int) floor (fmax (x[0], fmax (x[1], x[2])) / OCC_CELL);
+		cy0 = (int) floor (fmin (y[0], fmin (y[1], y[2])) / OCC_CELL);
+		cy1 = (int) floor (fmax (y[0], fmax (y[1], y[2])) / OCC_CELL);
+		d = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]) > 0 ? 1 : -1;
+		for (i = 0; i < 3; i++) {	// edge i as a*x + b*y + c, the distance inside
+			k = (i + 1) % 3;
+			e[i][0] = d * (y[i] - y[k]);
+			e[i][1] = d * (x[k] - x[i]);
+			e[i][2] = hypot (e[i][0], e[i][1]);
+			if (e[i][2] == 0)
+				return;
+			e[i][0] /= e[i][2];
+			e[i][1] /= e[i][2];
+			e[i][2] = -(e[i][0] * x[i] + e[i][1] * y[i]);
+		}
+	}
+	cx0 = cx0 < 0 ? 0 : cx0;
+	cy0 = cy0 < 0 ? 0 : cy0;
+	cx1 = cx1 >= g->w[0] ? g->w[0] - 1 : cx1;
+	cy1 = cy1 >= g->h[0] ? g->h[0] - 1 : cy1;
+	for (cy = cy0; cy <= cy1; cy++)
+		for (cx = cx0; cx <= cx1; cx++) {
+			if (O->n == 3)	// all four corners inside every edge
+				for (i = 0; i < 3; i++)
+					for (k = 0; k < 4; k++)
+						if (e[i][0] * (cx + (k & 1)) * OCC_CELL + e[i][1] * (cy + (k >> 1)) * OCC_CELL + e[i][2] < m)
+							goto next;
+			g->cover[0][cy * g->w[0] + cx] = q;
+			g->any = 1;
+		      next:;
+		}
+}
+
+// make the coverage grid for a w x h pixel view at zoom, (ox,oy) at its top left
+static void
+occ_build (struct occlusion *g, int w, int h, double zoom, double ox, double oy, int gl)
+{
+	struct layer *L;
+	int i, k, l, x, y, a, b, *up, *down;
+
+	g->on = g->any = 0;
+	if (g->order == NULL)
+		g->order = must_malloc ((MAX_LAYERS + 1) * sizeof (int));
+	LAYER_WALK (i, L)
+		g->order[L->number] = i;
+	if (Frame_count > 0 || (gl && ((Shaders && Shader_program != 0) || RotX != 0 || RotY != 0 || RotZ != 0)))
+		return;
+	g->zoom = zoom;
+	g->ox = ox;
+	g->oy = oy;
+	g->w[0] = (w + OCC_CELL - 1) / OCC_CELL;
+	g->h[0] = (h + OCC_CELL - 1) / OCC_CELL;
+	for (g->levels = 1; g->levels < OCC_LEVELS && (g->w[g->levels - 1] > 1 || g->h[g->levels - 1] > 1); g->levels++) {
+		g->w[g->levels] = (g->w[g->levels - 1] + 1) / 2;
+		g->h[g->levels] = (g->h[g->levels - 1] + 1) / 2;
+	}
+	if (g->w[0] * g->h[0] > g->max) {
+		g->max = g->w[0] * g->h[0];
+		for (l = 0; l < OCC_LEVELS; l++) {
+			free (g->cover[l]);
+			g->cover[l] = must_malloc ((g->max + 1) * sizeof (int));	// every level fits
+		}
+	}
+	for (i = 0; i < g->w[0] * g->h[0]; i++)
+		g->cover[0][i] = -1;
+	LAYER_WALK (i, L) {
+		if (!layer_visible (L->number) || (gl && Density && L->density))
+			continue;
+		for (k = 0; k < L->nocc && L->occ[k].size * zoom >= 2 * OCC_CELL; k++)
+			occ_cover (g, &L->occ[k], i);
+	}
+	for (l = 1; l < g->levels; l++) {
+		up = g->cover[l];
+		down = g->cover[l - 1];
+		for (y = 0; y < g->h[l]; y++)
+			for (x = 0; x < g->w[l]; x++) {
+				a = INT_MAX;
+				for (k = 0; k < 4; k++)
+					if (x * 2 + (k & 1) < g->w[l - 1] && y * 2 + (k >> 1) < g->h[l - 1]) {
+						b = down[(y * 2 + (k >> 1)) * g->w[l - 1] + x * 2 + (k & 1)];
+						a = b < a ? b : a;
+					}
+				up[y * g->w[l] + x] = a;
+			}
+	}
+	g->on = 1;
+}
+
+// are level 0 cells cx0..cx1, cy0..cy1 all covered after layer p? looked at from level l down
+static int
+occ_covered (struct occlusion *g, int l, int cx0, int cy0, int cx1, int cy1, int p)
+{
+	int x, y;
+
+	for (y = cy0 >> l; y <= cy1 >> l; y++)
+		for (x = cx0 >> l; x <= cx1 >> l; x++) {
+			if (g->cover[l][y * g->w[l] + x] > p)
+				continue;
+			if (l == 0 || !occ_covered (g, l - 1, x << l > cx0 ? x << l : cx0, y << l > cy0 ? y << l : cy0,
+						    ((x + 1) << l) - 1 < cx1 ? ((x + 1) << l) - 1 : cx1, ((y + 1) << l) - 1 < cy1 ? ((y + 1) << l) - 1 : cy1, p))
+				return 0;
+		}
+	return 1;
+}
+
+// is box b, drawn pad pixels bigger, hidden by layers after Layer_order index p?
+static int
+occ_hidden (struct occlusion *g, double b[4], double pad, int p)
+{
+	double x0 = (b[0] - g->ox) * g->zoom - pad, x1 = (b[2] - g->ox) * g->zoom + pad;
+	double y0 = (g->oy - b[3]) * g->zoom - pad, y1 = (g->oy - b[1]) * g->zoom + pad;
+	int cx0, cy0, cx1, cy1, l = 0;
+
+	if (!g->on || !g->any || b[0] > b[2])
+		return 0;
+	if (x1 < 0 || y1 < 0 || x0 >= g->w[0] * OCC_CELL || y0 >= g->h[0] * OCC_CELL)
+		return 0;	// off the view, for the view culling to decide
+	cx0 = x0 < 0 ? 0 : (int) (x0 / OCC_CELL);
+	cy0 = y0 < 0 ? 0 : (int) (y0 / OCC_CELL);
+	cx1 = x1 >= g->w[0] * OCC_CELL ? g->w[0] - 1 : (int) (x1 / OCC_CELL);
+	cy1 = y1 >= g->h[0] * OCC_CELL ? g->h[0] - 1 : (int) (y1 / OCC_CELL);
+	while (l < g->levels - 1 && ((cx1 >> l) - (cx0 >> l) > 1 || (cy1 >> l) - (cy0 >> l) > 1))
+		l++;
+	return occ_covered (g, l, cx0, cy0, cx1, cy1, p);
+}
+
+// is chunk k of L hidden in the window's view?
+static int
+occ_chunk (struct layer *L, int k)
+{
+	return Occ.on && L->chunk_box != NULL && occ_hidden (&Occ, L->chunk_box[k], L->chunk_width[k] + 2, Occ.order[L->number]);
+}
+
+// Density heatmaps ---------------------------------------------------------------
+//
+//      A --density layer that has more objects than pixels on screen is
+//      drawn as a heatmap instead: the center of every object is counted
+//      into a grid of DENSITY_CELL pixel cells, one grid per thread, the
+//      grids are summed, and the log of the counts is color mapped into a
+//      texture drawn as a single quad.  It's rebuilt when the view changes
+//      and costs one pass over the layer, with no GL calls per object.
+
+struct density
+{
+	struct layer *L;
+	int gw, gh;		// grid size
+	double zoom, panx, pany;
+	unsigned int *grid[MAX_THREADS];	// per thread counts
+	int nt;
+};
+
+// bounds of a layer's objects, and where its chunks start, and their bounds
+static void
+layer_chunks (struct layer *L)
+{
+	struct object *o;
+	struct cursor c;
+	double b[4], *B;
+	int i = 0, k;
+
+	L->ext[0] = L->ext[1] = HUGE_VAL;
+	L->ext[2] = L->ext[3] = -HUGE_VAL;
+	L->chunk = must_malloc ((L->n / LAYER_CHUNK + 1) * sizeof (*L->chunk));
+	L->chunk_box = must_malloc ((L->n / LAYER_CHUNK + 1) * sizeof (*L->chunk_box));
+	L->chunk_width = must_malloc ((L->n / LAYER_CHUNK + 1) * sizeof (*L->chunk_width));
+	OBJECT_SCAN (L, c, o) {
+		if (i++ % LAYER_CHUNK == 0) {
+			L->chunk[L->nchunk] = c.at;
+			L->chunk_box[L->nchunk][0] = L->chunk_box[L->nchunk][1] = HUGE_VAL;
+			L->chunk_box[L->nchunk][2] = L->chunk_box[L->nchunk][3] = -HUGE_VAL;
+			L->chunk_width[L->nchunk++] = 0;
+		}
+		B = L->chunk_box[L->nchunk - 1];
+		L->chunk_width[L->nchunk - 1] = WIDTH > L->chunk_width[L->nchunk - 1] ? WIDTH : L->chunk_width[L->nchunk - 1];
+		if (!object_extent (o, b))
+			continue;
+		for (k = 0; k < 2; k++) {
+			B[k] = fmin (B[k], b[k]);
+			B[k + 2] = fmax (B[k + 2], b[k + 2]);
+		}
+	}
+	for (k = 0; k < L->nchunk; k++) {
+		L->ext[0] = fmin (L->ext[0], L->chunk_box[k][0]);
+		L->ext[1] = fmin (L->ext[1], L->chunk_box[k][1]);
+		L->ext[2] = fmax (L->ext[2], L->chunk_box[k][2]);
+		L->ext[3] = fmax (L->ext[3], L->chunk_box[k][3]);
+	}
+}
+
+// does L have more objects than pixels in the view?
+static int
+density_wanted (struct layer *L)
+{
+	double x0 = -PanX, x1 = -PanX + Win_w / Zoom;
+	double y0 = -PanY - Win_h / Zoom, y1 = -PanY;
+	double area, shown;
+
+	if (L->chunk == NULL)
+		layer_chunks (L);
+	area = (L->ext[2] - L->ext[0]) * (L->ext[3] - L->ext[1]);
+	x0 = fmax (x0, L->ext[0]), x1 = fmin (x1, L->ext[2]);
+	y0 = fmax (y0, L->ext[1]), y1 = fmin (y1, L->ext[3]);
+	if (x0 > x1 || y0 > y1)
+		return 0;
+	shown = (x1 - x0) * (y1 - y0);
+	if (area <= 0 || shown <= 0)
+		return L->n > Win_w * Win_h * DENSITY_MIN;	// a line or a point, all of it on screen
+	return L->n * (shown / area) > shown * Zoom * Zoom * DENSITY_MIN;
+}
+
+// parallel_for() worker: count one chunk of objects into this thread's grid
+static void
+density_chunk (void *arg, int index, int thread)
+{
+	struct density *d = arg;
+	struct layer *L = d->L;
+	unsigned int *grid = d->grid[thread];
+	struct object *o;
+	struct cursor c = {.next = L->chunk[index],.k = 0 };
+	double b[4], k = d->zoom / DENSITY_CELL;
+	int i, x, y;
+
+	if (grid == NULL)
+		grid = d->grid[thread] = must_zalloc ((size_t) d->gw * d->gh * sizeof (*grid));
+	for (i = 0; i < LAYER_CHUNK && (o = object_next (L, &c)) != NULL; i++) {
+		if (!object_shown (L, c.at) || !object_extent (o, b))
+			continue;
+		x = (int) floor (((b[0] + b[2]) / 2 + d->panx) * k);
+		y = (int) floor ((-d->pany - (b[1] + b[3]) / 2) * k);
+		if (x >= 0 && y >= 0 && x < d->gw && y < d->gh)
+			grid[y * d->gw + x]++;
+	}
+}
+
+// parallel_for() worker: add the other threads' grids into the first, one row at a time
+static void
+density_sum (void *arg, int index, int thread)
+{
+	struct density *d = arg;
+	unsigned int *row = d->grid[0] + (size_t) index * d->gw;
+	int t, x;
+
+	(void) thread;
+	for (t = 1; t < d->nt; t++)
+		if (d->grid[t] != NULL)
+			for (x = 0; x < d->gw; x++)
+				row[x] += d->grid[t][(size_t) index * d->gw + x];
+}
+
+// color for a count, on a log scale up to max: transparent, then blue, red, yellow, white
+static void
+density_color (unsigned int n, double lmax, unsigned char *p)
+{
+	static const unsigned char ramp[5][3] = { {0, 0, 160}, {0, 80, 255}, {255, 0, 0}, {255, 220, 0}, {255, 255, 255} };
+	double t;
+	int i;
+
+	if (n == 0) {
+		p[0] = p[1] = p[2] = p[3] = 0;
+		return;
+	}
+	t = lmax > 0 ? log (n) / lmax * 4 : 0;
+	i = t >= 4 ? 3 : (int) t;
+	t -= i;
+	p[0] = ramp[i][0] + (ramp[i + 1][0] - ramp[i][0]) * t;
+	p[1] = ramp[i][1] + (ramp[i + 1][1] - ramp[i][1]) * t;
+	p[2] = ramp[i][2] + (ramp[i + 1][2] - ramp[i][2]) * t;
+	p[3] = 255;
+}
+
+// make L's heatmap texture for the current view
+static void
+density_build (struct layer *L)
+{
+	struct density d;
+	unsigned char *rgba;
+	unsigned int max = 0;
+	size_t i, n;
+
+	memset (&d, 0, sizeof (d));
+	d.L = L;
+	d.gw = (Win_w + DENSITY_CELL - 1) / DENSITY_CELL;
+	d.gh = (Win_h + DENSITY_CELL - 1) / DENSITY_CELL;
+	d.zoom = Zoom;
+	d.panx = PanX;
+	d.pany = PanY;
+	d.nt = nthreads ();
+	parallel_for (L->nchunk, density_chunk, &d);
+	if (d.grid[0] == NULL)
+		d.grid[0] = must_zalloc ((size_t) d.gw * d.gh * sizeof (*d.grid[0]));
+	parallel_for (d.gh, density_sum, &d);
+	n = (size_t) d.gw * d.gh;
+	for (i = 0; i < n; i++)
+		max = d.grid[0][i] > max ? d.grid[0][i] : max;
+	rgba = must_malloc (n * 4);
+	for (i = 0; i < n; i++)
+		density_color (d.grid[0][i], max > 1 ? log (max) : 0, rgba + i * 4);
+	if (L->heat[View_at] == 0)
+		glGenTextures (1, &L->heat[View_at]);
+	glBindTexture (GL_TEXTURE_2D, L->heat[View_at]);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, d.gw, d.gh, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	glBindTexture (GL_TEXTURE_2D, 0);
+	free (rgba);
+	for (i = 0; i < MAX_THREADS; i++)
+		free (d.grid[i]);
+	L->heat_view[View_at][0] = Zoom;
+	L->heat_view[View_at][1] = PanX;
+	L->heat_view[View_at][2] = PanY;
+	L->heat_view[View_at][3] = Win_w;
+	L->heat_view[View_at][4] = Win_h;
+	L->heat_frame[View_at] = Frame_now;
+}
+
+// draw L as a heatmap, a quad over the window in model coordinates
+static void
+density_layer (struct layer *L)
+{
+	double x0 = -PanX, y1 = -PanY;
+	double x1 = x0 + (double) (Win_w + DENSITY_CELL - 1) / DENSITY_CELL * DENSITY_CELL / Zoom;
+	double y0 = y1 - (double) (Win_h + DENSITY_CELL - 1) / DENSITY_CELL * DENSITY_CELL / Zoom;
+	double z = ltoz (L->number), *v = L->heat_view[View_at];
+
+	if (L->heat[View_at] == 0 || v[0] != Zoom || v[1] != PanX || v[2] != PanY || v[3] != Win_w || v[4] != Win_h || L->heat_frame[View_at] != Frame_now)
+		density_build (L);
+	glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
+	glColor3ub (255, 255, 255);
+	glEnable (GL_TEXTURE_2D);
+	glBindTexture (GL_TEXTURE_2D, L->heat[View_at]);
+	glBegin (GL_QUADS);
+	glTexCoord2f (0, 0);
+	glVertex3d (x0, y1, z);
+	glTexCoord2f (1, 0);
+	glVertex3d (x1, y1, z);
+	glTexCoord2f (1, 1);
+	glVertex3d (x1, y0, z);
+	glTexCoord2f (0, 1);
+	glVertex3d (x0, y0, z);
+	glEnd ();
+	glDisable (GL_TEXTURE_2D);
+	glPolygonMode (GL_FRONT_AND_BACK, Fill);
+}
+
+// throw away one of L's full quality batches
+static void
+batch_free (struct layer *L, struct batch *B)
+{
+	if (B->list != 0)
+		glDeleteLists (B->list, L->nchunk);
+	B->list = 0;
+	if (B->built != NULL)
+		memset (B->built, 0, L->nchunk);
+	B->nbuilt = 0;
+	B->texts = 0;
+}
+
+// throw away a layer's full quality batches, they're rebuilt when next drawn
+static void
+layer_dirty (struct layer *L)
+{
+	int i;
+
+	for (i = 0; i < MAX_VIEWS; i++)
+		batch_free (L, &L->batch[i]);
+	L->texts = 0;
+	L->record_gen++;		// recordings being made are for the old one
+	L->cached = 0;
+	shader_free (L);
+}
+
+// is a layer's full quality batch drawn in chunks? else it's all drawn by render_layer()
+static int
+render_chunked (struct layer *L)
+{
+	return !(Density && L->density && density_wanted (L)) && Frame_count == 0 && !(Shaders && Shader_program != 0);
+}
+
+// the full quality batch of L to draw at the current zoom: the one with
+// its Text built for it, else one with no Text yet, else a new one in
+// place of one no view has drawn since its last frame
+static struct batch *
+batch_pick (struct layer *L)
+{
+	struct batch *B, *blank = NULL, *stale = NULL, *unused = NULL;
+	int z = text_zoom ();
+
+	for (B = L->batch; B < L->batch + MAX_VIEWS; B++) {
+		if (B->list == 0)
+			unused = unused == NULL ? B : unused;
+		else if (B->texts > 0 && B->text_zoom == z)
+			break;
+		else if (B->texts == 0)
+			blank = B;
+		else if (Views_drawn - B->drawn >= (unsigned int) Nviews)
+			stale = B;
+	}
+	if (B == L->batch + MAX_VIEWS && (B = blank) == NULL) {
+		B = stale != NULL ? stale : unused != NULL ? unused : L->batch;	// the views draw at most MAX_VIEWS zooms
+		batch_free (L, B);
+	}
+	B->drawn = Views_drawn;
+	return B;
+}
+
+// get a layer's full quality batch ready to be drawn chunk by chunk, returns the number of chunks
+static int
+render_begin (struct layer *L)
+{
+	struct batch *B;
+
+	if (L->chunk == NULL)
+		layer_chunks (L);
+	B = L->full = batch_pick (L);
+	if (B->list == 0 && L->nchunk > 0)
+		B->list = glGenLists (L->nchunk);	// if that fails chunks are drawn directly
+	if (B->built == NULL && L->nchunk > 0)
+		B->built = must_zalloc (L->nchunk);
+	if (B->list != 0 && B->nbuilt < L->nchunk)
+		record_begin (L);
+	return L->nchunk;
+}
+
+// draw chunk k of a layer's full quality batch, building it if it isn't,
+// returns 0 if its recording isn't ready yet and wait isn't set
+static int
+render_chunk (struct layer *L, int k, int wait)
+{
+	struct object *o, *prev = NULL;
+	struct cursor c = {.next = L->chunk[k],.k = 0 };
+	struct recording *R = NULL;
+	struct batch *B = L->full;
+	int i, build = B->list != 0;	// else drawn directly
+
+	if (build && B->built[k]) {
+		glCallList (B->list + k);
+		return 1;
+	}
+	if (build && L->record != NULL && (R = record_result (L, k, wait)) == NULL && __atomic_load_n (&L->record[k].state, __ATOMIC_ACQUIRE) != RECORD_IDLE)
+		return 0;
+	Text_count = 0;
+	if (build)
+		glNewList (B->list + k, GL_COMPILE_AND_EXECUTE);
+	if (R != NULL) {
+		rec_play (R);
+		Text_count = R->texts;
+		free_recording (R);
+	}
+	else
+		for (i = 0; i < LAYER_CHUNK && (o = object_next (L, &c)) != NULL; i++) {
+			render_state (o, prev);
+			render_object (o);
+			prev = o;
+		}
+	if (build) {
+		glEndList ();
+		B->built[k] = 1;
+		B->nbuilt++;
+		B->texts += Text_count;
+		B->text_zoom = text_zoom ();
+	}
+	return 1;
+}
+
+// can chunk k of L be skipped: is it off the view (when it isn't rotated), or hidden by later layers?
+static int
+chunk_hidden (struct layer *L, int k)
+{
+	double *b = L->chunk_box[k], pad = (L->chunk_width[k] + 2) / Zoom;	// a line's width is in pixels
+
+	if (RotX == 0 && RotY == 0 && RotZ == 0
+	    && (b[2] + pad < -PanX || b[0] - pad > -PanX + Win_w / Zoom || b[3] + pad < -PanY - Win_h / Zoom || b[1] - pad > -PanY))
+		return 1;
+	return occ_chunk (L, k);
+}
+
+//
+//      render_layer --- draw a layer from its render batch
+//
+//      Each layer has a full quality batch (or a shader one), and a coarse
+//      one that is used while interacting (thinned out when the layer is
+//      dense).  The full quality one is built in chunks of LAYER_CHUNK
+//      objects, so a frame can be drawn a piece at a time (see
+//      progress_pass()), and chunks off the view or hidden skipped (see
+//      chunk_hidden()).  Batches are built on first use and kept until
+//      layer_dirty(), one for each zoom its Text is drawn at by a view
+//      (see batch_pick()).
+//
+static void
+render_layer (struct layer *L)
+{
+	int decimate, k, n;
+
+	if (!Interacting && render_chunked (L)) {
+		n = render_begin (L);
+		for (k = 0; k < n; k++)
+			if (!chunk_hidden (L, k))
+				render_chunk (L, k, 1);
+		return;
+	}
+	if (Density && L->density && density_wanted (L)) {
+		density_layer (L);
+		return;
+	}
+	if (Frame_count > 0) {
+		frames_layer (L);
+		return;
+	}
+	if (!Interacting) {
+		if (L->texts > 0 && L->text_zoom != text_zoom ())
+			layer_dirty (L);	// its text was drawn for another zoom
+		Text_count = 0;
+		shader_layer (L);
+		if (Text_count > 0) {	// the batch was just built
+			L->texts = Text_count;
+			L->text_zoom = text_zoom ();
+		}
+		return;
+	}
+	decimate = (L->n > DENSE_LAYER) ? Decimate : 1;
+	if (L->coarse != 0 && L->coarse_decimate == decimate)
+		glCallList (L->coarse);
+	else {
+		L->coarse_decimate = decimate;
+		render_batch (L, &L->coarse, decimate);
+	}
+}
+
+// Sidecar cache ---------------------------------------------------------------
+//
+//      What's loaded from a file is saved next to it, in file.glvc, on a
+//      thread once the window is up: every layer's objects (or packed
+//      bytes), its chunks with their bounds and its occluders, the
+//      tessellated Polygons, the palette and the bounds.  The next time
+//      the file is opened with the same --dedup, --merge, --simplify and
+//      --compact, the sidecar is mapped instead of reading the file, if
+//      the file's size, modification time and a hash of its content are
+//      still the ones it was made from.  Objects are used where they're
+//      mapped: Text and Polygon pointers are stored as references into the
+//      strings and the Polygons, and fixed up in parallel once mapped (it's
+//      mapped private, so just the pages with pointers are copied).  It
+//      has a hash of its own too, of all of it header included, and all
+//      of it is checked to be within the file, so a stale, truncated or
+//      corrupt sidecar only means a full load, and a new sidecar.  One
+//      that's still being written at exit is removed.  It's not used for
+//      stdin, Frames or --store, and not written during a --replay, so it
+//      doesn't take cpu and disk from the frames being timed.
+//
+//      file: header, layers, then for every layer its objects or packed
+//            bytes, tiles, chunks, chunk bounds, chunk widths and
+//            occluders, then the strings (layer names, then Text) and the
+//            Polygons (each followed by its points, contours and
+//            triangles), every section SIDECAR_ALIGN aligned
+
+#define	SIDECAR_MAGIC	"glvside"
+#define	SIDECAR_VERSION	2
+#define	SIDECAR_ALIGN	64
+#define	SIDECAR_BLOCK	(1<<20)	// bytes of the input hashed by one parallel_for() index
+
+struct sidecar_header
+{
+	char magic[8];
+	int version;
+	int object_size;	// sizeof (struct object), it's only read by a build like the one that wrote it
+	long long size, mtime, mtime_ns;	// of the input
+	unsigned long long hash;	// of its content
+	unsigned long long check;	// hash of the sidecar, with this 0
+	int dedup, merge, compact;	// the options that change what's loaded
+	double simplify;
+	int bounds[4];		// Minx Miny Maxx Maxy, with the margin
+	int nlayers;
+	int npalette;
+	unsigned char palette[256][3];
+	size_t strings, nstrings;	// offset and size of the strings
+	size_t polygons, npolygons;	// ... and of the Polygons
+	size_t total;		// file size
+};
+
+struct sidecar_layer
+{
+	int number;
+	int packed;		// --compact: obj is its packed bytes
+	int n, ntiles, nchunk, nocc;
+	long long name;		// offset in the strings, -1 if it has none
+	size_t size;		// packed bytes
+	size_t obj, tiles, chunk, chunk_box, chunk_width, occ;	// file offsets
+	double ext[4];
+};
+
+struct sidecar
+{
+	int loaded;		// the layers are from it
+	char *input;		// file to write one for once it's loaded, NULL if none
+	struct stat st;		// of the input when it was opened
+	FILE *fp;		// being written
+	char tmp[MAXSTRING];	// ... to this, removed at exit if it's not done
+	volatile int writing;
+	size_t at;		// bytes written
+	size_t nstrings, npolygons;	// strings and Polygons referred to so far
+	int failed;		// a write failed
+} Sidecar;
+
+// hashing the input
+struct sidecar_hash
+{
+	const unsigned char *p;
+	size_t size;
+	unsigned long long *block;	// hash of each SIDECAR_BLOCK
+};
+
+// reading a sidecar, fixing up the pointers
+struct sidecar_fix
+{
+	struct layer *L;	// the layers read
+	int (*job)[2];		// layer and chunk for each parallel_for() index
+	unsigned char *strings, *polygons;
+	size_t nstrings, npolygons;
+	int bad;		// something in it isn't right
+};
+
+// parallel_for() worker: hash one block of the input
+static void
+sidecar_hash_block (void *arg, int index, int thread)
+{
+	struct sidecar_hash *H = arg;
+	const unsigned char *p = H->p + (size_t) index * SIDECAR_BLOCK;
+	size_t i, n = H->size - (size_t) index * SIDECAR_BLOCK;
+	unsigned long long h = 0x9e3779b97f4a7c15ull ^ index, w;
+
+	(void) thread;
+	if (n > SIDECAR_BLOCK)
+		n = SIDECAR_BLOCK;
+	for (i = 0; i + sizeof (w) <= n; i += sizeof (w)) {
+		memcpy (&w, p + i, sizeof (w));
+		h = (h ^ w) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+	for (; i < n; i++)
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	H->block[index] = h;
+}
+
+// hash of size bytes at p, never 0
+static unsigned long long
+sidecar_hash_bytes (const unsigned char *p, size_t size)
+{
+	struct sidecar_hash H = {.p = p,.size = size };
+	unsigned long long h = 0;
+	int i, n = (size + SIDECAR_BLOCK - 1) / SIDECAR_BLOCK;
+
+	H.block = must_malloc ((n + 1) * sizeof (*H.block));
+	parallel_for (n, sidecar_hash_block, &H);
+	for (i = 0; i < n; i++) {
+		h = (h ^ H.block[i]) * 0x9e3779b97f4a7c15ull;
+		h ^= h >> 29;
+	}
+	free (H.block);
+	return (h ^ size) | 1;
+}
+
+// hash of a file's content from offset skip on, 0 if it can't be read
+static unsigned long long
+sidecar_hash (char *file, size_t skip)
+{
+	struct stat st;
+	unsigned long long h;
+	unsigned char *p;
+	size_t size;
+	int fd;
+
+	if ((fd = open (file, O_RDONLY)) < 0)
+		return 0;
+	if (fstat (fd, &st) != 0 || (size_t) st.st_size < skip) {
+		close (fd);
+		return 0;
+	}
+	size = st.st_size;
+	p = (size > 0) ? mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	close (fd);
+	if (p == MAP_FAILED)
+		return 0;
+	h = sidecar_hash_bytes (p + skip, size - skip);
+	if (size > 0)
+		munmap (p, size);
+	return h;
+}
+
+// hash of the whole sidecar: its header (with check 0) and 'rest', the hash of what follows it
+static unsigned long long
+sidecar_check (const struct sidecar_header *h, unsigned long long rest)
+{
+	struct sidecar_header c;
+
+	memcpy (&c, h, sizeof (c));
+	c.check = 0;
+	return ((sidecar_hash_bytes ((unsigned char *) &c, sizeof (c)) ^ rest) * 0x9e3779b97f4a7c15ull) | 1;
+}
+
+static inline size_t
+sidecar_align (size_t at)
+{
+	return (at + SIDECAR_ALIGN - 1) / SIDECAR_ALIGN * SIDECAR_ALIGN;
+}
+
+static void
+sidecar_put (const void *p, size_t n)
+{
+	if (n > 0 && fwrite (p, n, 1, Sidecar.fp) != 1)
+		Sidecar.failed = 1;
+	Sidecar.at += n;
+}
+
+// pad what's written to where the next section starts
+static void
+sidecar_pad (void)
+{
+	static const char zero[SIDECAR_ALIGN];
+
+	sidecar_put (zero, sidecar_align (Sidecar.at) - Sidecar.at);
+}
+
+// bytes a Polygon takes in the sidecar
+static size_t
+sidecar_poly_size (struct polygon *P)
+{
+	return (sizeof (*P) + ((size_t) P->n * 2 + P->ncontours + (size_t) P->ntri * 6) * sizeof (int) + 7) & ~(size_t) 7;
+}
+
+// what o's Text or Polygon pointer is stored as: 1 + its offset in the strings or the Polygons, 0 for none
+static size_t
+sidecar_ref (struct object *o)
+{
+	size_t ref = 0;
+
+	if (o->type == TYPE_TEXT && o->text != NULL) {
+		ref = Sidecar.nstrings + 1;
+		Sidecar.nstrings += strlen (o->text) + 1;
+	}
+	else if (o->type == TYPE_POLYGON && o->poly != NULL) {
+		ref = Sidecar.npolygons + 1;
+		Sidecar.npolygons += sidecar_poly_size (o->poly);
+	}
+	return ref;
+}
+
+// write L's objects or packed bytes, with their pointers as references
+static void
+sidecar_put_objects (struct layer *L)
+{
+	struct object buf[256], o;
+	unsigned char *p;
+	size_t i, n, at, end, sz, ref;
+	int k;
+
+	if (L->packed == NULL) {
+		for (i = 0; i < (size_t) L->n; i += n) {
+			n = (L->n - i < 256) ? L->n - i : 256;
+			memcpy (buf, L->obj + i, n * sizeof (*buf));
+			for (k = 0; k < (int) n; k++)
+				if (buf[k].type == TYPE_TEXT || buf[k].type == TYPE_POLYGON)
+					buf[k].text = (char *) sidecar_ref (&buf[k]);
+			sidecar_put (buf, n * sizeof (*buf));
+		}
+		return;
+	}
+	for (k = 0; k < L->nchunk; k++) {
+		end = (k + 1 < L->nchunk) ? L->chunk[k + 1] : L->size;
+		p = must_malloc (end - L->chunk[k]);
+		memcpy (p, L->packed + L->chunk[k], end - L->chunk[k]);
+		for (at = 0; at < end - L->chunk[k]; at += sz) {
+			sz = unpack (L, p + at, &o);
+			if (o.type == TYPE_TEXT || o.type == TYPE_POLYGON) {
+				ref = sidecar_ref (&o);
+				memcpy (p + at + sz - sizeof (char *), &ref, sizeof (char *));
+			}
+		}
+		sidecar_put (p, end - L->chunk[k]);
+		free (p);
+	}
+}
+
+// write the Text (or Polygons) the objects refer to, in the order sidecar_ref() counted them
+static void
+sidecar_put_refs (int polygons)
+{
+	static const char zero[8];
+	struct polygon P;
+	struct layer *L;
+	struct object *o;
+	struct cursor c;
+	size_t n;
+	int i;
+
+	LAYER_WALK (i, L) {
+		OBJECT_SCAN (L, c, o) {
+			if (!polygons && o->type == TYPE_TEXT && o->text != NULL)
+				sidecar_put (o->text, strlen (o->text) + 1);
+			if (!polygons || o->type != TYPE_POLYGON || o->poly == NULL)
+				continue;
+			P = *o->poly;
+			P.xy = P.contour = P.tri = NULL;	// they follow it
+			n = sizeof (P) + ((size_t) P.n * 2 + P.ncontours + (size_t) P.ntri * 6) * sizeof (int);
+			sidecar_put (&P, sizeof (P));
+			sidecar_put (o->poly->xy, (size_t) P.n * 2 * sizeof (int));
+			sidecar_put (o->poly->contour, P.ncontours * sizeof (int));
+			sidecar_put (o->poly->tri, (size_t) P.ntri * 6 * sizeof (int));
+			sidecar_put (zero, sidecar_poly_size (&P) - n);
+		}
+	}
+}
+
+// write the sidecar of what was loaded from Sidecar.input
+static void *
+sidecar_writer (void *arg)
+{
+	struct sidecar_header h;
+	struct sidecar_layer *S;
+	struct layer *L;
+	char path[MAXSTRING], *tmp = Sidecar.tmp;
+	unsigned long long rest;
+	double t = now ();
+	size_t at;
+	int i;
+
+	(void) arg;
+	memset (&h, 0, sizeof (h));
+	memcpy (h.magic, SIDECAR_MAGIC, sizeof (h.magic));
+	h.version = SIDECAR_VERSION;
+	h.object_size = sizeof (struct object);
+	h.size = Sidecar.st.st_size;
+	h.mtime = Sidecar.st.st_mtim.tv_sec;
+	h.mtime_ns = Sidecar.st.st_mtim.tv_nsec;
+	if ((h.hash = sidecar_hash (Sidecar.input, 0)) == 0)
+		return NULL;
+	h.dedup = Dedup;
+	h.merge = Merge;
+	h.compact = Compact;
+	h.simplify = Simplify;
+	h.bounds[0] = Minx;
+	h.bounds[1] = Miny;
+	h.bounds[2] = Maxx;
+	h.bounds[3] = Maxy;
+	h.nlayers = Nlayers;
+	h.npalette = Npalette;
+	memcpy (h.palette, Palette, sizeof (h.palette));
+	snprintf (path, sizeof (path), "%s.glvc", Sidecar.input);
+	snprintf (tmp, sizeof (Sidecar.tmp), "%s.glvc.tmp", Sidecar.input);
+	Sidecar.writing = 1;
+	if ((Sidecar.fp = fopen (tmp, "w")) == NULL) {
+		Sidecar.writing = 0;
+		error ("Can't write %s", tmp);
+		return NULL;
+	}
+
+	// where everything goes
+	S = must_zalloc (Nlayers * sizeof (*S));
+	at = sidecar_align (sizeof (h) + Nlayers * sizeof (*S));
+	LAYER_WALK (i, L) {
+		S[i].number = L->number;
+		S[i].packed = L->packed != NULL;
+		S[i].n = L->n;
+		S[i].size = L->size;
+		S[i].ntiles = L->ntiles;
+		S[i].nchunk = L->nchunk;
+		S[i].nocc = L->nocc;
+		memcpy (S[i].ext, L->ext, sizeof (S[i].ext));
+		S[i].name = -1;
+		if (L->name != NULL) {
+			S[i].name = Sidecar.nstrings;
+			Sidecar.nstrings += strlen (L->name) + 1;
+		}
+		S[i].obj = at;
+		at = sidecar_align (at + (L->packed ? L->size : L->n * sizeof (*L->obj)));
+		S[i].tiles = at;
+		at = sidecar_align (at + L->ntiles * sizeof (*L->tiles));
+		S[i].chunk = at;
+		at = sidecar_align (at + L->nchunk * sizeof (*L->chunk));
+		S[i].chunk_box = at;
+		at = sidecar_align (at + L->nchunk * sizeof (*L->chunk_box));
+		S[i].chunk_width = at;
+		at = sidecar_align (at + L->nchunk * sizeof (*L->chunk_width));
+		S[i].occ = at;
+		at = sidecar_align (at + L->nocc * sizeof (*L->occ));
+	}
+
+	sidecar_put (&h, sizeof (h));	// rewritten once it's all there
+	sidecar_put (S, Nlayers * sizeof (*S));
+	LAYER_WALK (i, L) {
+		sidecar_pad ();
+		sidecar_put_objects (L);
+		sidecar_pad ();
+		sidecar_put (L->tiles, L->ntiles * sizeof (*L->tiles));
+		sidecar_pad ();
+		sidecar_put (L->chunk, L->nchunk * sizeof (*L->chunk));
+		sidecar_pad ();
+		sidecar_put (L->chunk_box, L->nchunk * sizeof (*L->chunk_box));
+		sidecar_pad ();
+		sidecar_put (L->chunk_width, L->nchunk * sizeof (*L->chunk_width));
+		sidecar_pad ();
+		sidecar_put (L->occ, L->nocc * sizeof (*L->occ));
+	}
+	sidecar_pad ();
+	h.strings = Sidecar.at;
+	LAYER_WALK (i, L)
+		if (L->name != NULL)
+			sidecar_put (L->name, strlen (L->name) + 1);
+	sidecar_put_refs (0);
+	h.nstrings = Sidecar.at - h.strings;
+	sidecar_pad ();
+	h.polygons = Sidecar.at;
+	sidecar_put_refs (1);
+	h.npolygons = Sidecar.at - h.polygons;
+	h.total = Sidecar.at;
+	if (fflush (Sidecar.fp) != 0 || (rest = sidecar_hash (tmp, sizeof (h))) == 0)
+		Sidecar.failed = 1;
+	h.check = sidecar_check (&h, rest);
+	if (fseek (Sidecar.fp, 0, SEEK_SET) != 0 || fwrite (&h, sizeof (h), 1, Sidecar.fp) != 1)
+		Sidecar.failed = 1;
+	if (fclose (Sidecar.fp) != 0)
+		Sidecar.failed = 1;
+	free (S);
+	if (Sidecar.failed || rename (tmp, path) != 0) {
+		unlink (tmp);
+		Sidecar.writing = 0;
+		error ("Can't write %s", path);
+		return NULL;
+	}
+	Sidecar.writing = 0;
+	printf ("Sidecar %s: %.1f MB, %.2f seconds\n", path, h.total / 1048576.0, now () - t);
+	return NULL;
+}
+
+// atexit(): don't leave a half written sidecar behind
+static void
+sidecar_abandon (void)
+{
+	if (Sidecar.writing)
+		unlink (Sidecar.tmp);
+}
+
+// start writing the sidecar of the file just loaded, if it needs one
+static void
+sidecar_save (void)
+{
+	struct layer *L;
+	pthread_t tid;
+	int i;
+
+	if (Sidecar.input == NULL || Frame_count > 0 || Replay_file != NULL)
+		return;
+	LAYER_WALK (i, L)
+		if (L->chunk == NULL)
+			layer_chunks (L);	// so they're saved, and not made while being written
+	atexit (sidecar_abandon);
+	if (pthread_create (&tid, NULL, sidecar_writer, NULL) != 0)
+		fatal ("Can't create the sidecar thread");
+	pthread_detach (tid);
+}
+
+// size of the packed record at p, 0 if it doesn't fit in 'room' bytes or isn't one
+static size_t
+sidecar_record (struct layer *L, const unsigned char *p, size_t room)
+{
+	int h = p[0], type = h & PACK_TYPE, n;
+	size_t sz;
+
+	if (type == TYPE_NONE || type > TYPE_POLYGON)
+		return 0;
+	n = Pack_args[type];
+	sz = 1 + ((h & PACK_RGB) ? 3 : 1);
+	if (!(h & PACK_WIDE)) {
+		if (sz + 2 > room || (p[sz] | p[sz + 1] << 8) >= L->ntiles)
+			return 0;
+		sz += 2 + n * 2;
+	}
+	else
+		sz += n * sizeof (int);
+	sz += (h & PACK_WIDTH) ? sizeof (int) : 1;
+	if (type == TYPE_TEXT || type == TYPE_POLYGON)
+		sz += sizeof (char *);
+	return (sz <= room) ? sz : 0;
+}
+
+// a Text or Polygon reference read from the sidecar as a pointer, in place; 0 if it's bad
+static int
+sidecar_deref (struct sidecar_fix *F, int type, void *v)
+{
+	struct polygon *P;
+	size_t ref, n;
+	int i, sum = 0;
+
+	memcpy (&ref, v, sizeof (ref));
+	if (ref-- == 0)
+		return 1;	// NULL
+	if (type == TYPE_TEXT) {
+		if (ref >= F->nstrings)
+			return 0;
+		ref = (size_t) (F->strings + ref);
+		memcpy (v, &ref, sizeof (ref));
+		return 1;
+	}
+	if (ref % 8 != 0 || ref >= F->npolygons || F->npolygons - ref < sizeof (*P))
+		return 0;
+	P = (struct polygon *) (F->polygons + ref);
+	if (P->xy != NULL || P->n < 0 || P->ncontours < 0 || P->ntri < 0)
+		return 0;	// or it's referred to twice
+	n = ((size_t) P->n * 2 + P->ncontours + (size_t) P->ntri * 6) * sizeof (int);
+	if (n > F->npolygons - ref - sizeof (*P))
+		return 0;
+	P->xy = (int *) (P + 1);
+	P->contour = P->xy + (size_t) P->n * 2;
+	P->tri = P->contour + P->ncontours;
+	for (i = 0; i < P->ncontours; i++)
+		if (P->contour[i] < 0 || (sum += P->contour[i]) > P->n)
+			return 0;
+	memcpy (v, &P, sizeof (P));
+	return 1;
+}
+
+// parallel_for() worker: check one chunk of a layer read from the sidecar, fixing its pointers
+static void
+sidecar_fix_chunk (void *arg, int index, int thread)
+{
+	struct sidecar_fix *F = arg;
+	struct layer *L = &F->L[F->job[index][0]];
+	int k = F->job[index][1], count = 0;
+	size_t at = L->chunk[k], end, sz;
+	struct object *o;
+
+	(void) thread;
+	if (L->packed == NULL) {
+		end = (k + 1 < L->nchunk) ? L->chunk[k + 1] : (size_t) L->n;
+		for (o = L->obj + at; o < L->obj + end; o++)
+			if (o->type == TYPE_NONE || o->type > TYPE_POLYGON
+			    || ((o->type == TYPE_TEXT || o->type == TYPE_POLYGON) && !sidecar_deref (F, o->type, &o->text))) {
+				__atomic_store_n (&F->bad, 1, __ATOMIC_RELAXED);
+				return;
+			}
+		return;
+	}
+	end = (k + 1 < L->nchunk) ? L->chunk[k + 1] : L->size;
+	for (; at < end; at += sz, count++) {
+		if ((sz = sidecar_record (L, L->packed + at, end - at)) == 0
+		    || ((L->packed[at] & PACK_TYPE) >= TYPE_TEXT && !sidecar_deref (F, L->packed[at] & PACK_TYPE, L->packed + at + sz - sizeof (char *)))) {
+			__atomic_store_n (&F->bad, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	}
+	if (count != ((k + 1 < L->nchunk) ? LAYER_CHUNK : L->n - k * LAYER_CHUNK))
+		__atomic_store_n (&F->bad, 1, __ATOMIC_RELAXED);
+}
+
+// set up layer L from its entry in the sidecar at base, 0 if it doesn't fit
+static int
+sidecar_layer (struct layer *L, struct sidecar_layer *S, unsigned char *base, size_t total)
+{
+	size_t bytes = S->packed ? S->size : S->n * sizeof (*L->obj);
+	int k;
+
+	if (S->number < 1 || S->number > MAX_LAYERS || S->n < 0 || S->ntiles < 0 || S->nocc < 0
+	    || S->nchunk != (S->n + LAYER_CHUNK - 1) / LAYER_CHUNK || (S->packed && S->nchunk > 0 && S->size == 0))
+		return 0;
+	if (S->obj % SIDECAR_ALIGN || S->tiles % SIDECAR_ALIGN || S->chunk % SIDECAR_ALIGN
+	    || S->chunk_box % SIDECAR_ALIGN || S->chunk_width % SIDECAR_ALIGN || S->occ % SIDECAR_ALIGN)
+		return 0;
+	if (S->obj > total || bytes > total - S->obj
+	    || S->tiles > total || S->ntiles * sizeof (*L->tiles) > total - S->tiles
+	    || S->chunk > total || S->nchunk * sizeof (*L->chunk) > total - S->chunk
+	    || S->chunk_box > total || S->nchunk * sizeof (*L->chunk_box) > total - S->chunk_box
+	    || S->chunk_width > total || S->nchunk * sizeof (*L->chunk_width) > total - S->chunk_width
+	    || S->occ > total || S->nocc * sizeof (*L->occ) > total - S->occ)
+		return 0;
+	L->number = S->number;
+	L->n = L->max = S->n;
+	if (S->packed) {
+		L->packed = base + S->obj;
+		L->size = S->size;
+		L->tiles = (int (*)[2]) (base + S->tiles);
+		L->ntiles = S->ntiles;
+	}
+	else
+		L->obj = (struct object *) (base + S->obj);
+	L->chunk = (size_t *) (base + S->chunk);
+	L->nchunk = S->nchunk;
+	L->chunk_box = (double (*)[4]) (base + S->chunk_box);
+	L->chunk_width = (int *) (base + S->chunk_width);
+	L->occ = (struct occluder *) (base + S->occ);
+	L->nocc = S->nocc;
+	memcpy (L->ext, S->ext, sizeof (L->ext));
+	for (k = 0; k < L->nchunk; k++) {
+		if (!S->packed && L->chunk[k] != (size_t) k * LAYER_CHUNK)
+			return 0;
+		if (S->packed && (L->chunk[k] >= L->size || (k == 0 ? L->chunk[k] != 0 : L->chunk[k] <= L->chunk[k - 1])))
+			return 0;
+	}
+	return 1;
+}
+
+// why the sidecar at base (of size bytes) can't be used for file, NULL if it can
+static char *
+sidecar_stale (struct sidecar_header *h, size_t size, char *file)
+{
+	if (size < sizeof (*h) || memcmp (h->magic, SIDECAR_MAGIC, sizeof (h->magic)) != 0)
+		return "isn't a sidecar";
+	if (h->version != SIDECAR_VERSION || h->object_size != (int) sizeof (struct object))
+		return "is from another version";
+	if (h->size != Sidecar.st.st_size || h->mtime != Sidecar.st.st_mtim.tv_sec || h->mtime_ns != Sidecar.st.st_mtim.tv_nsec)
+		return "is out of date";
+	if (h->dedup != Dedup || h->merge != Merge || h->compact != Compact || h->simplify != Simplify)
+		return "has other options";
+	if (h->total != size || h->nlayers < 1 || h->nlayers > MAX_LAYERS || h->npalette < 0 || h->npalette > 256
+	    || sizeof (*h) + h->nlayers * sizeof (struct sidecar_layer) > size
+	    || h->strings > size || h->nstrings > size - h->strings || h->polygons > size || h->npolygons > size - h->polygons
+	    || h->polygons % SIDECAR_ALIGN != 0 || (h->nstrings > 0 && ((char *) h)[h->strings + h->nstrings - 1] != '\0'))
+		return "is corrupt";
+	if (sidecar_hash (file, 0) != h->hash)
+		return "is out of date";
+	if (sidecar_check (h, sidecar_hash_bytes ((unsigned char *) (h + 1), size - sizeof (*h))) != h->check)
+		return "is corrupt";
+	return NULL;
+}
+
+// load the layers from file's sidecar, returns 0 if it can't be used (and file has to be read)
+static int
+sidecar_load (char *file)
+{
+	struct sidecar_header *h;
+	struct sidecar_layer *S;
+	struct sidecar_fix F;
+	struct layer *L;
+	unsigned char *base;
+	char path[MAXSTRING], *why = NULL;
+	double t = now ();
+	struct stat st;
+	size_t size = 0;
+	long long objects = 0;
+	int fd, i, k, n = 0;
+
+	if (!Sidecar_on || stat (file, &Sidecar.st) != 0 || !S_ISREG (Sidecar.st.st_mode))
+		return 0;
+	Sidecar.input = file;	// write one once it's loaded, unless it's read here
+	snprintf (path, sizeof (path), "%s.glvc", file);
+	if ((fd = open (path, O_RDONLY)) < 0)
+		return 0;
+	base = MAP_FAILED;
+	if (fstat (fd, &st) == 0 && (size = st.st_size) > 0)
+		base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close (fd);
+	if (base == MAP_FAILED)
+		return 0;
+	h = (struct sidecar_header *) base;
+	S = (struct sidecar_layer *) (h + 1);
+	memset (&F, 0, sizeof (F));
+	if ((why = sidecar_stale (h, size, file)) == NULL) {
+		F.L = must_zalloc (h->nlayers * sizeof (*F.L));
+		F.strings = base + h->strings;
+		F.nstrings = h->nstrings;
+		F.polygons = base + h->polygons;
+		F.npolygons = h->npolygons;
+		for (i = 0; i < h->nlayers && why == NULL; i++) {
+			if (!sidecar_layer (&F.L[i], &S[i], base, size) || (i == 0 ? S[i].number != 1 : S[i].number <= S[i - 1].number)
+			    || S[i].name < -1 || S[i].name >= (long long) h->nstrings || (S[i].packed && !h->compact))
+				why = "is corrupt";
+			n += S[i].nchunk;
+		}
+	}
+	if (why == NULL) {
+		F.job = must_malloc ((n + 1) * sizeof (*F.job));
+		for (n = i = 0; i < h->nlayers; i++)
+			for (k = 0; k < F.L[i].nchunk; k++, n++) {
+				F.job[n][0] = i;
+				F.job[n][1] = k;
+			}
+		parallel_for (n, sidecar_fix_chunk, &F);
+		free (F.job);
+		if (F.bad)
+			why = "is corrupt";
+	}
+	if (why != NULL) {
+		printf ("Sidecar %s %s, reading %s\n", path, why, file);
+		free (F.L);
+		munmap (base, size);
+		return 0;
+	}
+
+	for (i = 0; i < h->nlayers; i++) {
+		L = layer_get (S[i].number);
+		*L = F.L[i];
+		if (S[i].name >= 0)
+			layer_name (L->number, (char *) F.strings + S[i].name);
+		objects += L->n;
+	}
+	free (F.L);
+	Minx = h->bounds[0];
+	Miny = h->bounds[1];
+	Maxx = h->bounds[2];
+	Maxy = h->bounds[3];
+	Npalette = h->npalette;
+	memcpy (Palette, h->palette, sizeof (Palette));
+	Sidecar.loaded = 1;
+	Sidecar.input = NULL;
+	printf ("Sidecar %s: %d layers, %lld objects, %.2f seconds\n", path, h->nlayers, objects, now () - t);
+	layer_setup ();
+	return 1;
+}
+
+// Paging the store ---------------------------------------------------------------
+//
+//      With --store, the tiles around the view are decoded on a loader
+//      thread into a layer for each layer number, drawn like any other.
+//      Tiles ahead of the direction the view is panning are loaded too.
+//      Tiles smaller than STORE_SUMMARY_PIXELS on screen, or not loaded
+//      yet, are drawn from their summaries.  Once more than --cache MB are
+//      loaded, the tiles out of view that were wanted least recently are
+//      evicted.  Text is drawn straight from the mapped data.
+
+// free a loaded tile's layers and batches
+static void
+tile_evict (struct tile *T)
+{
+	struct store_chunk *c;
+	struct layer *L;
+	long page = sysconf (_SC_PAGESIZE);
+	long long start;
+	int i, k;
+
+	for (i = 0; i < T->nlayers; i++) {
+		L = &T->layers[i];
+		layer_dirty (L);
+		if (L->coarse != 0)
+			glDeleteLists (L->coarse, 1);
+		free (L->obj);
+		free (L->chunk);
+		for (k = 0; k < MAX_VIEWS; k++)
+			free (L->batch[k].built);
+	}
+	free (T->layers);
+	T->layers = NULL;
+	T->nlayers = 0;
+	for (i = 0; i < T->t->nchunks; i++) {	// its pages are read again if they're needed
+		c = &Store.chunk[T->t->first + i];
+		start = c->offset & ~(long long) (page - 1);
+		madvise (Store.data + start, c->offset + c->size - start, MADV_DONTNEED);
+	}
+	__sync_fetch_and_sub (&Store.bytes, T->bytes);
+	T->state = TILE_OUT;
+}
+
+static int
+wanted_cmp (const void *a, const void *b)
+{
+	unsigned int x = Store.tile[*(const int *) a].wanted;
+	unsigned int y = Store.tile[*(const int *) b].wanted;
+
+	return (x > y) - (x < y);
+}
+
+// evict the least recently wanted tiles until the rest fit in --cache
+static void
+store_evict (void)
+{
+	size_t budget = (size_t) Cache_mb << 20;
+	int i, n = 0;
+
+	if (Store.bytes <= budget)
+		return;
+	for (i = 0; i < Store.h->ntiles; i++)
+		if (Store.tile[i].state == TILE_IN && Store.tile[i].wanted != Store.frame && Store.tile[i].t->nchunks > 0)
+			Store.lru[n++] = i;
+	qsort (Store.lru, n, sizeof (*Store.lru), wanted_cmp);
+	for (i = 0; i < n && Store.bytes > budget; i++)
+		tile_evict (&Store.tile[Store.lru[i]]);
+}
+
+// while tiles are being loaded, redraw as they arrive
+static void
+Store_poll (int value)
+{
+	int busy;
+
+	(void) value;
+	pthread_mutex_lock (&Store.lock);
+	busy = Store.nqueue > 0 || Store.loading;
+	pthread_mutex_unlock (&Store.lock);
+	if (__atomic_exchange_n (&Store.loaded, 0, __ATOMIC_ACQ_REL))
+		post_redisplay ();
+	if (busy)
+		glutTimerFunc (STORE_POLL_MS, Store_poll, 0);
+	else
+		Store.polling = 0;
+}
+
+// grid range g[4] (x0,y0,x1,y1 inclusive) of the tiles that may draw in a model rectangle
+static void
+store_range (double x0, double y0, double x1, double y1, int g[4])
+{
+	int s = Store.h->spill, n = Store.h->grid - 1;
+
+	g[0] = clamp ((int) floor ((x0 - Store.h->minx) / Store.tw) - s, 0, n);
+	g[1] = clamp ((int) floor ((y0 - Store.h->miny) / Store.th) - s, 0, n);
+	g[2] = clamp ((int) floor ((x1 - Store.h->minx) / Store.tw) + s, 0, n);
+	g[3] = clamp ((int) floor ((y1 - Store.h->miny) / Store.th) + s, 0, n);
+}
+
+// do a tile's objects reach into a model rectangle?
+static inline int
+tile_in (struct tile *T, double x0, double y0, double x1, double y1)
+{
+	double *b = T->t->b;
+
+	return b[2] >= x0 && b[0] <= x1 && b[3] >= y0 && b[1] <= y1;
+}
+
+//
+//      store_request --- queue the tiles to load
+//
+//      The queue is refilled every frame: first the tiles whose objects
+//      reach into the prefetch rectangle q (the view and the area ahead of
+//      it, all within grid range g), then the ones reaching into the view
+//      rectangle r so they're loaded first.  All of them are marked wanted.
+//
+static void
+store_request (int g[4], double r[4], double q[4])
+{
+	struct tile *T;
+	int i, x, y, in, pass, busy;
+
+	pthread_mutex_lock (&Store.lock);
+	while (Store.nqueue > 0)	// what was wanted last frame may not be now
+		Store.tile[Store.queue[--Store.nqueue]].state = TILE_OUT;
+	for (pass = 0; pass < 2; pass++) {
+		for (y = g[1]; y <= g[3]; y++) {
+			for (x = g[0]; x <= g[2]; x++) {
+				if ((i = Store.at[y * Store.h->grid + x]) < 0)
+					continue;
+				T = &Store.tile[i];
+				in = tile_in (T, r[0], r[1], r[2], r[3]);
+				if (in != pass || !tile_in (T, q[0], q[1], q[2], q[3]))
+					continue;
+				T->wanted = Store.frame;
+				if (T->state == TILE_OUT) {
+					T->state = TILE_QUEUED;
+					Store.queue[Store.nqueue++] = i;
+				}
+			}
+		}
+	}
+	busy = Store.nqueue > 0 || Store.loading;
+	pthread_cond_signal (&Store.wake);
+	pthread_mutex_unlock (&Store.lock);
+	if (busy && !Store.polling) {
+		Store.polling = 1;
+		glutTimerFunc (STORE_POLL_MS, Store_poll, 0);
+	}
+}
+
+// model rectangle of summary cell i of a tile
+static void
+cell_rect (struct store_tile *t, int i, double b[4])
+{
+	double cw = Store.tw / STORE_SUMMARY, ch = Store.th / STORE_SUMMARY;
+
+	b[0] = Store.h->minx + t->tx * Store.tw + (i % STORE_SUMMARY) * cw;
+	b[1] = Store.h->miny + t->ty * Store.th + (i / STORE_SUMMARY) * ch;
+	b[2] = b[0] + cw;
+	b[3] = b[1] + ch;
+}
+
+// draw a tile's summary, a rectangle for each cell whose topmost layer is visible
+static void
+tile_summary (struct tile *T)
+{
+	struct store_cell *cell;
+	double b[4];
+	int i;
+
+	if (T->summary != 0 && T->summary_gen == Layer_vis_gen) {
+		glCallList (T->summary);
+		return;
+	}
+	if (T->summary == 0)
+		T->summary = glGenLists (1);
+	T->summary_gen = Layer_vis_gen;
+	glNewList (T->summary, GL_COMPILE_AND_EXECUTE);
+	glBegin (GL_QUADS);
+	for (i = 0; i < STORE_SUMMARY * STORE_SUMMARY; i++) {
+		cell = &T->t->cell[i];
+		if (cell->layer == 0 || !layer_visible (cell->layer))
+			continue;
+		cell_rect (T->t, i, b);
+		glColor3ub (cell->rgb[0], cell->rgb[1], cell->rgb[2]);
+		glVertex3d (b[0], b[1], ltoz (cell->layer));
+		glVertex3d (b[2], b[1], ltoz (cell->layer));
+		glVertex3d (b[2], b[3], ltoz (cell->layer));
+		glVertex3d (b[0], b[3], ltoz (cell->layer));
+	}
+	glEnd ();
+	glEndList ();
+}
+
+// a loaded tile's layer number n, NULL if it has none
+static struct layer *
+tile_find (struct tile *T, int n)
+{
+	int lo = 0, hi = T->nlayers - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (T->layers[mid].number == n)
+			return &T->layers[mid];
+		if (T->layers[mid].number < n)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return NULL;
+}
+
+// does a tile's summary?
+static inline int
+summary_in (struct store_tile *t, double x0, double y0, double x1, double y1)
+{
+	double tx = Store.h->minx + t->tx * Store.tw, ty = Store.h->miny + t->ty * Store.th;
+
+	return tx + Store.tw >= x0 && tx <= x1 && ty + Store.th >= y0 && ty <= y1;
+}
+
+// draw the store's tiles in the view, loading them as needed
+static void
+store_render (void)
+{
+	double x0 = -PanX, x1 = -PanX + Win_w / Zoom;
+	double y0 = -PanY - Win_h / Zoom, y1 = -PanY;
+	double w = x1 - x0, h = y1 - y0;
+	double dx = Store.panx - PanX, dy = Store.pany - PanY;	// how far the view moved since the last frame
+	int detail = fmin (Store.tw, Store.th) * Zoom >= STORE_SUMMARY_PIXELS;
+	double r[4] = { x0, y0, x1, y1 };	// the view, and with the prefetch area ahead of it
+	double q[4] = { x0 - (dx < 0) * w / 2, y0 - (dy < 0) * h / 2, x1 + (dx > 0) * w / 2, y1 + (dy > 0) * h / 2 };
+	int v[4], p[4];		// grid ranges of those
+	struct tile *T;
+	struct layer *L, *S;
+	int i, j, x, y, grid = Store.h->grid;
+
+	Store.frame++;
+	Store.panx = PanX, Store.pany = PanY;
+	store_range (x0, y0, x1, y1, v);
+	store_range (q[0], q[1], q[2], q[3], p);
+	if (detail)
+		store_request (p, r, q);
+	store_evict ();
+
+	// summaries first, under everything
+	for (y = v[1]; y <= v[3]; y++)
+		for (x = v[0]; x <= v[2]; x++)
+			if ((i = Store.at[y * grid + x]) >= 0 && summary_in ((T = &Store.tile[i])->t, x0, y0, x1, y1)
+			    && (!detail || __atomic_load_n (&T->state, __ATOMIC_ACQUIRE) != TILE_IN))
+				tile_summary (T);
+	LAYER_WALK (j, L) {
+		if (!layer_visible (L->number))
+			continue;
+		render_layer (L);	// the background
+		if (!detail)
+			continue;
+		for (y = v[1]; y <= v[3]; y++)
+			for (x = v[0]; x <= v[2]; x++)
+				if ((i = Store.at[y * grid + x]) >= 0 && __atomic_load_n (&(T = &Store.tile[i])->state, __ATOMIC_ACQUIRE) == TILE_IN
+				    && tile_in (T, x0, y0, x1, y1) && (S = tile_find (T, L->number)) != NULL)
+					render_layer (S);
+	}
+}
+
+// software render the store's summaries into r
+static void
+store_ras (struct raster *r, double x0, double y0, double x1, double y1)
+{
+	struct store_cell *cell;
+	double b[4];
+	int i, k, xy[8];
+
+	for (i = 0; i < Store.h->ntiles; i++) {
+		if (!summary_in (&Store.rec[i], x0, y0, x1, y1))
+			continue;
+		for (k = 0; k < STORE_SUMMARY * STORE_SUMMARY; k++) {
+			cell = &Store.rec[i].cell[k];
+			if (cell->layer == 0 || !layer_visible (cell->layer))
+				continue;
+			cell_rect (&Store.rec[i], k, b);
+			xy[0] = xy[6] = b[0];
+			xy[1] = xy[3] = b[1];
+			xy[2] = xy[4] = b[2];
+			xy[5] = xy[7] = b[3];
+			memcpy (r->rgb, cell->rgb, sizeof (r->rgb));
+			ras_polyi (r, 4, xy, GL_FILL);
+		}
+	}
+}
+
+// Text search --------------------------------------------------------------------
+//
+//      '/' prompts for text to find in Text strings, in any case: a
+//      substring, or with a leading ^ a prefix.  The view moves to the
+//      first match and outlines it, 'n' and 'N' step to the next and
+//      previous one.  Only visible layers and the current frame are
+//      searched.  Queries use a trigram index: each string is listed under
+//      every three letter sequence in it (hashed into SEARCH_BUCKETS), so
+//      only the strings in the shortest list of the query's trigrams are
+//      checked.  The index is built by a thread after loading, the
+//      trigrams gathered in parallel; until it's ready, and for queries
+//      under three letters, every string is checked.
+
+#define	SEARCH_BITS	20
+#define	SEARCH_BUCKETS	(1<<SEARCH_BITS)
+#define	SEARCH_CHUNK	4096	// strings per parallel_for index
+
+struct label
+{
+	char *s;
+	struct layer *L;
+	size_t at;		// the Text, see object_at()
+};
+
+// the trigrams of a chunk of strings, (bucket,label) pairs
+struct search_part
+{
+	unsigned int *pair;
+	size_t n;
+	size_t max;
+};
+
+struct search
+{
+	pthread_t thread;
+	int ready;		// start and id are built
+	struct label *label;	// every Text, in drawing order
+	int n;
+	unsigned int *start;	// bucket b lists id[start[b]] .. id[start[b+1]-1]
+	unsigned int *id;	// label numbers, increasing in each bucket
+	int *found;		// labels matching the query
+	int nfound;
+	int at;			// the match shown, -1 for none
+	char query[MAXSTRING];
+} Search = {.at = -1 };
+
+static inline unsigned int
+trigram (char *s)
+{
+	unsigned int g = tolower ((unsigned char) s[0]) << 16 | tolower ((unsigned char) s[1]) << 8 | tolower ((unsigned char) s[2]);
+
+	return (g * 2654435761u) >> (32 - SEARCH_BITS);
+}
+
+static int
+gram_cmp (const void *a, const void *b)
+{
+	unsigned int x = *(unsigned int *) a, y = *(unsigned int *) b;
+
+	return (x > y) - (x < y);
+}
+
+// parallel_for worker, the trigrams of chunk index
+static void
+search_grams (void *arg, int index, int thread)
+{
+	struct search_part *P = (struct search_part *) arg + index;
+	unsigned int g[MAXSTRING];
+	int i, k, n;
+	char *s;
+
+	(void) thread;
+	for (i = index * SEARCH_CHUNK; i < Search.n && i < (index + 1) * SEARCH_CHUNK; i++) {
+		for (n = 0, s = Search.label[i].s; s[0] && s[1] && s[2] && n < MAXSTRING; s++)
+			g[n++] = trigram (s);
+		qsort (g, n, sizeof (g[0]), gram_cmp);
+		for (k = 0; k < n; k++) {
+			if (k > 0 && g[k] == g[k - 1])
+				continue;	// once per string
+			if (P->n + 2 > P->max) {
+				P->max = P->max * 2 + 1024;
+				if ((P->pair = realloc (P->pair, P->max * sizeof (P->pair[0]))) == NULL)
+					fatal ("Can't allocate %zu search entries", P->max);
+			}
+			P->pair[P->n++] = g[k];
+			P->pair[P->n++] = i;
+		}
+	}
+}
+
+// the index thread: gather the pairs, count the buckets, then fill them in label order
+static void *
+search_index (void *arg)
+{
+	int i, nparts = (Search.n + SEARCH_CHUNK - 1) / SEARCH_CHUNK;
+	struct search_part *part = must_zalloc (nparts * sizeof (*part));
+	unsigned int *start = must_zalloc ((SEARCH_BUCKETS + 1) * sizeof (*start)), *id;
+	size_t k;
+
+	(void) arg;
+	parallel_for (nparts, search_grams, part);
+	for (i = 0; i < nparts; i++)
+		for (k = 0; k < part[i].n; k += 2)
+			start[part[i].pair[k] + 1]++;
+	for (i = 0; i < SEARCH_BUCKETS; i++)
+		start[i + 1] += start[i];
+	if ((id = malloc ((start[SEARCH_BUCKETS] + 1) * sizeof (*id))) == NULL)
+		fatal ("Can't allocate the search index");
+	for (i = 0; i < nparts; i++) {
+		for (k = 0; k < part[i].n; k += 2)
+			id[start[part[i].pair[k]]++] = part[i].pair[k + 1];
+		free (part[i].pair);
+	}
+	free (part);
+	memmove (start + 1, start, SEARCH_BUCKETS * sizeof (*start));	// each start[b] moved on to start[b+1]
+	start[0] = 0;
+	Search.start = start;
+	Search.id = id;
+	__atomic_store_n (&Search.ready, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+// list the Text objects and start indexing them
+static void
+search_start (void)
+{
+	struct cursor c;
+	struct layer *L;
+	struct object *o;
+	int i, max = 0;
+
+	LAYER_WALK (i, L) {
+		OBJECT_SCAN (L, c, o) {
+			if (o->type != TYPE_TEXT)
+				continue;
+			if (Search.n >= max) {
+				max = max * 2 + 1024;
+				if ((Search.label = realloc (Search.label, max * sizeof (Search.label[0]))) == NULL)
+					fatal ("Can't allocate %d search labels", max);
+			}
+			Search.label[Search.n].s = TEXT;
+			Search.label[Search.n].L = L;
+			Search.label[Search.n++].at = c.at;
+		}
+	}
+	if (Search.n == 0)
+		return;
+	Search.found = must_malloc (Search.n * sizeof (Search.found[0]));
+	if (pthread_create (&Search.thread, NULL, search_index, NULL) != 0)
+		fatal ("Can't create thread");
+}
+
+// find the labels matching q
+static void
+search_run (char *q)
+{
+	int prefix = (*q == '^'), len, n, k;
+	unsigned int b, best = 0, *cand = NULL;
+	struct label *l;
+
+	Search.nfound = 0;
+	Search.at = -1;
+	q += prefix;
+	if ((len = strlen (q)) == 0)
+		return;
+	n = Search.n;
+	if (len >= 3 && __atomic_load_n (&Search.ready, __ATOMIC_ACQUIRE)) {
+		for (k = 0; k + 2 < len; k++) {
+			b = trigram (q + k);
+			if (k == 0 || Search.start[b + 1] - Search.start[b] < Search.start[best + 1] - Search.start[best])
+				best = b;
+		}
+		cand = Search.id + Search.start[best];
+		n = Search.start[best + 1] - Search.start[best];
+	}
+	for (k = 0; k < n; k++) {
+		l = &Search.label[cand != NULL ? (int) cand[k] : k];
+		if (!layer_visible (l->L->number) || !object_shown (l->L, l->at))
+			continue;
+		if (prefix ? strncasecmp (l->s, q, len) == 0 : strcasestr (l->s, q) != NULL)
+			Search.found[Search.nfound++] = l - Search.label;
+	}
+}
+
+// move the view to match k (wrapping around), zoomed in enough to read it
+static void
+search_show (int k)
+{
+	struct object scratch, *o;
+	struct label *l;
+	char buf[2 * MAXSTRING];
+	double b[4], w, h, zoom = Zoom;
+
+	if (Search.nfound == 0)
+		return;
+	Search.at = (k % Search.nfound + Search.nfound) % Search.nfound;
+	l = &Search.label[Search.found[Search.at]];
+	o = object_at (l->L, l->at, &scratch);
+	object_box (o, b);
+	w = fmax (b[2] - b[0], 1);
+	h = fmax (b[3] - b[1], 1);
+	if (fmin (w, h) * zoom < ATLAS_PIXELS)
+		zoom = ATLAS_PIXELS / fmin (w, h);
+	if (w * zoom > Win_w * 0.8 || h * zoom > Win_h * 0.8)
+		zoom = fmin (Win_w * 0.8 / w, Win_h * 0.8 / h);
+	Zoom = fmin (fmax (zoom, Zoom_min), ZOOM_MAX);
+	PanX = -(b[0] + b[2]) / 2 + Win_w / 2 / Zoom;
+	PanY = -(b[1] + b[3]) / 2 - Win_h / 2 / Zoom;
+	snprintf (buf, sizeof (buf), "%s: %s (%d of %d)", Title, Search.query, Search.at + 1, Search.nfound);
+	set_title (buf);
+	post_redisplay ();
+}
+
+// outline the match being shown
+static void
+search_draw (void)
+{
+	struct object scratch, *o;
+	struct label *l;
+	double b[4], pad = 3 / Zoom;
+
+	if (Search.at < 0 || Search.at >= Search.nfound)
+		return;
+	l = &Search.label[Search.found[Search.at]];
+	o = object_at (l->L, l->at, &scratch);
+	object_box (o, b);
+	glColor3ub (255, 255, 0);
+	glLineWidth (2.0);
+	glBegin (GL_LINE_LOOP);
+	glVertex3d (b[0] - pad, b[1] - pad, ltoz (LAYER));
+	glVertex3d (b[2] + pad, b[1] - pad, ltoz (LAYER));
+	glVertex3d (b[2] + pad, b[3] + pad, ltoz (LAYER));
+	glVertex3d (b[0] - pad, b[3] + pad, ltoz (LAYER));
+	glEnd ();
+	glLineWidth (1.0);
+}
+
+// Label decluttering --------------------------------------------------------------------
+//
+//      With --declutter (or 't') Text is left out of the render batches and
+//      placed again whenever the view changes: the labels in view that are
+//      big enough to read are taken biggest first, and each one is kept
+//      only if the cells of a screen grid (LABEL_CELL pixels) it covers are
+//      still free.  The labels in view come from a model space grid made on
+//      first use, listing each label (biggest first) under the cells its
+//      box overlaps, with the biggest scale in every cell, so cells of
+//      labels too small to read are passed over.  The labels kept on a
+//      layer are drawn with it, in input order.  Rotated views aren't
+//      decluttered, they get every label big enough to read.
+
+#define	LABEL_CELL	4	// screen grid cell, pixels
+#define	LABEL_SPAN	16	// labels over more model grid cells than this are checked every time
+#define	LABEL_VIEW	11	// numbers describing the view the labels were placed for
+
+struct label_key
+{
+	int scale;
+	int i;
+};
+
+struct labels
+{
+	int ready;		// the model grid is made
+	int *rank;		// label numbers (see Search) biggest first
+	double (*box)[4];	// bounds of each label, by rank (not float, coordinates go to +/-LARGE)
+	float *scale;		// and its Text scale
+	int g;			// model grid cells along each side
+	double x0, y0, cw, ch;	// its origin and cell size
+	int *start;		// cell c lists ranks in[start[c]] .. in[start[c+1]-1]
+	int *in;
+	float *big;		// biggest scale in each cell
+	int *wide;		// ranks of the labels in no cell, they cover too many
+	int nwide;
+	unsigned int *seen;	// placement each rank was last looked at in
+	unsigned int gen;
+	int *cand;		// ranks in view, big enough to read
+	int ncand;
+	int *placed[MAX_VIEWS];	// label numbers kept in each view, in drawing order
+	unsigned char *used;	// screen grid
+	int size;		// allocated size of used[]
+	char skip[MAX_LAYERS + 1];	// by layer number, its labels aren't drawn
+	double view[MAX_VIEWS][LABEL_VIEW];	// what each view's were placed for
+} Labels;
+
+// biggest first, then in drawing order
+static int
+label_cmp (const void *a, const void *b)
+{
+	const struct label_key *x = a, *y = b;
+
+	if (x->scale != y->scale)
+		return y->scale - x->scale;
+	return x->i - y->i;
+}
+
+static int
+rank_cmp (const void *a, const void *b)
+{
+	return *(int *) a - *(int *) b;
+}
+
+// cell v of a grid n cells wide, the nearest one if it's outside
+static inline int
+label_cell (double v, int n)
+{
+	return v < 0 ? 0 : (v >= n ? n - 1 : (int) v);
+}
+
+// model grid cells c[0..3] (x0 y0 x1 y1) covered by bounds b
+static inline void
+label_cells (double *b, int c[4])
+{
+	c[0] = label_cell ((b[0] - Labels.x0) / Labels.cw, Labels.g);
+	c[1] = label_cell ((b[1] - Labels.y0) / Labels.ch, Labels.g);
+	c[2] = label_cell ((b[2] - Labels.x0) / Labels.cw, Labels.g);
+	c[3] = label_cell ((b[3] - Labels.y0) / Labels.ch, Labels.g);
+}
+
+// make the model grid of every Text
+static void
+labels_index (void)
+{
+	struct label_key *key = must_malloc ((Search.n + 1) * sizeof (*key));
+	struct object scratch, *o;
+	double t = now ();
+	int n = Search.n, i, r, x, y, c[4];
+
+	for (i = 0; i < n; i++) {
+		o = object_at (Search.label[i].L, Search.label[i].at, &scratch);
+		key[i].scale = SCALE;
+		key[i].i = i;
+	}
+	qsort (key, n, sizeof (*key), label_cmp);
+	Labels.rank = must_malloc ((n + 1) * sizeof (*Labels.rank));
+	Labels.box = must_malloc ((n + 1) * sizeof (*Labels.box));
+	Labels.scale = must_malloc ((n + 1) * sizeof (*Labels.scale));
+	for (r = 0; r < n; r++) {
+		Labels.rank[r] = i = key[r].i;
+		o = object_at (Search.label[i].L, Search.label[i].at, &scratch);
+		object_box (o, Labels.box[r]);
+		Labels.scale[r] = key[r].scale;
+	}
+	free (key);
+
+	for (Labels.g = 1; Labels.g * Labels.g * 4 < n && Labels.g < 1024; Labels.g *= 2);
+	Labels.x0 = Minx;
+	Labels.y0 = Miny;
+	Labels.cw = fmax ((double) (Maxx - Minx) / Labels.g, 1);
+	Labels.ch = fmax ((double) (Maxy - Miny) / Labels.g, 1);
+	Labels.start = must_zalloc ((Labels.g * Labels.g + 1) * sizeof (*Labels.start));
+	Labels.big = must_zalloc (Labels.g * Labels.g * sizeof (*Labels.big));
+	Labels.wide = must_malloc ((n + 1) * sizeof (*Labels.wide));
+	for (r = 0; r < n; r++) {	// count each cell's labels, in start[] of the cell after it
+		label_cells (Labels.box[r], c);
+		if ((c[2] - c[0] + 1) * (c[3] - c[1] + 1) > LABEL_SPAN)
+			continue;
+		for (y = c[1]; y <= c[3]; y++)
+			for (x = c[0]; x <= c[2]; x++)
+				Labels.start[y * Labels.g + x + 1]++;
+	}
+	for (i = 0; i < Labels.g * Labels.g; i++)
+		Labels.start[i + 1] += Labels.start[i];
+	Labels.in = must_malloc ((Labels.start[Labels.g * Labels.g] + 1) * sizeof (*Labels.in));
+	for (r = 0; r < n; r++) {	// in rank order, so each cell's list is too
+		label_cells (Labels.box[r], c);
+		if ((c[2] - c[0] + 1) * (c[3] - c[1] + 1) > LABEL_SPAN) {
+			Labels.wide[Labels.nwide++] = r;
+			continue;
+		}
+		for (y = c[1]; y <= c[3]; y++)
+			for (x = c[0]; x <= c[2]; x++) {
+				i = y * Labels.g + x;
+				Labels.in[Labels.start[i]++] = r;
+				Labels.big[i] = fmaxf (Labels.big[i], Labels.scale[r]);
+			}
+	}
+	memmove (Labels.start + 1, Labels.start, Labels.g * Labels.g * sizeof (*Labels.start));	// each start[c] moved on to start[c+1]
+	Labels.start[0] = 0;
+	Labels.seen = must_zalloc ((n + 1) * sizeof (*Labels.seen));
+	Labels.cand = must_malloc ((n + 1) * sizeof (*Labels.cand));
+	for (i = 0; i < MAX_VIEWS; i++)
+		Labels.placed[i] = must_malloc ((n + 1) * sizeof (*Labels.placed[i]));
+	Labels.ready = 1;
+	printf ("Declutter: %d labels in a %dx%d grid, %.2f seconds\n", n, Labels.g, Labels.g, now () - t);
+}
+
+// add rank r to the candidates if it can be seen in v (x0 y0 x1 y1), or anywhere if v is NULL
+static inline void
+label_candidate (int r, double *v, double min)
+{
+	struct label *l = &Search.label[Labels.rank[r]];
+	double *b = Labels.box[r];
+
+	if (Labels.seen[r] == Labels.gen)
+		return;
+	Labels.seen[r] = Labels.gen;
+	if (Labels.scale[r] < min || Labels.skip[l->L->number] || !object_shown (l->L, l->at))
+		return;
+	if (v != NULL && (b[2] < v[0] || b[0] > v[2] || b[3] < v[1] || b[1] > v[3]))
+		return;
+	Labels.cand[Labels.ncand++] = r;
+}
+
+// does the label of rank r fit on the screen grid? if so it's marked used there
+static int
+label_fits (int r, double *v, int w, int h)
+{
+	double *b = Labels.box[r];
+	int x0 = label_cell ((b[0] - v[0]) * Zoom / LABEL_CELL, w);
+	int x1 = label_cell ((b[2] - v[0]) * Zoom / LABEL_CELL, w);
+	int y0 = label_cell ((v[3] - b[3]) * Zoom / LABEL_CELL, h);	// window rows are down from the top
+	int y1 = label_cell ((v[3] - b[1]) * Zoom / LABEL_CELL, h);
+	int x, y;
+
+	for (y = y0; y <= y1; y++)
+		for (x = x0; x <= x1; x++)
+			if (Labels.used[y * w + x])
+				return 0;
+	for (y = y0; y <= y1; y++)
+		memset (Labels.used + y * w + x0, 1, x1 - x0 + 1);
+	return 1;
+}
+
+// choose the labels to draw in the current view, unless they're still the ones for it
+static void
+labels_place (void)
+{
+	double view[LABEL_VIEW], v[4], min = GREEK_PIXELS / Zoom;
+	int rotated = RotX != 0 || RotY != 0 || RotZ != 0;
+	int w = (Win_w + LABEL_CELL - 1) / LABEL_CELL, h = (Win_h + LABEL_CELL - 1) / LABEL_CELL;
+	int i, k, n, r, x, y, c[4], *placed;
+	struct layer *L;
+
+	if (!Declutter || Search.n == 0 || w <= 0 || h <= 0)
+		return;
+	view[0] = Zoom, view[1] = PanX, view[2] = PanY;
+	view[3] = RotX, view[4] = RotY, view[5] = RotZ;
+	view[6] = Win_w, view[7] = Win_h;
+	view[8] = Frame_now, view[9] = Layer_vis_gen, view[10] = Density;
+	if (Labels.ready && memcmp (view, Labels.view[View_at], sizeof (view)) == 0)
+		return;
+	memcpy (Labels.view[View_at], view, sizeof (view));
+	if (!Labels.ready)
+		labels_index ();
+	placed = Labels.placed[View_at];
+	LAYER_WALK (i, L) {
+		L->nlabels[View_at] = 0;
+		Labels.skip[L->number] = !layer_visible (L->number) || (Density && L->density && density_wanted (L));
+	}
+	Labels.gen++;
+	Labels.ncand = 0;
+	v[0] = -PanX, v[1] = -PanY - Win_h / Zoom;
+	v[2] = -PanX + Win_w / Zoom, v[3] = -PanY;
+	if (rotated)
+		for (r = 0; r < Search.n; r++)
+			label_candidate (r, NULL, min);
+	else {
+		label_cells (v, c);
+		for (y = c[1]; y <= c[3]; y++)
+			for (x = c[0]; x <= c[2]; x++) {
+				i = y * Labels.g + x;
+				if (Labels.big[i] < min)
+					continue;	// nothing big enough to read
+				for (k = Labels.start[i]; k < Labels.start[i + 1]; k++)
+					label_candidate (Labels.in[k], v, min);
+			}
+		for (k = 0; k < Labels.nwide; k++)
+			label_candidate (Labels.wide[k], v, min);
+		qsort (Labels.cand, Labels.ncand, sizeof (*Labels.cand), rank_cmp);
+	}
+
+	if (w * h > Labels.size && (Labels.used = realloc (Labels.used, Labels.size = w * h)) == NULL)
+		fatal ("Can't allocate the label grid");
+	memset (Labels.used, 0, w * h);
+	for (k = n = 0; k < Labels.ncand; k++)
+		if (rotated || label_fits (Labels.cand[k], v, w, h))
+			placed[n++] = Labels.rank[Labels.cand[k]];
+	qsort (placed, n, sizeof (*placed), rank_cmp);	// label numbers are in drawing order
+	for (k = 0; k < n; k++) {
+		L = Search.label[placed[k]].L;
+		if (L->nlabels[View_at]++ == 0)
+			L->label_first[View_at] = k;
+	}
+}
+
+// draw the labels kept on L
+static void
+labels_draw (struct layer *L)
+{
+	struct object scratch, last, *o;
+	int k, first = L->label_first[View_at];
+
+	if (!Declutter)
+		return;
+	for (k = first; k < first + L->nlabels[View_at]; k++) {
+		o = object_at (L, Search.label[Labels.placed[View_at][k]].at, &scratch);
+		render_state (o, k > first ? &last : NULL);
+		glTexti (X1, Y1, ROTATE, SCALE, ltoz (LAYER), TEXT);
+		last = *o;
+	}
+}
+
+// Layer caching ---------------------------------------------------------------
+//
+//      Full quality frames are drawn a layer at a time into an image per
+//      layer (a texture, through a framebuffer object), and the window is
+//      composited from the images in drawing order.  Showing or hiding a
+//      layer, or a layer_dirty(), then draws just that layer again.  The
+//      images hold premultiplied color, so blending them one over another
+//      is the same as drawing the layers so: a frame composited from them
+//      is the frame drawn directly into an image the window's size, but
+//      for 8 bit rounding where a layer's antialiased edges overlap.  It
+//      can still differ from the window itself where lines are clipped at
+//      its edges or a shape's edge goes exactly through pixel centers, as
+//      GL (Mesa's llvmpipe, for one) needn't rasterize an image and the
+//      window to the same pixels.  They're kept while the view, and what
+//      else all layers are drawn with, stays the same and thrown away
+//      when it changes.  Images of hidden layers are kept too, until
+//      --cache MB would be exceeded.  A layer that was drawn with chunks
+//      hidden by later layers (see occ_chunk()) is also drawn again when
+//      one of those is shown or hidden.  Needs OpenGL 3.0 (or the
+//      ARB_framebuffer_object extension), and it's off with --store.
+
+#define	CACHE_DRAWN	1
+#define	CACHE_HIDDEN	2	// drawn with parts hidden by later layers
+#define	CACHE_VIEW	12
+
+struct cache
+{
+	int ok;			// images can be made: 1, can't: -1, not tried yet: 0
+	int on;			// this frame is drawn through the images
+	double view[CACHE_VIEW];	// what the images were drawn for, see cache_view()
+	int w, h;		// image size
+	int n;			// images allocated
+	unsigned int *after;	// by layer number, the layers after it that are shown
+	struct layer *target;	// layer being drawn into, NULL for the window
+} Cache;
+
+// what every layer is drawn with
+static void
+cache_view (double *v)
+{
+	v[0] = Zoom;
+	v[1] = PanX;
+	v[2] = PanY;
+	v[3] = RotX;
+	v[4] = RotY;
+	v[5] = RotZ;
+	v[6] = Win_w;
+	v[7] = Win_h;
+	v[8] = Frame_now;
+	v[9] = Density;
+	v[10] = Shaders && Shader_program != 0;
+	v[11] = Declutter ? Layer_vis_gen : 0;	// any layer shown or hidden moves the labels
+}
+
+// draw into L's image from now on (the window for NULL)
+static void
+cache_target (struct layer *L)
+{
+	if (!Cache.on)
+		L = NULL;
+	if (L == Cache.target)
+		return;
+	Cache.target = L;
+	if (L == NULL) {
+		glBindFramebuffer (GL_FRAMEBUFFER, 0);
+		glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		return;
+	}
+	glBindFramebuffer (GL_FRAMEBUFFER, L->cache_fbo);
+	glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);	// premultiplied
+}
+
+static void
+cache_free (struct layer *L)
+{
+	if (L->cache_tex == 0)
+		return;
+	glDeleteFramebuffers (1, &L->cache_fbo);
+	glDeleteTextures (1, &L->cache_tex);
+	L->cache_fbo = L->cache_tex = 0;
+	L->cached = 0;
+	Cache.n--;
+}
+
+// make L's image, returns 0 if it can't be drawn into
+static int
+cache_alloc (struct layer *L)
+{
+	int ok;
+
+	glGenTextures (1, &L->cache_tex);
+	glBindTexture (GL_TEXTURE_2D, L->cache_tex);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, Cache.w, Cache.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture (GL_TEXTURE_2D, 0);
+	glGenFramebuffers (1, &L->cache_fbo);
+	glBindFramebuffer (GL_FRAMEBUFFER, L->cache_fbo);
+	glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, L->cache_tex, 0);
+	ok = glCheckFramebufferStatus (GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer (GL_FRAMEBUFFER, 0);
+	Cache.n++;
+	if (!ok)
+		cache_free (L);
+	return ok;
+}
+
+// can framebuffer objects be used?
+static int
+cache_check (void)
+{
+	const char *version = (const char *) glGetString (GL_VERSION);
+	int major = 0;
+
+	if (version != NULL && sscanf (version, "%d", &major) == 1 && major >= 3)
+		return 1;
+	return glutExtensionSupported ("GL_ARB_framebuffer_object") ? 1 : -1;
+}
+
+// decide whether a full quality frame is drawn through the layer images, and forget the stale ones
+static void
+cache_begin (void)
+{
+	double view[CACHE_VIEW];
+	size_t size = (size_t) Win_w * Win_h * 4, budget = (size_t) Cache_mb << 20;
+	struct layer *L;
+	unsigned int after = 5381;
+	int i, shown = 0, need = Cache.n;
+
+	cache_target (NULL);
+	Cache.on = 0;
+	if (Interacting || Store.h != NULL || Nviews > 1 || Win_w <= 0 || Win_h <= 0)
+		return;
+	if (Cache.ok == 0)
+		Cache.ok = cache_check ();
+	if (Cache.ok < 0)
+		return;
+	if (Cache.w != Win_w || Cache.h != Win_h) {
+		LAYER_WALK (i, L)
+			cache_free (L);
+		Cache.w = Win_w;
+		Cache.h = Win_h;
+		need = 0;
+	}
+	cache_view (view);
+	if (memcmp (view, Cache.view, sizeof (view)) != 0) {
+		LAYER_WALK (i, L)
+			L->cached = 0;
+		memcpy (Cache.view, view, sizeof (view));
+	}
+	if (Cache.after == NULL)
+		Cache.after = must_malloc ((MAX_LAYERS + 1) * sizeof (*Cache.after));
+	for (i = Nlayers - 1; i >= 0; i--) {
+		L = Layers[Layer_order[i]];
+		Cache.after[L->number] = after;
+		if (L->cached == CACHE_HIDDEN && L->cache_after != after)
+			L->cached = 0;	// a layer that hid some of it was shown or hidden
+		if (layer_visible (L->number)) {
+			after = after * 33 + L->number;
+			shown++;
+			need += L->cache_tex == 0;
+		}
+	}
+	if (need * size > budget)
+		LAYER_WALK (i, L)
+			if (!layer_visible (L->number))
+				cache_free (L);
+	if (shown * size > budget)
+		return;
+	LAYER_WALK (i, L)
+		if (layer_visible (L->number) && L->cache_tex == 0 && !cache_alloc (L)) {
+			Cache.ok = -1;
+			return;
+		}
+	Cache.on = 1;
+}
+
+// is L's image up to date?
+static inline int
+cache_has (struct layer *L)
+{
+	return Cache.on && L->cached;
+}
+
+// start drawing L into its image
+static void
+cache_start (struct layer *L)
+{
+	if (!Cache.on)
+		return;
+	cache_target (L);
+	glClearColor (0.0, 0.0, 0.0, 0.0);
+	glClear (GL_COLOR_BUFFER_BIT);
+}
+
+// L's image has all of it
+static void
+cache_done (struct layer *L)
+{
+	if (!Cache.on)
+		return;
+	L->cached = (Occ.on && Occ.any) ? CACHE_HIDDEN : CACHE_DRAWN;
+	L->cache_after = Cache.after[L->number];
+}
+
+// the part of the window L's image can have anything in: x0 y0 x1 y1, from the bottom left; 0 if none
+static int
+cache_rect (struct layer *L, int r[4])
+{
+	double pad = 2;
+	int k;
+
+	r[0] = r[1] = 0;
+	r[2] = Win_w;
+	r[3] = Win_h;
+	if (RotX != 0 || RotY != 0 || RotZ != 0 || L->chunk_box == NULL || !render_chunked (L))
+		return 1;	// could be anywhere
+	if (L->nchunk == 0)
+		return 0;
+	for (k = 0; k < L->nchunk; k++)
+		pad = fmax (pad, L->chunk_width[k] + 2);
+	r[0] = fmax (floor ((L->ext[0] + PanX) * Zoom - pad), 0);
+	r[1] = fmax (floor (Win_h + (L->ext[1] + PanY) * Zoom - pad), 0);
+	r[2] = fmin (ceil ((L->ext[2] + PanX) * Zoom + pad), Win_w);
+	r[3] = fmin (ceil (Win_h + (L->ext[3] + PanY) * Zoom + pad), Win_h);
+	return r[0] < r[2] && r[1] < r[3];
+}
+
+// draw the shown layers' images into the window, in drawing order
+static void
+cache_composite (void)
+{
+	struct layer *L;
+	int i, r[4];
+
+	if (!Cache.on)
+		return;
+	cache_target (NULL);
+	glPushMatrix ();
+	glLoadIdentity ();
+	glOrtho (0, Win_w, 0, Win_h, -1, 1);
+	glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
+	glColor3ub (255, 255, 255);
+	glEnable (GL_TEXTURE_2D);
+	glBlendFunc (GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	LAYER_WALK (i, L) {
+		if (!layer_visible (L->number) || !L->cached || !cache_rect (L, r))
+			continue;
+		glBindTexture (GL_TEXTURE_2D, L->cache_tex);
+		glBegin (GL_QUADS);
+		glTexCoord2f ((float) r[0] / Win_w, (float) r[1] / Win_h);
+		glVertex2i (r[0], r[1]);
+		glTexCoord2f ((float) r[2] / Win_w, (float) r[1] / Win_h);
+		glVertex2i (r[2], r[1]);
+		glTexCoord2f ((float) r[2] / Win_w, (float) r[3] / Win_h);
+		glVertex2i (r[2], r[3]);
+		glTexCoord2f ((float) r[0] / Win_w, (float) r[3] / Win_h);
+		glVertex2i (r[0], r[3]);
+		glEnd ();
+	}
+	glBindTexture (GL_TEXTURE_2D, 0);
+	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable (GL_TEXTURE_2D);
+	glPolygonMode (GL_FRONT_AND_BACK, Fill);
+	glPopMatrix ();
+}
+
+// draw the visible layers into the display buffer
+static void
+Render (void)
+{
+	struct layer *L;
+	int i;
+
+	if (Atlas == 0)
+		atlas_init ();
+	Views_drawn++;
+	if (Store.h != NULL) {
+		store_render ();
+		return;
+	}
+	Occ.on = 0;
+	if (!Interacting)
+		occ_build (&Occ, Win_w, Win_h, Zoom, -PanX, -PanY, 1);
+	cache_begin ();
+	labels_place ();
+	LAYER_WALK (i, L) {
+		if (layer_visible (L->number) && !cache_has (L)) {
+			cache_start (L);
+			render_layer (L);
+			labels_draw (L);
+			cache_done (L);
+		}
+	}
+	cache_composite ();
+	search_draw ();
+}
+
+// View culling --------------------------------------------------------------------
+//
+//      The software renderer picks what to draw each frame from a flat
+//      copy of the objects' bounds, made per layer on first use: float
+//      arrays of the boxes (rounded outwards, so none are lost) and line
+//      widths.  cull_layer() tests them against the view in one pass, with
+//      AVX2 or SSE2 eight or four at a time when the cpu has them, and
+//      sorts the ones in view by their size on the screen: CULL_DOT if
+//      it's under a pixel, drawn as the pixel it covers, else CULL_FULL.
+//      Each bucket is a list of object numbers in drawing order.  Objects
+//      are kept by layer, so visibility is tested per layer, not object.
+
+#define	CULL_DOT	0
+#define	CULL_FULL	1
+#define	CULL_BUCKETS	2
+#define	CULL_PART	65536	// objects per parallel_for index
+
+struct cull
+{
+	int n;
+	float *x0, *y0, *x1, *y1;	// bounds, empty (x0 > x1) when there are none
+	float *w;		// line width
+	size_t *chunk;		// where every LAYER_CHUNK'th object starts
+	int *list[CULL_BUCKETS];	// objects in view, by bucket
+	int nlist[CULL_BUCKETS];
+};
+
+struct cull_job
+{
+	struct cull *C;
+	float v[4];		// the view, x0 y0 x1 y1
+	float zoom;
+	int (*count)[CULL_BUCKETS];	// objects found by each part
+};
+
+// v as a float no more than it (down) or no less (up)
+static inline float
+float_round (double v, int up)
+{
+	float f = (float) v;
+
+	if (up ? f < v : f > v)
+		f = nextafterf (f, up ? HUGE_VALF : -HUGE_VALF);
+	return f;
+}
+
+// L's culling bounds
+static struct cull *
+cull_boxes (struct layer *L)
+{
+	struct cull *C = must_zalloc (sizeof (*C));
+	struct object *o;
+	struct cursor c;
+	double b[4];
+	int i = 0, k;
+
+	C->n = L->n;
+	C->x0 = must_malloc ((L->n + 1) * sizeof (float));
+	C->y0 = must_malloc ((L->n + 1) * sizeof (float));
+	C->x1 = must_malloc ((L->n + 1) * sizeof (float));
+	C->y1 = must_malloc ((L->n + 1) * sizeof (float));
+	C->w = must_malloc ((L->n + 1) * sizeof (float));
+	C->chunk = must_malloc ((L->n / LAYER_CHUNK + 1) * sizeof (*C->chunk));
+	for (k = 0; k < CULL_BUCKETS; k++)
+		C->list[k] = must_malloc ((L->n + 1) * sizeof (int));
+	OBJECT_SCAN (L, c, o) {
+		if (i % LAYER_CHUNK == 0)
+			C->chunk[i / LAYER_CHUNK] = c.at;
+		if (object_extent (o, b)) {
+			C->x0[i] = float_round (b[0], 0);
+			C->y0[i] = float_round (b[1], 0);
+			C->x1[i] = float_round (b[2], 1);
+			C->y1[i] = float_round (b[3], 1);
+		}
+		else {
+			C->x0[i] = C->y0[i] = HUGE_VALF;
+			C->x1[i] = C->y1[i] = -HUGE_VALF;
+		}
+		C->w[i++] = WIDTH;
+	}
+	return C;
+}
+
+static inline void
+cull_add (int *out[], int *n, int i, int dot)
+{
+	int b = dot ? CULL_DOT : CULL_FULL;
+
+	out[b][n[b]++] = i;
+}
+
+// cull objects from..to-1 into out, counting them in n
+static void
+cull_scalar (struct cull_job *j, int from, int to, int *out[], int *n)
+{
+	struct cull *C = j->C;
+	float pad, inv = 1 / j->zoom;
+	int i;
+
+	for (i = from; i < to; i++) {
+		pad = (C->w[i] + 1) * inv;	// lines are drawn w pixels wide
+		if (C->x1[i] + pad < j->v[0] || C->x0[i] - pad > j->v[2] || C->y1[i] + pad < j->v[1] || C->y0[i] - pad > j->v[3])
+			continue;
+		cull_add (out, n, i, fmaxf (C->x1[i] - C->x0[i], C->y1[i] - C->y0[i]) * j->zoom < 1 && C->w[i] <= 1);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// add the objects from i on in mask m, those in d as dots
+static inline void
+cull_masks (int *out[], int *n, int i, unsigned int m, unsigned int d)
+{
+	int b;
+
+	while (m != 0) {
+		b = __builtin_ctz (m);
+		m &= m - 1;
+		cull_add (out, n, i + b, (d >> b) & 1);
+	}
+}
+
+__attribute__ ((target ("avx2")))
+static void
+cull_avx2 (struct cull_job *j, int from, int to, int *out[], int *n)
+{
+	struct cull *C = j->C;
+	__m256 vx0 = _mm256_set1_ps (j->v[0]), vy0 = _mm256_set1_ps (j->v[1]);
+	__m256 vx1 = _mm256_set1_ps (j->v[2]), vy1 = _mm256_set1_ps (j->v[3]);
+	__m256 one = _mm256_set1_ps (1), inv = _mm256_set1_ps (1 / j->zoom), zoom = _mm256_set1_ps (j->zoom);
+	__m256 x0, y0, x1, y1, w, pad, in, dot;
+	unsigned int m;
+	int i;
+
+	for (i = from; i + 8 <= to; i += 8) {
+		x0 = _mm256_loadu_ps (C->x0 + i);
+		y0 = _mm256_loadu_ps (C->y0 + i);
+		x1 = _mm256_loadu_ps (C->x1 + i);
+		y1 = _mm256_loadu_ps (C->y1 + i);
+		w = _mm256_loadu_ps (C->w + i);
+		pad = _mm256_mul_ps (_mm256_add_ps (w, one), inv);
+		in = _mm256_and_ps (_mm256_cmp_ps (_mm256_add_ps (x1, pad), vx0, _CMP_GE_OQ), _mm256_cmp_ps (_mm256_sub_ps (x0, pad), vx1, _CMP_LE_OQ));
+		in = _mm256_and_ps (in, _mm256_cmp_ps (_mm256_add_ps (y1, pad), vy0, _CMP_GE_OQ));
+		in = _mm256_and_ps (in, _mm256_cmp_ps (_mm256_sub_ps (y0, pad), vy1, _CMP_LE_OQ));
+		if ((m = _mm256_movemask_ps (in)) == 0)
+			continue;
+		dot = _mm256_mul_ps (_mm256_max_ps (_mm256_sub_ps (x1, x0), _mm256_sub_ps (y1, y0)), zoom);
+		dot = _mm256_and_ps (_mm256_cmp_ps (dot, one, _CMP_LT_OQ), _mm256_cmp_ps (w, one, _CMP_LE_OQ));
+		cull_masks (out, n, i, m, _mm256_movemask_ps (dot));
+	}
+	cull_scalar (j, i, to, out, n);
+}
+#endif
+
+#ifdef __SSE2__
+static void
+cull_sse2 (struct cull_job *j, int from, int to, int *out[], int *n)
+{
+	struct cull *C = j->C;
+	__m128 vx0 = _mm_set1_ps (j->v[0]), vy0 = _mm_set1_ps (j->v[1]);
+	__m128 vx1 = _mm_set1_ps (j->v[2]), vy1 = _mm_set1_ps (j->v[3]);
+	__m128 one = _mm_set1_ps (1), inv = _mm_set1_ps (1 / j->zoom), zoom = _mm_set1_ps (j->zoom);
+	__m128 x0, y0, x1, y1, w, pad, in, dot;
+	unsigned int m;
+	int i;
+
+	for (i = from; i + 4 <= to; i += 4) {
+		x0 = _mm_loadu_ps (C->x0 + i);
+		y0 = _mm_loadu_ps (C->y0 + i);
+		x1 = _mm_loadu_ps (C->x1 + i);
+		y1 = _mm_loadu_ps (C->y1 + i);
+		w = _mm_loadu_ps (C->w + i);
+		pad = _mm_mul_ps (_mm_add_ps (w, one), inv);
+		in = _mm_and_ps (_mm_cmpge_ps (_mm_add_ps (x1, pad), vx0), _mm_cmple_ps (_mm_sub_ps (x0, pad), vx1));
+		in = _mm_and_ps (in, _mm_cmpge_ps (_mm_add_ps (y1, pad), vy0));
+		in = _mm_and_ps (in, _mm_cmple_ps (_mm_sub_ps (y0, pad), vy1));
+		if ((m = _mm_movemask_ps (in)) == 0)
+			continue;
+		dot = _mm_mul_ps (_mm_max_ps (_mm_sub_ps (x1, x0), _mm_sub_ps (y1, y0)), zoom);
+		dot = _mm_and_ps (_mm_cmplt_ps (dot, one), _mm_cmple_ps (w, one));
+		cull_masks (out, n, i, m, _mm_movemask_ps (dot));
+	}
+	cull_scalar (j, i, to, out, n);
+}
+#endif
+
+// parallel_for() worker: cull one part of the layer into its place in the lists
+static void
+cull_part (void *arg, int index, int thread)
+{
+	struct cull_job *j = arg;
+	int *out[CULL_BUCKETS], k, from = index * CULL_PART;
+	int to = from + CULL_PART < j->C->n ? from + CULL_PART : j->C->n;
+
+	(void) thread;
+	for (k = 0; k < CULL_BUCKETS; k++)
+		out[k] = j->C->list[k] + from;
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports ("avx2")) {
+		cull_avx2 (j, from, to, out, j->count[index]);
+		return;
+	}
+#endif
+#ifdef __SSE2__
+	cull_sse2 (j, from, to, out, j->count[index]);
+#else
+	cull_scalar (j, from, to, out, j->count[index]);
+#endif
+}
+
+// find L's objects in r, into L->cull's lists
+static struct cull *
+cull_layer (struct layer *L, struct raster *r)
+{
+	struct cull_job j;
+	struct cull *C;
+	int k, p, nparts;
+
+	if (L->cull == NULL)
+		L->cull = cull_boxes (L);
+	C = j.C = L->cull;
+	j.zoom = r->zoom;
+	j.v[0] = float_round (r->ox - 1 / r->zoom, 0);	// a pixel more, for the float rounding
+	j.v[1] = float_round (r->oy - (r->h + 1) / r->zoom, 0);
+	j.v[2] = float_round (r->ox + (r->w + 1) / r->zoom, 1);
+	j.v[3] = float_round (r->oy + 1 / r->zoom, 1);
+	nparts = (C->n + CULL_PART - 1) / CULL_PART;
+	j.count = must_zalloc ((nparts + 1) * sizeof (*j.count));
+	if (nparts > 1)
+		parallel_for (nparts, cull_part, &j);
+	else if (nparts == 1)
+		cull_part (&j, 0, 0);
+	for (k = 0; k < CULL_BUCKETS; k++) {	// close up the gaps between the parts
+		C->nlist[k] = 0;
+		for (p = 0; p < nparts; p++) {
+			memmove (C->list[k] + C->nlist[k], C->list[k] + (size_t) p * CULL_PART, j.count[p][k] * sizeof (int));
+			C->nlist[k] += j.count[p][k];
+		}
+	}
+	free (j.count);
+	return C;
+}
+
+// object number i of L, for i increasing from one call to the next; *next is the one c is at
+static struct object *
+cull_object (struct layer *L, struct cursor *c, int *next, int i)
+{
+	struct object *o = NULL;
+
+	if (L->packed == NULL) {
+		c->at = i;
+		return &L->obj[i];
+	}
+	if (i / LAYER_CHUNK != *next / LAYER_CHUNK) {	// not in this chunk, start at its own
+		c->next = L->cull->chunk[i / LAYER_CHUNK];
+		*next = i / LAYER_CHUNK * LAYER_CHUNK;
+	}
+	while (*next <= i) {
+		o = object_next (L, c);
+		(*next)++;
+	}
+	return o;
+}
+
+// Tiled image export --------------------------------------------------------------------
+//
+//      The image is the home view of the whole drawing scaled to fit the
+//      requested size.  Objects are binned by tile row, tiles are rendered
+//      in parallel, and each finished tile is written straight to its place
+//      in the output file.  Peak memory is one tile per thread plus the bins.
+
+struct export_rec
+{
+	struct layer *L;
+	size_t at;		// the object, see object_at()
+	int x0, y0, x1, y1;	// pixel bounds (inclusive)
+};
+
+struct export
+{
+	int fd;
+	long header;		// bytes before the first pixel
+	int w, h;		// image size
+	int tile;		// tile size
+	int tiles_x, tiles_y;
+	double zoom;
+	struct export_rec *rec;
+	int **band;		// record indices for each row of tiles
+	int *nband;
+	unsigned char *buf[MAX_THREADS];	// tile buffer for each thread
+};
+
+static void
+export_tile (void *arg, int index, int thread)
+{
+	struct export *e = arg;
+	struct raster r;
+	struct object scratch;
+	int tx = index % e->tiles_x;
+	int ty = index / e->tiles_x;
+	int i, y;
+
+	r.pix = e->buf[thread];
+	r.x0 = tx * e->tile;
+	r.y0 = ty * e->tile;
+	r.w = (r.x0 + e->tile <= e->w) ? e->tile : e->w - r.x0;
+	r.h = (r.y0 + e->tile <= e->h) ? e->tile : e->h - r.y0;
+	r.zoom = e->zoom;
+	r.ox = Minx;
+	r.oy = Maxy;
+	memset (r.pix, 0, r.w * r.h * 3);
+	for (i = 0; i < e->nband[ty]; i++) {
+		struct export_rec *x = &e->rec[e->band[ty][i]];
+
+		if (x->x1 < r.x0 || x->x0 >= r.x0 + r.w || x->y1 < r.y0 || x->y0 >= r.y0 + r.h)
+			continue;
+		ras_object (&r, object_at (x->L, x->at, &scratch));
+	}
+	for (y = 0; y < r.h; y++) {
+		off_t pos = e->header + ((off_t) (r.y0 + y) * e->w + r.x0) * 3;
+
+		if (pwrite (e->fd, r.pix + y * r.w * 3, r.w * 3, pos) != r.w * 3)
+			fatal ("Can't write %s", Export_file);
+	}
+}
+
+// render the whole drawing into a PPM file
+static void
+Export (char *file)
+{
+	struct export e;
+	struct layer *L;
+	struct object *o;
+	struct cursor c;
+	char header[64];
+	double b[4];		// model bounds
+	double px[4];		// pixel bounds
+	double t = now ();
+	int i, y, n = 0, max = 1024;
+
+	memset (&e, 0, sizeof (e));
+	e.w = Export_width;
+	e.h = Export_height;
+	e.tile = Export_tile;
+	e.tiles_x = (e.w + e.tile - 1) / e.tile;
+	e.tiles_y = (e.h + e.tile - 1) / e.tile;
+	e.zoom = fmin (e.w / (double) (Maxx - Minx), e.h / (double) (Maxy - Miny));
+	e.rec = must_malloc (max * sizeof (*e.rec));
+
+	// pixel bounds of every visible object, in drawing order
+	LAYER_WALK (i, L) {
+		if (!layer_visible (L->number))
+			continue;
+		OBJECT_SCAN (L, c, o) {
+			struct export_rec *x;
+			int pad = WIDTH + 1;
+
+			if (!object_shown (L, c.at) || !object_extent (o, b))
+				continue;
+			px[0] = floor ((b[0] - Minx) * e.zoom) - pad;
+			px[1] = floor ((Maxy - b[3]) * e.zoom) - pad;
+			px[2] = floor ((b[2] - Minx) * e.zoom) + pad;
+			px[3] = floor ((Maxy - b[1]) * e.zoom) + pad;
+			if (px[2] < 0 || px[0] >= e.w || px[3] < 0 || px[1] >= e.h)
+				continue;
+			if (n == max)
+				e.rec = realloc (e.rec, (max *= 2) * sizeof (*e.rec));
+			if (e.rec == NULL)
+				fatal ("Can't realloc export records");
+			x = &e.rec[n++];
+			x->L = L;
+			x->at = c.at;
+			x->x0 = (int) fmax (px[0], 0);
+			x->y0 = (int) fmax (px[1], 0);
+			x->x1 = (int) fmin (px[2], e.w - 1);
+			x->y1 = (int) fmin (px[3], e.h - 1);
+		}
+	}
+
+	// bin the records by tile row
+	e.band = must_zalloc (e.tiles_y * sizeof (*e.band));
+	e.nband = must_zalloc (e.tiles_y * sizeof (*e.nband));
+	for (i = 0; i < n; i++)
+		for (y = e.rec[i].y0 / e.tile; y <= e.rec[i].y1 / e.tile; y++)
+			e.nband[y]++;
+	for (y = 0; y < e.tiles_y; y++) {
+		e.band[y] = must_malloc ((e.nband[y] + 1) * sizeof (**e.band));
+		e.nband[y] = 0;
+	}
+	for (i = 0; i < n; i++)
+		for (y = e.rec[i].y0 / e.tile; y <= e.rec[i].y1 / e.tile; y++)
+			e.band[y][e.nband[y]++] = i;
+
+	if ((e.fd = open (file, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		fatal ("Can't create %s", file);
+	e.header = sprintf (header, "P6\n%d %d\n255\n", e.w, e.h);
+	if (write (e.fd, header, e.header) != e.header || ftruncate (e.fd, e.header + (off_t) e.w * e.h * 3) != 0)
+		fatal ("Can't write %s", file);
+	for (i = 0; i < nthreads (); i++)
+		e.buf[i] = must_malloc (e.tile * e.tile * 3);
+
+	parallel_for (e.tiles_x * e.tiles_y, export_tile, &e);
+
+	if (close (e.fd) != 0)
+		fatal ("Can't write %s", file);
+	printf ("Exported %s: %dx%d pixels, %d tiles, %d objects, %d threads, %.2f seconds\n", file, e.w, e.h, e.tiles_x * e.tiles_y, n, nthreads (), now () - t);
+	for (i = 0; i < nthreads (); i++)
+		free (e.buf[i]);
+	for (y = 0; y < e.tiles_y; y++)
+		free (e.band[y]);
+	free (e.band);
+	free (e.nband);
+	free (e.rec);
+}
+
+// software render the visible layers into r, at its zoom and origin
+static void
+ras_area (struct raster *r)
+{
+	struct layer *L;
+	struct object *o;
+	struct cursor c;
+	struct cull *C;
+	struct occlusion g;
+	double box[4];
+	int i, j, b, k[CULL_BUCKETS], next;
+
+	memset (r->pix, 0, r->w * r->h * 3);
+	if (Store.h != NULL)	// only the summaries, tiles are loaded for the window
+		store_ras (r, r->ox, r->oy - r->h / r->zoom, r->ox + r->w / r->zoom, r->oy);
+	memset (&g, 0, sizeof (g));
+	occ_build (&g, r->w, r->h, r->zoom, r->ox + r->x0 / r->zoom, r->oy - r->y0 / r->zoom, 0);
+	LAYER_WALK (i, L) {
+		if (!layer_visible (L->number) || L->n == 0)
+			continue;
+		C = cull_layer (L, r);
+		c.next = c.k = 0;
+		next = 0;
+		memset (k, 0, sizeof (k));
+		while (k[CULL_DOT] < C->nlist[CULL_DOT] || k[CULL_FULL] < C->nlist[CULL_FULL]) {	// both lists, in drawing order
+			b = (k[CULL_FULL] >= C->nlist[CULL_FULL]
+			     || (k[CULL_DOT] < C->nlist[CULL_DOT] && C->list[CULL_DOT][k[CULL_DOT]] < C->list[CULL_FULL][k[CULL_FULL]])) ? CULL_DOT : CULL_FULL;
+			j = C->list[b][k[b]++];
+			box[0] = C->x0[j], box[1] = C->y0[j], box[2] = C->x1[j], box[3] = C->y1[j];
+			if (g.any && occ_hidden (&g, box, C->w[j] + 2, i))
+				continue;
+			o = cull_object (L, &c, &next, j);
+			if (!object_shown (L, c.at))
+				continue;
+			if (b == CULL_FULL) {
+				ras_object (r, o);
+				continue;
+			}
+			ras_small (r, o, C->x0[j], C->y0[j], C->x1[j], C->y1[j]);
+		}
+	}
+	for (i = 0; i < OCC_LEVELS; i++)
+		free (g.cover[i]);
+	free (g.order);
+}
+
+// software render the current window view into r (the view rotation is ignored)
 static void
-glTrianglei (int x1, int y1, int x2, int y2, int x3, int y3, int z)
+ras_view (struct raster *r)
 {
-	glBegin (GL_TRIANGLES);
-	glVertex3i (x1, y1, z);
-	glVertex3i (x2, y2, z);
-	glVertex3i (x3, y3, z);
-	glEnd ();
+	r->x0 = r->y0 = 0;
+	r->zoom = Zoom;
+	r->ox = -PanX;
+	r->oy = -PanY;
+	ras_area (r);
+}
+
+// Minimap --------------------------------------------------------------------
+//
+//      An inset in the top right corner shows the whole bounding box with
+//      the window's view outlined; clicking in it moves the view there.
+//      The overview is software rendered on a thread, again whenever the
+//      visible layers change, and drawn as one texture so it costs
+//      nothing per frame.
+
+struct minimap
+{
+	struct raster r;
+	pthread_t thread;
+	int busy;		// the thread is rendering
+	int done;		// and has finished (set by the thread)
+	unsigned int gen;	// Layer_vis_gen it was rendered for
+	int frame;		// and Frame_now
+	GLuint texture;		// 0 until the first overview is ready
+	int x, y;		// window position of the top left corner
+} Map;
+
+static void *
+minimap_thread (void *arg)
+{
+	struct minimap *m = arg;
+
+	ras_area (&m->r);
+	__atomic_store_n (&m->done, 1, __ATOMIC_RELEASE);
+	return NULL;
 }
 
+// while the overview is being rendered, look for it to finish
 static void
-my_glRecti (int x1, int y1, int x2, int y2, int z)
+Minimap_poll (int value)
+{
+	(void) value;
+	if (__atomic_load_n (&Map.done, __ATOMIC_ACQUIRE))
+		post_redisplay ();
+	else
+		glutTimerFunc (MINIMAP_POLL_MS, Minimap_poll, 0);
+}
+
+static void
+minimap_start (void)
+{
+	double w = Maxx - Minx, h = Maxy - Miny;
+	struct raster *r = &Map.r;
+
+	r->zoom = MINIMAP_SIZE / fmax (w, h);
+	r->w = fmax (1, w * r->zoom);
+	r->h = fmax (1, h * r->zoom);
+	r->ox = Minx;
+	r->oy = Maxy;
+	if (r->pix == NULL)
+		r->pix = must_malloc (r->w * r->h * 3);
+	Map.gen = Layer_vis_gen;
+	Map.frame = Frame_now;
+	Map.done = 0;
+	if (pthread_create (&Map.thread, NULL, minimap_thread, &Map) != 0) {
+		error ("Can't create the minimap thread");
+		return;
+	}
+	Map.busy = 1;
+	glutTimerFunc (MINIMAP_POLL_MS, Minimap_poll, 0);
+}
+
+// draw the minimap over the view, in window coordinates
+static void
+minimap_draw (void)
 {
-	glBegin (GL_POLYGON);
-	glVertex3i (x1, y1, z);
-	glVertex3i (x2, y1, z);
-	glVertex3i (x2, y2, z);
-	glVertex3i (x1, y2, z);
+	struct raster *r = &Map.r;
+	double x0, y0, x1, y1;
+
+	if (Map.busy && __atomic_load_n (&Map.done, __ATOMIC_ACQUIRE)) {
+		pthread_join (Map.thread, NULL);
+		Map.busy = 0;
+		if (Map.texture == 0)
+			glGenTextures (1, &Map.texture);
+		glBindTexture (GL_TEXTURE_2D, Map.texture);
+		glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, r->w, r->h, 0, GL_RGB, GL_UNSIGNED_BYTE, r->pix);
+		glBindTexture (GL_TEXTURE_2D, 0);
+	}
+	if (!Map.busy && (Map.texture == 0 || Map.gen != Layer_vis_gen || Map.frame != Frame_now))
+		minimap_start ();
+	if (Map.texture == 0)
+		return;
+
+	// window y is down, the projection's is up from the top left corner
+	Map.x = Win_w - r->w - MINIMAP_MARGIN;
+	Map.y = MINIMAP_MARGIN;
+	glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
+	glColor3ub (255, 255, 255);
+	glEnable (GL_TEXTURE_2D);
+	glBindTexture (GL_TEXTURE_2D, Map.texture);
+	glBegin (GL_QUADS);
+	glTexCoord2f (0, 0);
+	glVertex2i (Map.x, -Map.y);
+	glTexCoord2f (1, 0);
+	glVertex2i (Map.x + r->w, -Map.y);
+	glTexCoord2f (1, 1);
+	glVertex2i (Map.x + r->w, -Map.y - r->h);
+	glTexCoord2f (0, 1);
+	glVertex2i (Map.x, -Map.y - r->h);
+	glEnd ();
+	glDisable (GL_TEXTURE_2D);
+	glPolygonMode (GL_FRONT_AND_BACK, Fill);
+	glColor3ub (128, 128, 128);
+	glBegin (GL_LINE_LOOP);
+	glVertex2i (Map.x - 1, -Map.y + 1);
+	glVertex2i (Map.x + r->w + 1, -Map.y + 1);
+	glVertex2i (Map.x + r->w + 1, -Map.y - r->h - 1);
+	glVertex2i (Map.x - 1, -Map.y - r->h - 1);
+	glEnd ();
+
+	// the view, at least a few pixels so it can be found
+	x0 = (-PanX - r->ox) * r->zoom;
+	x1 = fmax (x0 + 3, (-PanX + Win_w / Zoom - r->ox) * r->zoom);
+	y0 = (r->oy + PanY) * r->zoom;
+	y1 = fmax (y0 + 3, (r->oy + PanY + Win_h / Zoom) * r->zoom);
+	x0 = fmax (x0, 0), y0 = fmax (y0, 0);
+	x1 = fmin (x1, r->w), y1 = fmin (y1, r->h);
+	if (x0 >= x1 || y0 >= y1)
+		return;		// the view is outside the bounding box
+	glColor3ub (255, 255, 0);
+	glBegin (GL_LINE_LOOP);
+	glVertex2d (Map.x + x0, -Map.y - y0);
+	glVertex2d (Map.x + x1, -Map.y - y0);
+	glVertex2d (Map.x + x1, -Map.y - y1);
+	glVertex2d (Map.x + x0, -Map.y - y1);
 	glEnd ();
 }
 
+// center the view on a click in the minimap, returns 0 if it's not in it
+static int
+minimap_click (int x, int y)
+{
+	struct raster *r = &Map.r;
+
+	if (!Minimap || Map.texture == 0 || x < Map.x || x >= Map.x + r->w || y < Map.y || y >= Map.y + r->h)
+		return 0;
+	PanX = -(r->ox + (x - Map.x) / r->zoom) + Win_w / 2 / Zoom;
+	PanY = -(r->oy - (y - Map.y) / r->zoom) - Win_h / 2 / Zoom;
+	return 1;
+}
+
+// Progressive refinement --------------------------------------------------------------------
+//
+//      A full quality frame is drawn in passes of about Budget_ms: each
+//      pass draws layers, and chunks of the big ones, until the budget is
+//      spent, and the idle callback carries on with the next.  The frame
+//      accumulates in the back buffer while the last one stays on screen,
+//      and is swapped in once it's complete.  Any redraw (the view moving,
+//      a layer toggled) starts it again.  Pieces are drawn in layer and
+//      input order, so the frame is the same as one drawn in one go.
+
+struct progress
+{
+	int active;		// a frame is being drawn
+	int at;			// Layer_order index of the layer being drawn
+	int chunk;		// and its next chunk
+	int nchunk;
+	int begun;		// render_begin() has been called for it
+} Progress;
 
-// walk the object primitive list and put them into the display buffer
+// model to window transform for the view, undone with glPopMatrix()
 static void
-Render (void)
+view_push (void)
 {
-	struct object *o;
+	glPushMatrix ();
+	glMatrixMode (GL_PROJECTION);
+	glScalef (Zoom, Zoom, Zoom);
+	glTranslatef (PanX, PanY, 0.0);
+	glRotatef (RotX, 1, 0, 0);
+	glRotatef (RotY, 0, 1, 0);
+	glRotatef (RotZ, 0, 0, 1);
+}
 
-	glLineWidth ((float) DEF_LINE_WIDTH);
-	glPointSize ((float) DEF_LINE_WIDTH);
-	Width = DEF_LINE_WIDTH;
-	glColor3ub (DEF_RED, DEF_GREEN, DEF_BLUE);
-	glPolygonMode (GL_FRONT_AND_BACK, DEF_POLY);
+// show the frame in the back buffer, with the minimap over it
+static void
+present (void)
+{
+	if (Minimap)
+		minimap_draw ();
+	glutSwapBuffers ();
+}
 
-	OBJECT_WALK (&Objects, o) {
-		switch (o->type) {
-		case TYPE_LINE:
-			if (Layer[LAYER] == 0)
-				continue;
-			glLinei (X1, Y1, X2, Y2, Width, ltoz (LAYER));
-			break;
-		case TYPE_POINT:
-			if (Layer[LAYER] == 0)
-				continue;
-			glCirclei (X1, Y1, Width / 2, ltoz (LAYER));
-			break;
-		case TYPE_RECT:
-			if (Layer[LAYER] == 0)
-				continue;
-			my_glRecti (X1, Y1, X2, Y2, ltoz (LAYER));
-			break;
-		case TYPE_TEXT:
-			if (Layer[LAYER] == 0)
-				continue;
-			glPrintf (X1, Y1, ROTATE, SCALE, ltoz (LAYER), TEXT);
-			break;
-		case TYPE_TRIANGLE:
-			if (Layer[LAYER] == 0)
-				continue;
-			glTrianglei (X1, Y1, X2, Y2, X3, Y3, ltoz (LAYER));
-			break;
-		case TYPE_CIRCLE:
-			if (Layer[LAYER] == 0)
-				continue;
-			glCirclei (X1, Y1, RADIUS, ltoz (LAYER));
-			break;
-		case TYPE_ARC:
-			if (Layer[LAYER] == 0)
-				continue;
-			glArci (X1, Y1, RADIUS, DSTART, DDELTA, ltoz (LAYER));
-			break;
-		case TYPE_COLOR:
-			glColor3ub (CR, CG, CB);
-			break;
-		case TYPE_WIDTH:
-			glLineWidth ((float) WIDTH);
-			glPointSize ((float) WIDTH);
-			Width = WIDTH;
-			break;
-		case TYPE_FILL:
-			Fill = FILL;
-			glPolygonMode (GL_FRONT_AND_BACK, FILL);
+// draw the next pieces of the frame until the budget is spent, returns 1 when it's complete
+static int
+progress_pass (void)
+{
+	double t = now ();
+	struct layer *L;
+	int drawn = 0;		// objects since the GL pipeline was last drained
+
+	view_push ();
+	while (Progress.at < Nlayers) {
+		L = Layers[Layer_order[Progress.at]];
+		if (!layer_visible (L->number) || cache_has (L))
+			Progress.at++;
+		else if (Progress.chunk == 0 && !render_chunked (L)) {
+			cache_start (L);
+			render_layer (L);
+			labels_draw (L);
+			cache_done (L);
+			drawn += L->n;
+			Progress.at++;
+		}
+		else {
+			cache_target (L);
+			if (Progress.chunk == 0 && !Progress.begun) {
+				Progress.nchunk = render_begin (L);
+				Progress.begun = 1;
+				cache_start (L);
+			}
+			if (Progress.chunk >= Progress.nchunk || chunk_hidden (L, Progress.chunk))
+				Progress.chunk++;
+			else if (render_chunk (L, Progress.chunk, 0)) {
+				drawn += LAYER_CHUNK;
+				Progress.chunk++;
+			}
+			else if (!record_take ())	// still being recorded, help until it is
+				sched_yield ();
+			if (Progress.chunk >= Progress.nchunk) {
+				labels_draw (L);
+				cache_done (L);
+				Progress.at++;
+				Progress.chunk = Progress.begun = 0;
+			}
+		}
+		if (drawn >= LAYER_CHUNK) {
+			glFinish ();	// so the time is real
+			drawn = 0;
+		}
+		if ((now () - t) * 1000 >= Budget_ms)
 			break;
+	}
+	cache_target (NULL);
+	if (Progress.at >= Nlayers) {
+		cache_composite ();
+		search_draw ();
+	}
+	glPopMatrix ();
+	return Progress.at >= Nlayers;
+}
+
+static void
+Progress_idle (void)
+{
+	if (Progress.active && !progress_pass ())
+		return;
+	glutIdleFunc (NULL);
+	if (Progress.active) {
+		Progress.active = 0;
+		present ();
+	}
+}
+
+// start drawing a full quality frame into the cleared back buffer
+static void
+progress_start (void)
+{
+	if (Atlas == 0)
+		atlas_init ();
+	memset (&Progress, 0, sizeof (Progress));
+	Progress.active = 1;
+	Views_drawn++;
+	occ_build (&Occ, Win_w, Win_h, Zoom, -PanX, -PanY, 1);
+	cache_begin ();
+	labels_place ();
+	if (progress_pass ()) {	// it fit in one pass
+		Progress.active = 0;
+		present ();
+	}
+	else
+		glutIdleFunc (Progress_idle);
+}
+
+// Session recording --------------------------------------------------------------------
+//
+//      A session file has one line per input event:
+//
+//              seconds event a b x y modifiers zoom panx pany rotx roty rotz
+//
+//      event is M (mouse: a=button b=state), V (motion), K (key: a=key),
+//      S (special key: a=key) or R (reshape: a=width b=height), and the
+//      view is the one before the event.  Replay feeds the events to the
+//      same handlers at the recorded times and reports frame render times.
+
+struct event
+{
+	double t;
+	int type;
+	int a, b, x, y;
+	int mods;
+	double view[6];
+};
+
+struct event *Events = NULL;
+int Nevents = 0;
+int Next_event = 0;
+int Diverged = 0;		// events where the replayed view differs from the recording
+
+static inline void
+view_get (double v[6])
+{
+	v[0] = Zoom, v[1] = PanX, v[2] = PanY;
+	v[3] = RotX, v[4] = RotY, v[5] = RotZ;
+}
+
+// called first by every input handler: note the modifiers and log the event
+static void
+input (int type, int a, int b, int x, int y)
+{
+	double v[6];
+
+	if (Replay_file == NULL && (type == 'M' || type == 'K' || type == 'S'))
+		Mods = glutGetModifiers ();	// only valid in these callbacks
+	if (Record_fp == NULL)
+		return;
+	view_get (v);
+	fprintf (Record_fp, "%.6f %c %d %d %d %d %d %.17g %.17g %.17g %.17g %.17g %.17g\n", now () - Session_start,
+		 type, a, b, x, y, Mods, v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+static void
+record_start (char *file)
+{
+	if ((Record_fp = fopen (file, "w")) == NULL)
+		fatal ("Can't create %s", file);
+	setvbuf (Record_fp, NULL, _IOLBF, 0);	// complete lines even if we exit() mid-session
+	fprintf (Record_fp, "# glview session: %s\n", Title);
+	Session_start = now ();
+}
+
+// render time of one replayed frame
+static void
+frame_time (double seconds)
+{
+	if (Nframes == Max_frames && (Frame_times = realloc (Frame_times, (Max_frames = Max_frames ? Max_frames * 2 : 1024) * sizeof (*Frame_times))) == NULL)
+		fatal ("Can't grow frame times to %d", Max_frames);
+	Frame_times[Nframes++] = seconds;
+}
+
+// Split views --------------------------------------------------------------------
+//
+//      'v' splits the window into side by side views, up to MAX_VIEWS, and
+//      'V' closes the current one.  Each view has its own Zoom, pan,
+//      rotation and layer selection, kept in View[] while another one is
+//      current.  The current one is in the usual globals, with Win_w its
+//      width, so everything else works on it unchanged, and input goes to
+//      the view under the mouse.  The views are drawn one after the other
+//      from the same layers and batches, each culled to its own view (see
+//      chunk_hidden()).  What is made for a view's zoom is kept for each
+//      view, so views don't rebuild it for one another every frame: a
+//      layer's batch per zoom its Text is drawn at (see batch_pick()), its
+//      heatmap, and the placed labels.  The layer images (see
+//      cache_begin()) and progressive refinement are only used with one
+//      view, so memory doesn't grow with the views.
+
+struct view
+{
+	double zoom, panx, pany, rotx, roty, rotz;
+	unsigned int vis[(MAX_LAYERS + 32) / 32];	// its Layer_vis
+	unsigned int vis_gen;	// and Layer_vis_gen
+	int x, w;		// window columns it takes
+};
+
+struct view View[MAX_VIEWS];
+int Window_w;			// width of the whole window
+unsigned int View_gens = 0;	// highest Layer_vis_gen handed out
+
+// map window coordinates (y down from the top left corner) of the w x h area at column x to GL's
+static void
+viewport (int x, int w, int h)
+{
+	glViewport (x, 0, w, h);
+	glMatrixMode (GL_PROJECTION);	// Start modifying the projection matrix.
+	glLoadIdentity ();	// Reset project matrix.
+	glOrtho (0, w, 0, h, -((MAX_LAYERS + 1) * LAYER_SEP * 100), (MAX_LAYERS + 1) * LAYER_SEP * 100);	// Map abstract coords directly to window coords.
+	//glScalef(1, -1, 1);                   // Invert Y axis so increasing Y goes down.
+	glTranslatef (0, h, 0);	// Shift origin up to upper-left corner.
+}
+
+// keep the current view in View[i]
+static void
+view_save (int i)
+{
+	struct view *v = &View[i];
+
+	if (Layer_vis_gen != v->vis_gen) {	// changed since it was loaded, so not the same as another view's
+		if (Layer_vis_gen > View_gens)
+			View_gens = Layer_vis_gen;
+		Layer_vis_gen = ++View_gens;
+	}
+	v->zoom = Zoom, v->panx = PanX, v->pany = PanY;
+	v->rotx = RotX, v->roty = RotY, v->rotz = RotZ;
+	memcpy (v->vis, Layer_vis, sizeof (v->vis));
+	v->vis_gen = Layer_vis_gen;
+}
+
+// make View[i] the current view
+static void
+view_load (int i)
+{
+	struct view *v = &View[i];
+
+	Zoom = v->zoom, PanX = v->panx, PanY = v->pany;
+	RotX = v->rotx, RotY = v->roty, RotZ = v->rotz;
+	memcpy (Layer_vis, v->vis, sizeof (Layer_vis));
+	Layer_vis_gen = v->vis_gen;
+	Win_w = v->w;
+	View_at = i;
+}
+
+// share the window's width out between the views
+static void
+view_layout (void)
+{
+	int i, w = Window_w / Nviews;
+
+	for (i = 0; i < Nviews; i++) {
+		View[i].x = i * w;
+		View[i].w = i == Nviews - 1 ? Window_w - i * w : w;
+	}
+	Win_w = View[View_at].w;
+}
+
+// make the view under window column x current, returns x in it
+static int
+view_pick (int x)
+{
+	int i;
+
+	if (Nviews > 1) {
+		for (i = 0; i < Nviews - 1 && x >= View[i + 1].x; i++);
+		if (i != View_at) {
+			view_save (View_at);
+			view_load (i);
 		}
 	}
+	return x - View[View_at].x;
+}
+
+// 'v': a copy of the current view next to it
+static void
+view_split (void)
+{
+	struct layer *L;
+	int i;
+
+	if (Headless || Store.h != NULL || Nviews == MAX_VIEWS)
+		return;		// the software renderer and the store only draw one view
+	view_save (View_at);
+	memmove (&View[View_at + 1], &View[View_at], (Nviews - View_at) * sizeof (*View));
+	Nviews++;
+	View_at++;
+	view_layout ();
+	LAYER_WALK (i, L)
+		cache_free (L);	// not used with more than one view
+}
+
+// 'V': close the current view, the one before it (if any) takes over
+static void
+view_close (void)
+{
+	if (Nviews == 1)
+		return;
+	memmove (&View[View_at], &View[View_at + 1], (Nviews - View_at - 1) * sizeof (*View));
+	Nviews--;
+	view_load (View_at > 0 ? View_at - 1 : 0);
+	view_layout ();
+	if (Nviews == 1)
+		viewport (0, Win_w, Win_h);
+}
+
+// draw every view, with the minimap in the current one, and a line between them
+static void
+views_draw (void)
+{
+	int i, at = View_at;
+
+	view_save (at);
+	for (i = 0; i < Nviews; i++) {
+		if (i == at)
+			continue;
+		view_load (i);
+		viewport (View[i].x, View[i].w, Win_h);
+		view_push ();
+		Render ();
+		glPopMatrix ();
+	}
+	view_load (at);		// last, so the view the globals are left with is drawn with its minimap
+	viewport (View[at].x, View[at].w, Win_h);
+	view_push ();
+	Render ();
+	glPopMatrix ();
+	if (Minimap)
+		minimap_draw ();
+	viewport (0, Window_w, Win_h);
+	glColor3ub (128, 128, 128);
+	glLineWidth (1.0);
+	glBegin (GL_LINES);
+	for (i = 1; i < Nviews; i++) {
+		glVertex2f (View[i].x + 0.5f, 0);
+		glVertex2f (View[i].x + 0.5f, -Win_h);
+	}
+	glEnd ();
+	glutSwapBuffers ();
+}
+
+// Adaptive quality --------------------------------------------------------------------
+//
+//      While the view is moving, frames are drawn with coarse circles, text
+//      boxes and thinned out dense layers.  The thinning adapts to keep the
+//      frame time within Budget_ms.  Once input has been idle for
+//      IDLE_REFINE_MS a full quality frame is drawn.
+
+static void
+Refine (int value)
+{
+	int idle = (int) ((now () - Last_input) * 1000);
+
+	(void) value;
+	if (idle < IDLE_REFINE_MS) {	// still moving, check again later
+		glutTimerFunc (IDLE_REFINE_MS - idle, Refine, 0);
+		return;
+	}
+	Refine_pending = 0;
+	Interacting = 0;
+	Circle_steps = CIRCLE_STEPS;
+	post_redisplay ();
+}
+
+// the view is changing, draw degraded frames until input goes idle
+static void
+interact (void)
+{
+	if (Budget_ms <= 0)
+		return;
+	Last_input = now ();
+	Interacting = 1;
+	Circle_steps = COARSE_STEPS;
+	if (!Refine_pending) {
+		Refine_pending = 1;
+		glutTimerFunc (IDLE_REFINE_MS, Refine, 0);
+	}
+}
+
+// adjust the thinning of dense layers after an interactive frame took 'seconds'
+static void
+adapt (double seconds)
+{
+	Frame_time = seconds;
+	if (seconds * 1000 > Budget_ms && Decimate < MAX_DECIMATE)
+		Decimate *= 2;
+	else if (seconds * 1000 < Budget_ms / 2 && Decimate > 1)
+		Decimate /= 2;
+}
+
+static void
+Paced (int value)
+{
+	(void) value;
+	Redraw_pending = 0;
+	post_redisplay ();
+}
+
+// redraw, but no more often than the display refreshes
+static void
+redraw (void)
+{
+	double wait = Last_frame + 1.0 / REFRESH_HZ - now ();
+
+	if (wait <= 0 || Headless) {
+		post_redisplay ();
+		return;
+	}
+	if (!Redraw_pending) {
+		Redraw_pending = 1;
+		glutTimerFunc ((unsigned int) (wait * 1000) + 1, Paced, 0);
+	}
 }
 
 static void
 Motion (int x, int y)
 {
+	input ('V', 0, 0, x, y);
 	if (!Moveactive)
 		return;
+	x -= View[View_at].x;	// the drag stays in the view it started in
 
 	PanX += (x - Movex) / Zoom;
 	PanY += (Movey - y) / Zoom;
 	Movex = x;
 	Movey = y;
-	glutPostRedisplay ();
+	interact ();
+	redraw ();
 }
 
 static void
 Mouse (int button, int state, int x, int y)
 {
+	input ('M', button, state, x, y);
+	x = Moveactive ? x - View[View_at].x : view_pick (x);
 	switch (button) {
 	case GLUT_WHEEL_UP_BUTTON:
 		if (state == GLUT_UP)
 			return;
 		set_zoom (Zoom / (is_ctrl_pressed ()? ZOOM_STEP_FINE : ZOOM_STEP), x, y);
+		interact ();
 		break;
 	case GLUT_WHEEL_DOWN_BUTTON:
 		if (state == GLUT_UP)
 			return;
 		set_zoom (Zoom * (is_ctrl_pressed ()? ZOOM_STEP_FINE : ZOOM_STEP), x, y);
+		interact ();
 		break;
 	case GLUT_LEFT_BUTTON:
+		if (state == GLUT_DOWN && minimap_click (x, y))
+			break;
 		if (state == GLUT_DOWN) {
 			Movex = x;
 			Movey = y;
@@ -885,73 +8109,259 @@ Mouse (int button, int state, int x, int y)
 			Moveactive = 0;
 		}
 		break;
-	case GLUT_MIDDLE_BUTTON:
-		if (state == GLUT_UP)
-			return;
+	case GLUT_MIDDLE_BUTTON:
+		if (state == GLUT_UP)
+			return;
+		break;
+	case GLUT_RIGHT_BUTTON:
+		if (state == GLUT_UP)
+			return;
+		break;
+	}
+	redraw ();
+}
+
+static void
+Draw (void)
+{
+	double t = Last_frame = now ();
+
+	if (Progress.active) {	// the frame it was drawing is out of date
+		Progress.active = 0;
+		glutIdleFunc (NULL);
+	}
+	glClearColor (0.0, 0.0, 0.0, 0.0);
+	glClear (GL_COLOR_BUFFER_BIT);
+	if (!Interacting && Budget_ms > 0 && Replay_file == NULL && Store.h == NULL && Nviews == 1) {
+		progress_start ();
+		return;
+	}
+	if (Nviews > 1)
+		views_draw ();
+	else {
+		view_push ();
+		Render ();
+		glPopMatrix ();
+		present ();
+	}
+	if (Interacting || Replay_file != NULL) {
+		glFinish ();	// so the frame time is real
+		if (Interacting)
+			adapt (now () - t);
+		if (Replay_file != NULL)
+			frame_time (now () - t);
+	}
+}
+
+// Frame playback --------------------------------------------------------------------
+
+// show frame Frames[i], clamped to the ones there are
+static void
+frame_show (int i)
+{
+	char buf[MAXSTRING];
+
+	if (Frame_count == 0)
+		return;
+	Frame_at = i < 0 ? 0 : (i >= Frame_count ? Frame_count - 1 : i);
+	Frame_now = Frames[Frame_at];
+	snprintf (buf, sizeof (buf), "%s: frame %d (%d of %d)", Title, Frame_now, Frame_at + 1, Frame_count);
+	set_title (buf);
+	post_redisplay ();
+}
+
+static void
+Play_step (int value)
+{
+	(void) value;
+	if (!Playing)
+		return;
+	frame_show (Frame_at + 1 < Frame_count ? Frame_at + 1 : 0);
+	glutTimerFunc (1000 / Fps, Play_step, 0);
+}
+
+// Title bar prompt --------------------------------------------------------------------
+
+static void
+prompt_show (void)
+{
+	char buf[MAXSTRING + 64];
+
+	snprintf (buf, sizeof (buf), "%s: %s_", Prompt_label, Prompt);
+	set_title (buf);
+}
+
+// start reading a line of text in the title bar, done(text) is called on Enter
+static void
+prompt (char *label, void (*done) (char *text))
+{
+	Prompt_label = label;
+	Prompt_done = done;
+	Prompt[0] = '\0';
+	prompt_show ();
+}
+
+static void
+prompt_key (unsigned char key)
+{
+	void (*done) (char *text) = Prompt_done;
+	int len = strlen (Prompt);
+
+	switch (key) {
+	case '\r':
+	case '\n':
+	case 27:		// ESC
+		Prompt_done = NULL;
+		set_title (Title);
+		if (key != 27)
+			done (Prompt);
+		break;
+	case '\b':
+	case 127:		// DEL
+		if (len > 0)
+			Prompt[len - 1] = '\0';
+		prompt_show ();
 		break;
-	case GLUT_RIGHT_BUTTON:
-		if (state == GLUT_UP)
-			return;
+	default:
+		if (isprint (key) && len < MAXSTRING - 1) {
+			Prompt[len] = key;
+			Prompt[len + 1] = '\0';
+		}
+		prompt_show ();
 		break;
 	}
-	glutPostRedisplay ();
 }
 
+// 'l' prompt done
 static void
-Draw (void)
+layers_prompt (char *text)
 {
-	glPushMatrix ();
-	glMatrixMode (GL_PROJECTION);
-	glClearColor (0.0, 0.0, 0.0, 0.0);
-	glClear (GL_COLOR_BUFFER_BIT);
-	glScalef (Zoom, Zoom, Zoom);
-	glTranslatef (PanX, PanY, 0.0);
-	glRotatef (RotX, 1, 0, 0);
-	glRotatef (RotY, 0, 1, 0);
-	glRotatef (RotZ, 0, 0, 1);
-	Render ();
-	glPopMatrix ();
-	glutSwapBuffers ();
+	if (*text != '\0' && layer_select (text, 0) == 0)
+		error ("No layers match %s", text);
+	post_redisplay ();
+}
+
+// '/' prompt done
+static void
+search_prompt (char *text)
+{
+	if (*text == '\0')
+		return;
+	if (Search.n == 0) {
+		error ("No Text to search");
+		return;
+	}
+	strcpy (Search.query, text);
+	search_run (text);
+	if (Search.nfound == 0) {
+		error ("No text matches %s", text);
+		post_redisplay ();	// drop the old outline
+	}
+	search_show (0);
 }
 
 static void
 Key (unsigned char key, int x, int y)
 {
-	(void) x;
-	(void) y;
+	struct layer *L;
+	int i;
+
+	input ('K', key, 0, x, y);
+	if (Prompt_done != NULL) {
+		prompt_key (key);
+		return;
+	}
+	view_pick (x);
 	switch (key) {
 	case 'a':
 		all_layers_on ();
 		break;
+	case 'l':
+		prompt ("Layers", layers_prompt);
+		break;
+	case '/':
+		prompt ("Search", search_prompt);
+		break;
+	case 'n':
+		search_show (Search.at + 1);
+		break;
+	case 'N':
+		search_show (Search.at - 1);
+		break;
+	case 'm':
+		Minimap = !Minimap;
+		break;
+	case 'v':
+		view_split ();
+		break;
+	case 'V':
+		view_close ();
+		break;
+	case 'd':
+		Density = !Density;
+		printf ("Density %s\n", Density ? "on" : "off");
+		break;
+	case 't':
+		if (Store.h != NULL)
+			break;
+		Declutter = !Declutter;
+		for (i = 0; i < MAX_VIEWS; i++)
+			Labels.view[i][0] = -1;	// place them again
+		LAYER_WALK (i, L) {
+			layer_dirty (L);	// the batches have Text, or don't
+			L->coarse_decimate = 0;
+		}
+		printf ("Declutter %s\n", Declutter ? "on" : "off");
+		break;
+	case ',':
+		frame_show (Frame_at - 1);
+		break;
+	case '.':
+		frame_show (Frame_at + 1);
+		break;
+	case 'p':
+		if (Frame_count == 0 || Headless)
+			break;
+		if ((Playing = !Playing))
+			glutTimerFunc (1000 / Fps, Play_step, 0);
+		break;
+	case 's':
+		if (Shader_program == 0 && !shaders_init ())
+			break;
+		Shaders = !Shaders;
+		LAYER_WALK (i, L)
+			layer_dirty (L);	// the other batch may be from another zoom
+		printf ("Shaders %s\n", Shaders ? "on" : "off");
+		break;
 	case '1':
-		Layer[1] = !Layer[1];
+		layer_toggle (1);
 		break;
 	case '2':
-		Layer[2] = !Layer[2];
+		layer_toggle (2);
 		break;
 	case '3':
-		Layer[3] = !Layer[3];
+		layer_toggle (3);
 		break;
 	case '4':
-		Layer[4] = !Layer[4];
+		layer_toggle (4);
 		break;
 	case '5':
-		Layer[5] = !Layer[5];
+		layer_toggle (5);
 		break;
 	case '6':
-		Layer[6] = !Layer[6];
+		layer_toggle (6);
 		break;
 	case '7':
-		Layer[7] = !Layer[7];
+		layer_toggle (7);
 		break;
 	case '8':
-		Layer[8] = !Layer[8];
+		layer_toggle (8);
 		break;
 	case '9':
-		Layer[9] = !Layer[9];
+		layer_toggle (9);
 		break;
 	case '0':
-		Layer[10] = !Layer[10];
+		layer_toggle (10);
 		break;
 	case 'q':
 	case 27:		// ESC
@@ -960,12 +8370,14 @@ Key (unsigned char key, int x, int y)
 		printf ("Key %d?\n", key);
 		break;
 	}
-	glutPostRedisplay ();
+	post_redisplay ();
 }
 
 static void
 SpecialKey (int key, int x, int y)
 {
+	input ('S', key, 0, x, y);
+	x = view_pick (x);
 	switch (key) {
 	case GLUT_KEY_LEFT:
 		set_rot (0, is_ctrl_pressed ()? ROT_STEP_FINE : ROT_STEP, 0, x, y);
@@ -980,40 +8392,40 @@ SpecialKey (int key, int x, int y)
 		set_rot (is_ctrl_pressed ()? -ROT_STEP_FINE : -ROT_STEP, 0, 0, x, y);
 		break;
 	case GLUT_KEY_F1:
-		Layer[1] = !Layer[1];
+		layer_toggle (1);
 		break;
 	case GLUT_KEY_F2:
-		Layer[2] = !Layer[2];
+		layer_toggle (2);
 		break;
 	case GLUT_KEY_F3:
-		Layer[3] = !Layer[3];
+		layer_toggle (3);
 		break;
 	case GLUT_KEY_F4:
-		Layer[4] = !Layer[4];
+		layer_toggle (4);
 		break;
 	case GLUT_KEY_F5:
-		Layer[5] = !Layer[5];
+		layer_toggle (5);
 		break;
 	case GLUT_KEY_F6:
-		Layer[6] = !Layer[6];
+		layer_toggle (6);
 		break;
 	case GLUT_KEY_F7:
-		Layer[7] = !Layer[7];
+		layer_toggle (7);
 		break;
 	case GLUT_KEY_F8:
-		Layer[8] = !Layer[8];
+		layer_toggle (8);
 		break;
 	case GLUT_KEY_F9:
-		Layer[9] = !Layer[9];
+		layer_toggle (9);
 		break;
 	case GLUT_KEY_F10:
-		Layer[10] = !Layer[10];
+		layer_toggle (10);
 		break;
 	case GLUT_KEY_F11:
-		Layer[11] = !Layer[11];
+		layer_toggle (11);
 		break;
 	case GLUT_KEY_F12:
-		Layer[12] = !Layer[12];
+		layer_toggle (12);
 		break;
 	case GLUT_KEY_PAGE_UP:
 		set_rot (0, 0, is_ctrl_pressed ()? ROT_STEP_FINE : ROT_STEP, x, y);
@@ -1032,22 +8444,22 @@ SpecialKey (int key, int x, int y)
 		printf ("SpecialKey %d?\n", key);
 		break;
 	}
-	glutPostRedisplay ();
+	post_redisplay ();
 }
 
 static void
 Reshape (int width, int height)
 {
-	glViewport (0, 0, width, height);
-	glMatrixMode (GL_PROJECTION);	// Start modifying the projection matrix.
-	glLoadIdentity ();	// Reset project matrix.
-	glOrtho (0, width, 0, height, -((MAX_LAYERS + 1) * LAYER_SEP * 100), (MAX_LAYERS + 1) * LAYER_SEP * 100);	// Map abstract coords directly to window coords.
-	//glScalef(1, -1, 1);                   // Invert Y axis so increasing Y goes down.
-	glTranslatef (0, height, 0);	// Shift origin up to upper-left corner.
+	input ('R', width, height, 0, 0);
+	Window_w = width;
+	Win_h = height;
+	view_layout ();
+	viewport (0, width, height);
 }
 
+// initial (home) view and window size
 static void
-WindowSetup (void)
+ViewSetup (void)
 {
 	int width = Maxx - Minx;
 	int height = Maxy - Miny;
@@ -1069,31 +8481,316 @@ WindowSetup (void)
 	PanY_home = PanY = -Maxy;
 	Zoom_home = Zoom;
 	RotX = RotY = RotZ = 0.0;
+	Win_w = width;
+	Win_h = height;
+}
 
+static void
+WindowSetup (void)
+{
+	ViewSetup ();
 	glEnable (GL_LINE_SMOOTH);
 	glEnable (GL_BLEND);
 	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	glutInitDisplayMode (GLUT_RGB | GLUT_DOUBLE);
-	glutInitWindowSize (width, height);
+	glutInitWindowSize (Win_w, Win_h);
 	glutCreateWindow (Title);
+	if (Shaders && !shaders_init ())
+		Shaders = 0;
 }
 
-int
-main (int argc, char **argv)
+// Session replay --------------------------------------------------------------------
+
+static void
+replay_load (char *file)
 {
-	FILE *fp;
+	char buf[MAXBUF];
+	FILE *fp = fopen (file, "r");
+	struct event e;
+	char type;
+	int max = 0;
 
-	glutInit (&argc, argv);
-	if (argc > 1) {
-		Title = argv[1];
-		if ((fp = fopen (argv[1], "r")) != NULL) {
-			Init (fp);
-			fclose (fp);
+	if (fp == NULL)
+		fatal ("Can't open %s", file);
+	while (fgets (buf, sizeof (buf), fp) != NULL) {
+		if (buf[0] == '#')
+			continue;
+		if (sscanf (buf, "%lf %c %d %d %d %d %d %lf %lf %lf %lf %lf %lf", &e.t, &type, &e.a, &e.b, &e.x, &e.y, &e.mods,
+			    &e.view[0], &e.view[1], &e.view[2], &e.view[3], &e.view[4], &e.view[5]) != 13) {
+			error ("Bad session line: %s", buf);
+			continue;
+		}
+		e.type = type;
+		if (Nevents == max && (Events = realloc (Events, (max = max ? max * 2 : 1024) * sizeof (*Events))) == NULL)
+			fatal ("Can't grow session to %d events", max);
+		Events[Nevents++] = e;
+	}
+	fclose (fp);
+}
+
+static int
+double_cmp (const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+replay_report (void)
+{
+	double total = 0;
+	int i;
+
+	qsort (Frame_times, Nframes, sizeof (*Frame_times), double_cmp);
+	for (i = 0; i < Nframes; i++)
+		total += Frame_times[i];
+	printf ("Replay %s: %d events, %d frames, render ms: mean %.3f p50 %.3f p99 %.3f max %.3f\n", Replay_file, Nevents, Nframes,
+		Nframes ? total * 1000 / Nframes : 0.0, Nframes ? Frame_times[Nframes / 2] * 1000 : 0.0,
+		Nframes ? Frame_times[(Nframes * 99) / 100] * 1000 : 0.0, Nframes ? Frame_times[Nframes - 1] * 1000 : 0.0);
+	if (Diverged)
+		printf ("Replay %s: the view differed from the recording at %d events\n", Replay_file, Diverged);
+}
+
+// feed one recorded event to its handler, returns 0 at the end of the session
+static int
+replay_event (struct event *e)
+{
+	double v[6];
+	int i;
+
+	view_get (v);
+	for (i = 0; i < 6; i++)
+		if (fabs (v[i] - e->view[i]) > 1e-9 * fmax (1, fabs (e->view[i]))) {
+			Diverged++;
+			break;
+		}
+	Mods = e->mods;
+	switch (e->type) {
+	case 'M':
+		Mouse (e->a, e->b, e->x, e->y);
+		break;
+	case 'V':
+		Motion (e->x, e->y);
+		break;
+	case 'K':
+		if ((e->a == 'q' || e->a == 27) && Prompt_done == NULL)
+			return 0;	// quit, the session is over
+		Key (e->a, e->x, e->y);
+		break;
+	case 'S':
+		SpecialKey (e->a, e->x, e->y);
+		break;
+	case 'R':
+		if (Headless) {
+			Win_w = e->a;
+			Win_h = e->b;
+			Redisplay = 1;
 		}
+		else
+			glutReshapeWindow (e->a, e->b);
+		break;
 	}
+	return 1;
+}
+
+static void
+Replay_done (int value)
+{
+	(void) value;
+	replay_report ();
+	exit (0);
+}
+
+// timer: replay the events that are due, then wait for the next one
+static void
+Replay_step (int value)
+{
+	double t = now () - Session_start;
+
+	(void) value;
+	while (Next_event < Nevents && Events[Next_event].t <= t)
+		if (!replay_event (&Events[Next_event++]))
+			Next_event = Nevents;
+	if (Next_event < Nevents)
+		glutTimerFunc ((unsigned int) ((Events[Next_event].t - t) * 1000) + 1, Replay_step, 0);
 	else
-		Init (stdin);
+		glutTimerFunc (IDLE_REFINE_MS * 2, Replay_done, 0);	// let the last full quality frame finish
+}
+
+static void
+replay_start (char *file)
+{
+	replay_load (file);
+	Session_start = now ();
+	glutTimerFunc (1, Replay_step, 0);
+}
+
+// software render one frame of the current view
+static void
+headless_frame (struct raster *r)
+{
+	double t = now ();
+
+	if (r->pix == NULL || r->w != Win_w || r->h != Win_h) {
+		free (r->pix);
+		r->w = Win_w;
+		r->h = Win_h;
+		r->pix = must_malloc (r->w * r->h * 3);
+	}
+	ras_view (r);
+	frame_time (now () - t);
+}
+
+// replay a session as fast as possible without a window
+static void
+replay_headless (char *file)
+{
+	struct raster r = {.pix = NULL };
+
+	replay_load (file);
+	headless_frame (&r);
+	for (Next_event = 0; Next_event < Nevents; Next_event++) {
+		if (!replay_event (&Events[Next_event]))
+			break;
+		if (Redisplay) {
+			Redisplay = 0;
+			headless_frame (&r);
+		}
+	}
+	free (r.pix);
+	replay_report ();
+}
+
+// Command line --------------------------------------------------------------------
+
+static void
+usage (char *opt)
+{
+	fatal ("Unknown option %s\n"
+	       "usage: glview [--export file.ppm [--size WxH] [--tile n]] [--threads n] [--budget ms] [--record file] [--replay file [--headless]] [--shaders] [--minimap] [--compact] [--declutter] [--density spec] [--frame n] [--fps n] [--build-store dir [--store-grid n]] [--store dir [--cache MB]] [--no-sidecar] [--diff old new] [--layers spec] [--dedup|--dedup-loose] [--merge] [--simplify tol] [file]", opt);
+}
+
+// value of the option at argv[*i], advancing *i past it
+static char *
+optval (int argc, char **argv, int *i)
+{
+	if (*i + 1 >= argc)
+		fatal ("Option %s needs a value", argv[*i]);
+	return argv[++*i];
+}
+
+// remove recognized --options (and their values) from argv, the rest are left for glut
+static void
+options (int *argc, char **argv)
+{
+	int i, n = 1;
+
+	for (i = 1; i < *argc; i++) {
+		char *opt = argv[i];
+
+		if (strcmp (opt, "--export") == 0)
+			Export_file = optval (*argc, argv, &i);
+		else if (strcmp (opt, "--size") == 0) {
+			if (sscanf (optval (*argc, argv, &i), "%dx%d", &Export_width, &Export_height) != 2)
+				fatal ("--size must be WxH");
+			Export_width = clamp (Export_width, 1, MAX_EXPORT_SIZE);
+			Export_height = clamp (Export_height, 1, MAX_EXPORT_SIZE);
+		}
+		else if (strcmp (opt, "--tile") == 0)
+			Export_tile = clamp (atoi (optval (*argc, argv, &i)), 16, 8192);
+		else if (strcmp (opt, "--budget") == 0)
+			Budget_ms = clamp (atoi (optval (*argc, argv, &i)), 0, 1000);
+		else if (strcmp (opt, "--record") == 0)
+			Record_file = optval (*argc, argv, &i);
+		else if (strcmp (opt, "--replay") == 0)
+			Replay_file = optval (*argc, argv, &i);
+		else if (strcmp (opt, "--headless") == 0)
+			Headless = 1;
+		else if (strcmp (opt, "--density") == 0) {
+			Density_spec = optval (*argc, argv, &i);
+			Density = 1;
+		}
+		else if (strcmp (opt, "--frame") == 0)
+			Start_frame = atoi (optval (*argc, argv, &i));
+		else if (strcmp (opt, "--fps") == 0)
+			Fps = clamp (atoi (optval (*argc, argv, &i)), 1, 1000);
+		else if (strcmp (opt, "--compact") == 0)
+			Compact = 1;
+		else if (strcmp (opt, "--declutter") == 0)
+			Declutter = 1;
+		else if (strcmp (opt, "--minimap") == 0)
+			Minimap = 1;
+		else if (strcmp (opt, "--shaders") == 0)
+			Shaders = 1;
+		else if (strcmp (opt, "--store") == 0)
+			Store_dir = optval (*argc, argv, &i);
+		else if (strcmp (opt, "--build-store") == 0)
+			Build_dir = optval (*argc, argv, &i);
+		else if (strcmp (opt, "--store-grid") == 0)
+			Store_grid = clamp (atoi (optval (*argc, argv, &i)), 1, 4096);
+		else if (strcmp (opt, "--cache") == 0)
+			Cache_mb = clamp (atoi (optval (*argc, argv, &i)), 1, INT_MAX >> 20);
+		else if (strcmp (opt, "--no-sidecar") == 0)
+			Sidecar_on = 0;
+		else if (strcmp (opt, "--diff") == 0)
+			Diff_on = 1;
+		else if (strcmp (opt, "--layers") == 0)
+			Layers_spec = optval (*argc, argv, &i);
+		else if (strcmp (opt, "--dedup") == 0)
+			Dedup = 1;
+		else if (strcmp (opt, "--dedup-loose") == 0)
+			Dedup = 2;
+		else if (strcmp (opt, "--merge") == 0)
+			Merge = 1;
+		else if (strcmp (opt, "--simplify") == 0)
+			Simplify = fmax (0, atof (optval (*argc, argv, &i)));
+		else if (strcmp (opt, "--threads") == 0)
+			Threads = clamp (atoi (optval (*argc, argv, &i)), 1, MAX_THREADS);
+		else if (strncmp (opt, "--", 2) == 0)
+			usage (opt);
+		else
+			argv[n++] = opt;
+	}
+	argv[n] = NULL;
+	*argc = n;
+}
+
+// options and the checks on them, then glut unless there's no window
+static void
+start (int *argc, char **argv)
+{
+	options (argc, argv);
+	if (Headless && Replay_file == NULL)
+		fatal ("--headless needs --replay");
+	if (Diff_on && (*argc < 3 || Store_dir != NULL || Build_dir != NULL))
+		fatal ("--diff needs the old and new files, and no store");
+	if (Export_file == NULL && !Headless && Build_dir == NULL)
+		glutInit (argc, argv);
+}
+
+// once the drawing is loaded: export it, replay a session without a window, or view it
+static int
+run (void)
+{
+	if (Export_file != NULL) {
+		Export (Export_file);
+		return 0;
+	}
+	if (Store.h == NULL) {
+		if (!Sidecar.loaded)
+			occ_init ();
+		sidecar_save ();
+		search_start ();
+	}
+	if (Headless) {
+		Budget_ms = 0;	// the software renderer has no degraded mode
+		ViewSetup ();
+		replay_headless (Replay_file);
+		return 0;
+	}
 
 	WindowSetup ();
 
@@ -1103,6 +8800,210 @@ main (int argc, char **argv)
 	glutMouseFunc (Mouse);
 	glutMotionFunc (Motion);
 	glutDisplayFunc (Draw);
+	if (Record_file != NULL)
+		record_start (Record_file);
+	if (Replay_file != NULL)
+		replay_start (Replay_file);
 	glutMainLoop ();
 	return 0;
 }
+
+// the glview command
+int
+glv_main (int argc, char **argv)
+{
+	FILE *fp;
+
+	start (&argc, argv);
+	if (Build_dir != NULL) {
+		if (argc < 2)
+			fatal ("--build-store needs an input file");
+		store_build (Build_dir, argv[1]);
+		return 0;
+	}
+	if (Store_dir != NULL) {
+		if (Export_file != NULL)
+			fatal ("--export doesn't work with --store");
+		if (Declutter)
+			error ("--declutter doesn't work with --store, ignored");
+		Declutter = 0;
+		Title = Store_dir;
+		store_open (Store_dir);
+	}
+	else if (Diff_on) {
+		Title = argv[2];
+		diff_load (argv[1], argv[2]);
+	}
+	else if (argc > 1) {
+		Title = argv[1];
+		if (!sidecar_load (argv[1]) && (fp = fopen (argv[1], "r")) != NULL) {
+			Init (fp);
+			fclose (fp);
+		}
+	}
+	else
+		Init (stdin);
+	return run ();
+}
+
+// Library API ---------------------------------------------------------------------
+//
+//      See glview.h.  The calls stand in for parse(): Api_state is its
+//      drawing state and values are limited the same way, so a client sees
+//      exactly what glview would draw from the same lines printed as text,
+//      without formatting, tokenizing and atoi() for every number.
+
+static struct object Api_state = {.layer = 1,.width = DEF_LINE_WIDTH,.rgb = {DEF_RED, DEF_GREEN, DEF_BLUE},.filled = (DEF_POLY == GL_FILL) };
+
+#define	api_x(v)	clamp ((v), -LARGE, LARGE)
+
+void
+glv_init (int *argc, char **argv)
+{
+	start (argc, argv);
+	if (Store_dir != NULL || Build_dir != NULL || Diff_on)
+		fatal ("--store, --build-store and --diff don't work with the library");
+	layer_get (1);		// the starting layer, and the background's
+}
+
+void
+glv_set_layer (int n)
+{
+	Api_state.layer = clamp (n, 1, MAX_LAYERS);
+	layer_get (Api_state.layer);
+}
+
+int
+glv_set_layer_named (const char *name)
+{
+	char buf[MAXSTRING];
+
+	snprintf (buf, sizeof (buf), "%s", name);
+	return Api_state.layer = layer_named (buf);
+}
+
+void
+glv_set_color (int r, int g, int b)
+{
+	Api_state.rgb[0] = clamp (r, 0, 255);
+	Api_state.rgb[1] = clamp (g, 0, 255);
+	Api_state.rgb[2] = clamp (b, 0, 255);
+}
+
+void
+glv_set_width (int w)
+{
+	Api_state.width = clamp (w, 1, 1 << 20);
+}
+
+void
+glv_set_fill (int fill)
+{
+	Api_state.filled = fill != 0;
+}
+
+void
+glv_frame (int n)
+{
+	frame_start (n);
+}
+
+void
+glv_set_remove (int on)
+{
+	Removing = on != 0;
+}
+
+void
+glv_lines (const int *xy, int n)
+{
+	for (; n > 0; n--, xy += 4)
+		object_new (&Api_state, TYPE_LINE, api_x (xy[0]), api_x (xy[1]), api_x (xy[2]), api_x (xy[3]), 0, 0, NULL);
+}
+
+void
+glv_polyline (const int *xy, int n)
+{
+	for (; n > 1; n--, xy += 2)
+		object_new (&Api_state, TYPE_LINE, api_x (xy[0]), api_x (xy[1]), api_x (xy[2]), api_x (xy[3]), 0, 0, NULL);
+}
+
+void
+glv_points (const int *xy, int n)
+{
+	for (; n > 0; n--, xy += 2)
+		object_new (&Api_state, TYPE_POINT, api_x (xy[0]), api_x (xy[1]), 0, 0, 0, 0, NULL);
+}
+
+void
+glv_rectangles (const int *xy, int n)
+{
+	for (; n > 0; n--, xy += 4)
+		object_new (&Api_state, TYPE_RECT, api_x (xy[0]), api_x (xy[1]), api_x (xy[2]), api_x (xy[3]), 0, 0, NULL);
+}
+
+void
+glv_circles (const int *xyr, int n)
+{
+	for (; n > 0; n--, xyr += 3)
+		object_new (&Api_state, TYPE_CIRCLE, api_x (xyr[0]), api_x (xyr[1]), clamp (xyr[2], 1, LARGE), 0, 0, 0, NULL);
+}
+
+void
+glv_arcs (const int *a, int n)
+{
+	for (; n > 0; n--, a += 5)
+		object_new (&Api_state, TYPE_ARC, api_x (a[0]), api_x (a[1]), clamp (a[2], 1, LARGE), clamp (a[3], 0, 359), clamp (a[4], -360, 360), 0, NULL);
+}
+
+void
+glv_triangles (const int *xy, int n)
+{
+	for (; n > 0; n--, xy += 6)
+		object_new (&Api_state, TYPE_TRIANGLE, api_x (xy[0]), api_x (xy[1]), api_x (xy[2]), api_x (xy[3]), api_x (xy[4]), api_x (xy[5]), NULL);
+}
+
+void
+glv_text (int x, int y, int angle, int scale, const char *s)
+{
+	char buf[MAXSTRING];
+
+	snprintf (buf, sizeof (buf), "%s", s);
+	object_new (&Api_state, TYPE_TEXT, api_x (x), api_x (y), clamp (angle, 0, 359), clamp (scale, 1, 1 << 20), 0, 0, strsave (buf));
+}
+
+void
+glv_polygon (const int *xy, const int *contour, int ncontours)
+{
+	struct polygon *p = NULL;
+	int i, j, k;
+
+	for (i = k = 0; i < ncontours; i++) {
+		polygon_contour (&p);
+		for (j = 0; j < contour[i]; j++, k++) {
+			if ((p->n & 1023) == 0 && (p->xy = realloc (p->xy, (p->n + 1024) * 2 * sizeof (*p->xy))) == NULL)
+				fatal ("Can't grow polygon");
+			p->xy[p->n * 2 + 0] = api_x (xy[k * 2 + 0]);
+			p->xy[p->n * 2 + 1] = api_x (xy[k * 2 + 1]);
+			p->n++;
+			p->contour[p->ncontours - 1]++;
+		}
+	}
+	polygon_end (&Api_state, &p);
+}
+
+int
+glv_run (void)
+{
+	Removing = 0;
+	Init (NULL);
+	return run ();
+}
+
+#ifndef GLVIEW_LIB
+int
+main (int argc, char **argv)
+{
+	return glv_main (argc, argv);
+}
+#endif
@@ -0,0 +1,52 @@
+//
+//      glview.h --- draw into glview from C, without the text format
+//
+//      Link with libglview.a (and glview's libraries, see the Makefile) to
+//      hand objects to the viewer directly instead of printing them for
+//      glview to read back.  Calls work like the lines of an input file:
+//      the glv_set_ calls change the state (Layer, Color, Width, Fill/Wire)
+//      the objects after them are drawn with, and values are limited the
+//      same way.  The array calls add n objects of one type from packed
+//      ints.  Nothing is drawn until glv_run(), which finishes loading and
+//      runs the viewer (or --export, --replay) in this process.  The calls
+//      aren't thread safe, and glv_init() comes first.
+//
+
+#ifndef GLVIEW_H
+#define GLVIEW_H
+
+// glview's command line options, removed from argv (the rest are left for glut)
+void glv_init (int *argc, char **argv);
+
+// drawing state, as Layer n, Layer name, Color r g b, Width w and Fill/Wire
+void glv_set_layer (int n);
+int glv_set_layer_named (const char *name);	// returns its number
+void glv_set_color (int r, int g, int b);
+void glv_set_width (int w);
+void glv_set_fill (int fill);
+
+// Frame n, and Remove (on: the objects added are removed instead)
+void glv_frame (int n);
+void glv_set_remove (int on);
+
+// n objects each, from packed arrays of ints
+void glv_lines (const int *xy, int n);	// x1 y1 x2 y2
+void glv_polyline (const int *xy, int n);	// n points, joined by n-1 Lines
+void glv_points (const int *xy, int n);	// x y
+void glv_rectangles (const int *xy, int n);	// x1 y1 x2 y2
+void glv_circles (const int *xyr, int n);	// x y radius
+void glv_arcs (const int *a, int n);	// x y radius start delta (degrees)
+void glv_triangles (const int *xy, int n);	// x1 y1 x2 y2 x3 y3
+
+void glv_text (int x, int y, int angle, int scale, const char *s);
+
+// a Polygon: ncontours contours of contour[i] points each from xy, the outline then holes
+void glv_polygon (const int *xy, const int *contour, int ncontours);
+
+// draw what's been added; only returns (0) after --export or a headless --replay
+int glv_run (void);
+
+// the whole glview command, as if run with argc, argv (instead of the calls above)
+int glv_main (int argc, char **argv);
+
+#endif
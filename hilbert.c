@@ -7,11 +7,17 @@
 #include <string.h>
 #include <unistd.h>
 #include "hilbert.h"
+#include "glview.h"
 
-// generate hilbert curves
+// generate hilbert curves, printed for glview or (--view) drawn with libglview
+//
+//      hilbert [--view [glview options]] [max order]
 
 #define	MINORDER	1u
-#define	MAXORDER	8u
+#define	MAXORDER	8u	// default
+#define	ORDER_LIMIT	13u	// scale and coordinates still fit an int
+
+int View = 0;
 
 #define CMAX    251
 void
@@ -32,7 +38,10 @@ rnd_color (void)
 				cb -= CMAX;
 		}
 	}
-	printf ("Color %u %u %u\n", cr, cg, cb);
+	if (View)
+		glv_set_color (cr, cg, cb);
+	else
+		printf ("Color %u %u %u\n", cr, cg, cb);
 }
 
 static inline int
@@ -41,15 +50,43 @@ point (int idx, int scale)
 	return (idx * scale) + (scale / 2);
 }
 
+// the curve as one polyline, a chunk at a time
+void
+plot_view (unsigned int order, int scale)
+{
+	static int xy[2 * 4096];
+	unsigned int i, n, x, y;
+
+	for (i = n = 0; i < (1u << order) * (1u << order); i++) {
+		hilbert (i, order, &x, &y);
+		xy[n * 2 + 0] = point (x, scale);
+		xy[n * 2 + 1] = point (y, scale);
+		if (++n == 4096) {
+			glv_polyline (xy, n);
+			xy[0] = xy[(n - 1) * 2 + 0];	// the next chunk starts where this one ended
+			xy[1] = xy[(n - 1) * 2 + 1];
+			n = 1;
+		}
+	}
+	glv_polyline (xy, n);
+}
+
 void
 plot_hilbert (unsigned int order, int scale)
 {
 	unsigned int i;
 	unsigned int x1, y1, x2, y2;
 
-	printf ("Layer %u\n", (order - MINORDER) + 1);
+	if (View)
+		glv_set_layer ((order - MINORDER) + 1);
+	else
+		printf ("Layer %u\n", (order - MINORDER) + 1);
 	rnd_color ();
 	hilbert (0, order, &x1, &y1);
+	if (View) {
+		plot_view (order, scale);
+		return;
+	}
 	//printf("Text %d %d 0 %d %x\n",point(x1,scale),point(y1,scale),scale/8,0);
 	for (i = 1u; i < (1u << order) * (1u << order); i++) {
 		hilbert (i, order, &x2, &y2);
@@ -63,13 +100,27 @@ plot_hilbert (unsigned int order, int scale)
 int
 main (int argc, char **argv)
 {
-	unsigned int order;
-	int scale = 1 << (MAXORDER + 3);
+	unsigned int order, maxorder = MAXORDER;
+	int scale;
 
-	(void) argc;
-	(void) argv;
-	printf ("Width 1\n");
-	for (order = MINORDER; order <= MAXORDER; order++, scale >>= 1)
+	if (argc > 1 && strcmp (argv[1], "--view") == 0) {
+		View = 1;
+		argv[1] = argv[0];	// the rest are glview's options
+		argc--;
+		argv++;
+		glv_init (&argc, argv);
+	}
+	if (argc > 1) {
+		int n = atoi (argv[1]);
+
+		maxorder = (n < (int) MINORDER) ? MINORDER : (n > (int) ORDER_LIMIT) ? ORDER_LIMIT : (unsigned int) n;
+	}
+	scale = 1 << (maxorder + 3);
+	if (View)
+		glv_set_width (1);
+	else
+		printf ("Width 1\n");
+	for (order = MINORDER; order <= maxorder; order++, scale >>= 1)
 		plot_hilbert (order, scale);
-	return 0;
+	return View ? glv_run () : 0;
 }
@@ -1,10 +1,17 @@
 #include <stdio.h>
 #include <string.h>
+#include "glview.h"
+
+// lines of stdin as Text, printed for glview or (--view) drawn with libglview
+//
+//      tgen [--view [glview options]] <file
 
 #define	SCALE	10
 #define	COL	400
 
 #define	CMAX	251
+int View = 0;
+
 void
 rnd_color (void)
 {
@@ -23,7 +30,10 @@ rnd_color (void)
 				cb -= CMAX;
 		}
 	}
-	printf ("Color %d %d %d\n", cr, cg, cb);
+	if (View)
+		glv_set_color (cr, cg, cb);
+	else
+		printf ("Color %d %d %d\n", cr, cg, cb);
 }
 
 void
@@ -31,7 +41,10 @@ rnd_layer (void)
 {
 	static int l = 0;
 
-	printf ("Layer %d\n", l + 1);
+	if (View)
+		glv_set_layer (l + 1);
+	else
+		printf ("Layer %d\n", l + 1);
 	l += 31;
 	l %= 12;
 }
@@ -42,17 +55,26 @@ main (int argc, char **argv)
 	char buf[1024];
 	int x = 0, y = 0;
 
-	(void) argc; (void) argv;
+	if (argc > 1 && strcmp (argv[1], "--view") == 0) {
+		View = 1;
+		argv[1] = argv[0];	// the rest are glview's options
+		argc--;
+		argv++;
+		glv_init (&argc, argv);
+	}
 	while (fgets (buf, sizeof (buf), stdin) != NULL) {
 		buf[strlen (buf) - 1] = ' ';
 		rnd_color ();
 		rnd_layer ();
-		printf ("Text %d %d 0 %d \"%s\"\n", x * SCALE, y * (SCALE + (SCALE / 2)), SCALE, buf);
+		if (View)
+			glv_text (x * SCALE, y * (SCALE + (SCALE / 2)), 0, SCALE, buf);
+		else
+			printf ("Text %d %d 0 %d \"%s\"\n", x * SCALE, y * (SCALE + (SCALE / 2)), SCALE, buf);
 		x += strlen (buf);
 		if (x >= COL) {
 			y--;
 			x = 0;
 		}
 	}
-	return 0;
+	return View ? glv_run () : 0;
 }